@@ -0,0 +1,141 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "encode_kernels.h"
+#include "hdc.h"
+#include "thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]" << std::endl;
+    std::cerr << "Compares the HDC::encode and HDC::encode_binary paths on every supported ISA" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --samples N     Random samples to encode (default: 4000)" << std::endl;
+    std::cerr << "  --features N    Features per sample (default: 617)" << std::endl;
+    std::cerr << "  --levels N      Level hypervectors (default: 32)" << std::endl;
+    std::cerr << "  --dim N         Dimension (default: 2048)" << std::endl;
+    std::cerr << "  --zeros F       Fraction of features at level 0, as in images (default: 0)" << std::endl;
+    std::cerr << "  --items NAME    Item memories: random, procedural or cyclic (default: random)" << std::endl;
+    std::cerr << "  --repeats N     Timed passes per configuration; the fastest is reported (default: 3)" << std::endl;
+    std::cerr << "  --threads N     Worker threads (default: hardware concurrency)" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int n_samples = 4000;
+    int n_id = 617;
+    int n_lv = 32;
+    int n_dim = 2048;
+    double zeros = 0.0;
+    int repeats = 3;
+    ItemMemoryOptions items;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--samples" && i + 1 < argc) {
+            n_samples = std::stoi(argv[++i]);
+        } else if (arg == "--features" && i + 1 < argc) {
+            n_id = std::stoi(argv[++i]);
+        } else if (arg == "--levels" && i + 1 < argc) {
+            n_lv = std::stoi(argv[++i]);
+        } else if (arg == "--dim" && i + 1 < argc) {
+            n_dim = std::stoi(argv[++i]);
+        } else if (arg == "--zeros" && i + 1 < argc) {
+            zeros = std::stod(argv[++i]);
+        } else if (arg == "--items" && i + 1 < argc) {
+            std::string name(argv[++i]);
+            items.procedural_ids = name == "procedural";
+            if (!items.procedural_ids && !parse_item_method(name, items.method)) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--repeats" && i + 1 < argc) {
+            repeats = std::stoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            ThreadPool::set_global_threads(std::stoi(argv[++i]));
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (n_samples < 1 || n_id < 1 || n_lv < 1 || n_dim < 1 || repeats < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::mt19937_64 rng(42);
+    std::bernoulli_distribution is_zero(zeros);
+    std::uniform_int_distribution<int> pick_level(0, n_lv - 1);
+    HVMatrix<int> samples(n_samples, n_id);
+    for (int i = 0; i < n_samples; ++i) {
+        for (int j = 0; j < n_id; ++j) {
+            samples(i, j) = is_zero(rng) ? 0 : pick_level(rng);
+        }
+    }
+
+    HDC model(2, n_lv, n_id, n_dim, false, items);
+    std::cout << "INFO: samples = " << n_samples << ", features = " << n_id << ", levels = " << n_lv
+              << ", dim = " << n_dim << ", zeros = " << zeros << ", threads = " << ThreadPool::global().size()
+              << std::endl;
+
+    // Speedups are relative to the per-feature path of the same ISA and output
+    std::cout << std::setw(8) << "isa" << std::setw(10) << "encoder" << std::setw(8) << "output" << std::setw(14)
+              << "samples/s" << std::setw(10) << "speedup" << std::setw(8) << "exact" << std::endl;
+    const char* path_names[] = {"feature", "grouped", "xor"};
+    HVMatrix<int> reference;
+    BitHVs bin_reference;
+    for (SimdIsa isa : {SimdIsa::SCALAR, SimdIsa::SSE42, SimdIsa::AVX2, SimdIsa::AVX512}) {
+        if (!set_isa(isa)) {
+            continue;
+        }
+        for (bool packed : {false, true}) {
+            double per_feature_s = 0.0;
+            for (EncodePath path : {EncodePath::FEATURE, EncodePath::GROUPED, EncodePath::XOR}) {
+                model.set_encode_path(path);
+                if (model.encode_path() != path) {
+                    continue;
+                }
+                double best_s = 0.0;
+                HVMatrix<int> enc;
+                BitHVs bin_enc;
+                for (int r = 0; r < repeats; ++r) {
+                    auto start = Clock::now();
+                    if (packed) {
+                        bin_enc = model.encode_binary(samples.view());
+                    } else {
+                        enc = model.encode(samples.view());
+                    }
+                    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                    best_s = r == 0 ? seconds : std::min(best_s, seconds);
+                }
+                if (packed && bin_reference.size() == 0) {
+                    bin_reference = bin_enc;
+                } else if (!packed && reference.empty()) {
+                    reference = enc;
+                }
+                bool exact = true;
+                for (int i = 0; i < n_samples && exact; ++i) {
+                    if (packed) {
+                        exact = bin_enc.unpack(i) == bin_reference.unpack(i);
+                        continue;
+                    }
+                    for (int d = 0; d < n_dim; ++d) {
+                        exact &= enc(i, d) == reference(i, d);
+                    }
+                }
+                if (path == EncodePath::FEATURE) {
+                    per_feature_s = best_s;
+                }
+                std::cout << std::setw(8) << isa_name(isa) << std::setw(10) << path_names[static_cast<int>(path)]
+                          << std::setw(8) << (packed ? "binary" : "int") << std::setw(14) << n_samples / best_s
+                          << std::setw(10) << per_feature_s / best_s << std::setw(8) << (exact ? "yes" : "NO")
+                          << std::endl;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "genome.h"
+#include "thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Returns whether one of the hits overlaps the k-mer windows [begin, end) of record 0.
+ */
+bool overlaps(const std::vector<GenomeHit>& hits, uint64_t begin, uint64_t end) {
+    for (const GenomeHit& hit : hits) {
+        if (hit.interval.record == 0 && hit.interval.begin < end && begin < hit.interval.end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]" << std::endl;
+    std::cerr << "Compares GenomeHDC::locate() on bundle trees against a linear scan of the shards" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --bases N       Length of the random genome (default: 1000000)" << std::endl;
+    std::cerr << "  --reads N       Reads, each a random substring of the genome (default: 2000)" << std::endl;
+    std::cerr << "  --read-length N Bases per read (default: 1000)" << std::endl;
+    std::cerr << "  --kmer N        K-mer length k (default: 200)" << std::endl;
+    std::cerr << "  --dim N         Dimension (default: 8196)" << std::endl;
+    std::cerr << "  --shard-kmers N K-mers per shard (default: dim / 64)" << std::endl;
+    std::cerr << "  --mutations N   Substituted bases per read (default: 0)" << std::endl;
+    std::cerr << "  --fasta FILE    Temporary FASTA file (default: genome_bench.fna)" << std::endl;
+    std::cerr << "  --threads N     Worker threads (default: hardware concurrency)" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n_bases = 1000000;
+    size_t n_reads = 2000;
+    size_t read_length = 1000;
+    int k = 200;
+    int n_dim = 8196;
+    size_t shard_kmers = 0;
+    int n_mutations = 0;
+    std::string fasta_path = "genome_bench.fna";
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--bases" && i + 1 < argc) {
+            n_bases = std::stoul(argv[++i]);
+        } else if (arg == "--reads" && i + 1 < argc) {
+            n_reads = std::stoul(argv[++i]);
+        } else if (arg == "--read-length" && i + 1 < argc) {
+            read_length = std::stoul(argv[++i]);
+        } else if (arg == "--kmer" && i + 1 < argc) {
+            k = std::stoi(argv[++i]);
+        } else if (arg == "--dim" && i + 1 < argc) {
+            n_dim = std::stoi(argv[++i]);
+        } else if (arg == "--shard-kmers" && i + 1 < argc) {
+            shard_kmers = std::stoul(argv[++i]);
+        } else if (arg == "--mutations" && i + 1 < argc) {
+            n_mutations = std::stoi(argv[++i]);
+        } else if (arg == "--fasta" && i + 1 < argc) {
+            fasta_path = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            ThreadPool::set_global_threads(std::stoi(argv[++i]));
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (k < 1 || read_length < static_cast<size_t>(k) || n_bases < read_length || n_dim < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (shard_kmers == 0) {
+        shard_kmers = std::max(1, n_dim / 64);
+    }
+
+    std::mt19937_64 rng(42);
+    const char bases[] = "ACGT";
+    std::string genome(n_bases, 'A');
+    for (char& c : genome) {
+        c = bases[rng() & 3];
+    }
+    {
+        std::ofstream file(fasta_path);
+        file << ">synthetic\n";
+        for (size_t i = 0; i < n_bases; i += 80) {
+            file << genome.substr(i, 80) << '\n';
+        }
+        if (!file) {
+            std::cerr << "Error writing " << fasta_path << std::endl;
+            return 1;
+        }
+    }
+
+    GenomeHDC hdc(k, n_dim);
+    auto start = Clock::now();
+    bool loaded = hdc.add_fasta(fasta_path, shard_kmers);
+    std::remove(fasta_path.c_str());
+    if (!loaded) {
+        return 1;
+    }
+    double shard_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<uint64_t> positions(n_reads);
+    std::vector<std::string> reads(n_reads);
+    std::uniform_int_distribution<uint64_t> pick_pos(0, n_bases - read_length);
+    std::uniform_int_distribution<size_t> pick_base(0, read_length - 1);
+    for (size_t r = 0; r < n_reads; ++r) {
+        positions[r] = pick_pos(rng);
+        reads[r] = genome.substr(positions[r], read_length);
+        for (int m = 0; m < n_mutations; ++m) {
+            char& c = reads[r][pick_base(rng)];
+            c = bases[(base_code(c) + 1 + rng() % 3) & 3];
+        }
+    }
+
+    std::cout << "INFO: bases = " << n_bases << ", reads = " << n_reads << " of " << read_length << ", k = " << k
+              << ", dim = " << n_dim << ", shards = " << hdc.get_n_ref() << " of " << shard_kmers << " k-mers (" << shard_s
+              << " s), mutations = " << n_mutations << ", threads = " << ThreadPool::global().size() << std::endl;
+
+    // Runs every read through search and returns {seconds, node scores per read, hit rate}
+    auto run = [&](auto search) {
+        std::atomic<size_t> checks{0};
+        std::atomic<size_t> found{0};
+        auto begin = Clock::now();
+        ThreadPool::global().parallel_for(0, n_reads, 0, [&](size_t b, size_t e, int) {
+            size_t local_checks = 0;
+            size_t local_found = 0;
+            for (size_t r = b; r < e; ++r) {
+                local_found += overlaps(search(reads[r], local_checks), positions[r],
+                                        positions[r] + read_length - k + 1);
+            }
+            checks += local_checks;
+            found += local_found;
+        });
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        return std::vector<double>{seconds, static_cast<double>(checks) / n_reads,
+                                   static_cast<double>(found) / n_reads};
+    };
+
+    std::cout << std::setw(10) << "branching" << std::setw(7) << "depth" << std::setw(6) << "beam" << std::setw(10)
+              << "build s" << std::setw(12) << "reads/s" << std::setw(10) << "speedup" << std::setw(13)
+              << "nodes/read" << std::setw(9) << "found" << std::endl;
+    std::vector<double> linear = run([&](const std::string& read, size_t& checks) {
+        checks += hdc.get_n_ref();
+        return hdc.scan(read, 1);
+    });
+    std::cout << std::setw(10) << "linear" << std::setw(7) << 1 << std::setw(6) << 1 << std::setw(10) << 0.0
+              << std::setw(12) << n_reads / linear[0] << std::setw(10) << 1.0 << std::setw(13) << linear[1]
+              << std::setw(9) << linear[2] << std::endl;
+
+    for (int branching : {4, 16, 64}) {
+        start = Clock::now();
+        hdc.build_tree(branching);
+        double build_s = std::chrono::duration<double>(Clock::now() - start).count();
+        for (int beam : {1, 4, 16, 64}) {
+            std::vector<double> tree = run([&](const std::string& read, size_t& checks) {
+                return hdc.locate(read, beam, &checks);
+            });
+            std::cout << std::setw(10) << branching << std::setw(7) << hdc.tree_depth() << std::setw(6) << beam
+                      << std::setw(10) << build_s << std::setw(12) << n_reads / tree[0] << std::setw(10)
+                      << linear[0] / tree[0] << std::setw(13) << tree[1] << std::setw(9) << tree[2] << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bithv.h"
+#include "lsh_index.h"
+#include "similarity.h"
+#include "thread_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Fills every row with random bits, keeping the unused bits of the last word zero.
+ */
+void random_hvs(BitHVs& hvs, std::mt19937_64& rng) {
+    int tail = hvs.dim() % BitHVs::BITS_PER_WORD;
+    for (size_t i = 0; i < hvs.size(); ++i) {
+        uint64_t* row = hvs.row(i);
+        for (int w = 0; w < hvs.words(); ++w) {
+            row[w] = rng();
+        }
+        if (tail != 0) {
+            row[hvs.words() - 1] &= (uint64_t(1) << tail) - 1;
+        }
+    }
+}
+
+/**
+ * @brief Returns the fraction of the exact top-k neighbours that also appear in the approximate top-k.
+ */
+double recall(const HVMatrix<int>& exact, const HVMatrix<int>& approx) {
+    size_t found = 0;
+    size_t total = 0;
+    for (size_t q = 0; q < exact.rows(); ++q) {
+        const int* a = approx.row(q);
+        for (size_t j = 0; j < exact.cols(); ++j) {
+            found += std::find(a, a + approx.cols(), exact(q, j)) != a + approx.cols();
+            ++total;
+        }
+    }
+    return total ? static_cast<double>(found) / total : 1.0;
+}
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]" << std::endl;
+    std::cerr << "Compares LshIndex against exhaustive top-k search on a synthetic reference library" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --refs N      Reference hypervectors (default: 100000)" << std::endl;
+    std::cerr << "  --queries N   Queries, each a noisy copy of a random reference (default: 1000)" << std::endl;
+    std::cerr << "  --dim N       Dimension (default: 2048)" << std::endl;
+    std::cerr << "  --noise F     Fraction of query bits flipped (default: 0.2)" << std::endl;
+    std::cerr << "  --k N         Neighbours per query (default: 1)" << std::endl;
+    std::cerr << "  --threads N   Worker threads (default: hardware concurrency)" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t n_refs = 100000;
+    size_t n_queries = 1000;
+    int n_dim = 2048;
+    double noise = 0.2;
+    int k = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--refs" && i + 1 < argc) {
+            n_refs = std::stoul(argv[++i]);
+        } else if (arg == "--queries" && i + 1 < argc) {
+            n_queries = std::stoul(argv[++i]);
+        } else if (arg == "--dim" && i + 1 < argc) {
+            n_dim = std::stoi(argv[++i]);
+        } else if (arg == "--noise" && i + 1 < argc) {
+            noise = std::stod(argv[++i]);
+        } else if (arg == "--k" && i + 1 < argc) {
+            k = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            ThreadPool::set_global_threads(std::stoi(argv[++i]));
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::mt19937_64 rng(42);
+    BitHVs refs(n_refs, n_dim);
+    random_hvs(refs, rng);
+    BitHVs queries(n_queries, n_dim);
+    std::uniform_int_distribution<size_t> pick_ref(0, n_refs - 1);
+    std::bernoulli_distribution flip(noise);
+    for (size_t q = 0; q < n_queries; ++q) {
+        const uint64_t* ref = refs.row(pick_ref(rng));
+        uint64_t* row = queries.row(q);
+        std::copy(ref, ref + refs.words(), row);
+        for (int d = 0; d < n_dim; ++d) {
+            row[d / BitHVs::BITS_PER_WORD] ^= static_cast<uint64_t>(flip(rng)) << (d % BitHVs::BITS_PER_WORD);
+        }
+    }
+
+    std::cout << "INFO: refs = " << n_refs << ", queries = " << n_queries << ", dim = " << n_dim
+              << ", noise = " << noise << ", k = " << k << ", threads = " << ThreadPool::global().size() << std::endl;
+
+    HVMatrix<int> exact_ids, exact_dots;
+    auto start = Clock::now();
+    topk_classes(queries, refs, k, exact_ids, exact_dots);
+    double exact_s = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << std::setw(8) << "tables" << std::setw(6) << "bits" << std::setw(8) << "probes" << std::setw(11)
+              << "build s" << std::setw(13) << "queries/s" << std::setw(10) << "speedup" << std::setw(13)
+              << "cand/query" << std::setw(9) << "recall" << std::endl;
+    std::cout << std::setw(8) << "exact" << std::setw(6) << "-" << std::setw(8) << "-" << std::setw(11) << 0.0
+              << std::setw(13) << n_queries / exact_s << std::setw(10) << 1.0 << std::setw(13) << n_refs
+              << std::setw(9) << 1.0 << std::endl;
+
+    const LshParams settings[] = {{16, 12, 0, 1}, {32, 12, 0, 1}, {64, 12, 0, 1}, {32, 12, 2, 1},
+                                  {32, 16, 0, 1}, {32, 16, 4, 1}, {64, 16, 4, 1}, {64, 20, 4, 1}};
+    for (const LshParams& params : settings) {
+        LshIndex index;
+        start = Clock::now();
+        if (!index.build(refs, params)) {
+            continue;
+        }
+        double build_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+        HVMatrix<int> ids, dots;
+        start = Clock::now();
+        size_t candidates = index.query(queries, k, ids, dots);
+        double query_s = std::chrono::duration<double>(Clock::now() - start).count();
+        std::cout << std::setw(8) << params.n_tables << std::setw(6) << params.bits_per_key << std::setw(8)
+                  << params.probes << std::setw(11) << build_s << std::setw(13) << n_queries / query_s << std::setw(10)
+                  << exact_s / query_s << std::setw(13) << static_cast<double>(candidates) / n_queries << std::setw(9)
+                  << recall(exact_ids, ids) << std::endl;
+    }
+    return 0;
+}
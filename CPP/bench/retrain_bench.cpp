@@ -0,0 +1,135 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "dataset.h"
+#include "hdc.h"
+#include "thread_pool.h"
+
+/**
+ * @brief Re-trains a copy of the initialized model and reports accuracy against wall time.
+ *
+ * Only the re-training epochs are timed; the test pass after every epoch is not.
+ *
+ * @param mode Name printed in the first column.
+ * @param epoch Callback running one re-training epoch on the model.
+ */
+template <typename Encoded, typename EpochFn>
+void run_mode(const std::string& mode, const HDC& init_model, const Encoded& test_enc,
+              const std::vector<int>& test_labels, int epochs, EpochFn epoch) {
+    HDC model = init_model;
+    double elapsed = 0.0;
+    double best_acc = model.test(test_enc, test_labels);
+    double time_to_best = 0.0;
+    std::cout << std::setw(10) << mode << std::setw(7) << 0 << std::setw(12) << elapsed << std::setw(10) << best_acc
+              << std::endl;
+
+    for (int i = 0; i < epochs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        epoch(model);
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double acc = model.test(test_enc, test_labels);
+        if (acc > best_acc) {
+            best_acc = acc;
+            time_to_best = elapsed;
+        }
+        std::cout << std::setw(10) << mode << std::setw(7) << (i + 1) << std::setw(12) << elapsed << std::setw(10) << acc
+                  << std::endl;
+    }
+    std::cout << "SUMMARY " << mode << ": " << epochs / elapsed << " epochs/s, best acc. " << best_acc << " after "
+              << time_to_best << " s" << std::endl;
+}
+
+/**
+ * @brief Compares serial, Hogwild and (optionally) mini-batch re-training.
+ */
+template <typename Encoded>
+void compare_modes(const HDC& init_model, const Encoded& train_enc, const std::vector<int>& train_labels,
+                   const Encoded& test_enc, const std::vector<int>& test_labels, int epochs, int batch_size) {
+    std::cout << std::setw(10) << "mode" << std::setw(7) << "epoch" << std::setw(12) << "train_s" << std::setw(10)
+              << "test_acc" << std::endl;
+    run_mode("serial", init_model, test_enc, test_labels, epochs, [&](HDC& model) {
+        model.train(train_enc, train_labels);
+    });
+    run_mode("hogwild", init_model, test_enc, test_labels, epochs, [&](HDC& model) {
+        model.train_hogwild(train_enc, train_labels);
+    });
+    if (batch_size > 0) {
+        run_mode("batch", init_model, test_enc, test_labels, epochs, [&](HDC& model) {
+            model.train_batched(train_enc, train_labels, batch_size);
+        });
+    }
+}
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] [dataset_name]" << std::endl;
+    std::cerr << "Compares convergence per second of serial and Hogwild re-training (default dataset: "
+              << DATASET << ")" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --threads N    Number of worker threads (default: $HDC_THREADS or all cores)" << std::endl;
+    std::cerr << "  --epochs N     Re-training epochs per mode (default: train_epochs from hdc_parameters)" << std::endl;
+    std::cerr << "  --batch N      Also run mini-batch re-training with batches of N samples" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string dataset_name(DATASET);
+    int n_threads = 0;
+    int epochs = 0;
+    int batch_size = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--threads" && i + 1 < argc) {
+            n_threads = std::stoi(argv[++i]);
+        } else if (arg == "--epochs" && i + 1 < argc) {
+            epochs = std::stoi(argv[++i]);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batch_size = std::stoi(argv[++i]);
+        } else if (!arg.empty() && arg[0] != '-') {
+            dataset_name = arg;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    int n_dim, train_epochs, n_lv, n_class;
+    bool binary;
+    ItemMemoryOptions items;
+    if (open_hdc_parameters(dataset_name, n_dim, binary, train_epochs, n_lv, n_class, items.method)) {
+        return 1;
+    }
+    if (epochs <= 0) {
+        epochs = train_epochs;
+    }
+
+    ThreadPool::set_global_threads(n_threads);
+
+    Dataset dataset;
+    if (dataset.load_dataset(dataset_name) != 0) {
+        std::cerr << "Failed to load the dataset" << std::endl;
+        return 1;
+    }
+
+    std::cout << "INFO: dataset = " << dataset_name << ", threads = " << ThreadPool::global().size()
+              << ", epochs = " << epochs << std::endl;
+
+    HDC model(n_class, n_lv, dataset.sample_size, n_dim, binary, items);
+    if (binary) {
+        auto encode = [&](auto values) { return model.encode_binary(values); };
+        BitHVs train_enc = dataset.train.view.visit(encode);
+        BitHVs test_enc = dataset.test.view.visit(encode);
+        model.train_init(train_enc, dataset.train.labels);
+        compare_modes(model, train_enc, dataset.train.labels, test_enc, dataset.test.labels, epochs, batch_size);
+    } else {
+        auto encode = [&](auto values) { return model.encode(values); };
+        HVMatrix<int> train_enc = dataset.train.view.visit(encode);
+        HVMatrix<int> test_enc = dataset.test.view.visit(encode);
+        model.train_init(train_enc, dataset.train.labels);
+        compare_modes(model, train_enc, dataset.train.labels, test_enc, dataset.test.labels, epochs, batch_size);
+    }
+    return 0;
+}
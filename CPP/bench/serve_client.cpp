@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "dataset.h"
+#include "server.h"
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief A blocking line-oriented client of the --serve socket.
+ */
+class LineClient {
+public:
+    ~LineClient() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    bool connect(const std::string& path) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::cerr << "Error connecting to " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool send(const std::string& text) {
+        size_t done = 0;
+        while (done < text.size()) {
+            ssize_t n = ::write(fd, text.data() + done, text.size() - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    bool read_line(std::string& line) {
+        size_t newline;
+        while ((newline = pending.find('\n')) == std::string::npos) {
+            char buffer[4096];
+            ssize_t n = ::read(fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            pending.append(buffer, n);
+        }
+        line = pending.substr(0, newline);
+        pending.erase(0, newline + 1);
+        return true;
+    }
+
+private:
+    int fd = -1; ///< Connected socket.
+    std::string pending; ///< Received bytes not yet returned as lines.
+};
+
+/**
+ * @brief Results of one client connection.
+ */
+struct ClientResult {
+    size_t correct = 0; ///< Answers matching the test label.
+    size_t answered = 0; ///< Answers received.
+    bool ok = true; ///< Whether every request was answered.
+};
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] [dataset_name]" << std::endl;
+    std::cerr << "Sends test samples to hdc-workload.out --serve and reports latency and throughput (default dataset: "
+              << DATASET << ")" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --socket PATH  Socket of the server (default: /tmp/hdc.sock)" << std::endl;
+    std::cerr << "  --clients N    Concurrent connections (default: 4)" << std::endl;
+    std::cerr << "  --requests N   Requests per connection (default: 1000)" << std::endl;
+    std::cerr << "  --depth N      Requests in flight per connection (default: 1)" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string dataset_name(DATASET);
+    std::string socket_path("/tmp/hdc.sock");
+    int n_clients = 4;
+    int n_requests = 1000;
+    int depth = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (arg == "--clients" && i + 1 < argc) {
+            n_clients = std::stoi(argv[++i]);
+        } else if (arg == "--requests" && i + 1 < argc) {
+            n_requests = std::stoi(argv[++i]);
+        } else if (arg == "--depth" && i + 1 < argc) {
+            depth = std::max(1, std::stoi(argv[++i]));
+        } else if (!arg.empty() && arg[0] != '-') {
+            dataset_name = arg;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Dataset dataset;
+    if (dataset.load_dataset(dataset_name) != 0) {
+        std::cerr << "Failed to load the dataset" << std::endl;
+        return 1;
+    }
+    const LevelView& values = dataset.test.view;
+    const std::vector<int>& labels = dataset.test.labels;
+    if (values.rows() == 0) {
+        std::cerr << "The test set is empty" << std::endl;
+        return 1;
+    }
+
+    // Requests are formatted up front so the client measures the server, not itself
+    std::vector<std::string> lines(values.rows());
+    for (size_t i = 0; i < values.rows(); ++i) {
+        for (size_t j = 0; j < values.cols(); ++j) {
+            lines[i] += std::to_string(values(i, j));
+            lines[i] += j + 1 < values.cols() ? ' ' : '\n';
+        }
+    }
+
+    std::cout << "INFO: dataset = " << dataset_name << ", clients = " << n_clients << ", requests = " << n_requests
+              << ", depth = " << depth << std::endl;
+
+    LatencyStats stats;
+    std::vector<ClientResult> results(n_clients);
+    std::vector<std::thread> clients;
+    auto start = Clock::now();
+    for (int c = 0; c < n_clients; ++c) {
+        clients.emplace_back([&, c] {
+            ClientResult& result = results[c];
+            LineClient client;
+            if (!client.connect(socket_path)) {
+                result.ok = false;
+                return;
+            }
+            std::deque<std::pair<size_t, Clock::time_point>> in_flight;
+            size_t next = c;
+            std::string line;
+            for (int sent = 0, received = 0; received < n_requests;) {
+                while (sent < n_requests && static_cast<int>(in_flight.size()) < depth) {
+                    size_t sample = next++ % lines.size();
+                    in_flight.emplace_back(sample, Clock::now());
+                    if (!client.send(lines[sample])) {
+                        result.ok = false;
+                        return;
+                    }
+                    ++sent;
+                }
+                if (!client.read_line(line)) {
+                    result.ok = false;
+                    return;
+                }
+                auto request = in_flight.front();
+                in_flight.pop_front();
+                stats.record(std::chrono::duration<double, std::micro>(Clock::now() - request.second).count());
+                result.correct += std::atoi(line.c_str()) == labels[request.first];
+                ++result.answered;
+                ++received;
+            }
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    size_t correct = 0;
+    size_t answered = 0;
+    bool ok = true;
+    for (const ClientResult& result : results) {
+        correct += result.correct;
+        answered += result.answered;
+        ok = ok && result.ok;
+    }
+    std::cout << "Client: " << answered << " answers in " << elapsed << " s, " << answered / elapsed
+              << " req/s, p50 " << stats.percentile(50) << " us, p99 " << stats.percentile(99) << " us, acc. "
+              << (answered ? static_cast<double>(correct) / answered : 0.0) << std::endl;
+
+    LineClient client;
+    std::string line;
+    if (client.connect(socket_path) && client.send("stats\n") && client.read_line(line)) {
+        std::cout << "Server: " << line << std::endl;
+    }
+    return ok ? 0 : 1;
+}
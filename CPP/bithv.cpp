@@ -0,0 +1,63 @@
+#include <algorithm>
+
+#include "bithv.h"
+#include "encode_kernels.h"
+
+BitHVs::BitHVs(size_t n, int n_dim)
+    : n_rows(n), n_dim(n_dim), n_words((n_dim + BITS_PER_WORD - 1) / BITS_PER_WORD),
+      bits(n, n_words) {}
+
+BitHVs::BitHVs(HVView<const uint64_t> words, int n_dim)
+    : n_rows(words.rows()), n_dim(n_dim), n_words((n_dim + BITS_PER_WORD - 1) / BITS_PER_WORD), borrowed(words) {}
+
+void BitHVs::pack(size_t i, const int* x) {
+    uint64_t* dst = row(i);
+    for (int w = 0; w < n_words; ++w) {
+        int base = w * BITS_PER_WORD;
+        int n = std::min(BITS_PER_WORD, n_dim - base);
+        uint64_t word = 0;
+        for (int b = 0; b < n; ++b) {
+            word |= static_cast<uint64_t>(x[base + b] > 0) << b;
+        }
+        dst[w] = word;
+    }
+}
+
+void BitHVs::accumulate(size_t i, int* acc, int sign) const {
+    const uint64_t* src = row(i);
+    for (int d = 0; d < n_dim; ++d) {
+        int bit = (src[d / BITS_PER_WORD] >> (d % BITS_PER_WORD)) & 1;
+        acc[d] += sign * (2 * bit - 1);
+    }
+}
+
+std::vector<int> BitHVs::unpack(size_t i) const {
+    std::vector<int> x(n_dim, 0);
+    accumulate(i, x.data(), 1);
+    return x;
+}
+
+BitCounters::BitCounters(int n_dim)
+    : n_dim(n_dim), n_words((n_dim + BitHVs::BITS_PER_WORD - 1) / BitHVs::BITS_PER_WORD),
+      planes(static_cast<size_t>(n_words) * PLANES, 0) {}
+
+void BitCounters::flush(int* counts) {
+    for (int w = 0; w < n_words; ++w) {
+        uint64_t* plane = &planes[static_cast<size_t>(w) * PLANES];
+        int base = w * BitHVs::BITS_PER_WORD;
+        int n = std::min(BitHVs::BITS_PER_WORD, n_dim - base);
+        for (int b = 0; b < n; ++b) {
+            int count = 0;
+            for (int p = 0; p < PLANES; ++p) {
+                count |= static_cast<int>((plane[p] >> b) & 1) << p;
+            }
+            counts[base + b] += count;
+        }
+        std::fill(plane, plane + PLANES, 0);
+    }
+    n_pending = 0;
+}
+
+int bit_dot(const uint64_t* a, const uint64_t* b, int n_words, int n_dim) {
+    return n_dim - 2 * static_cast<int>(xor_popcount_kernel()(a, b, n_words));
+}
@@ -0,0 +1,196 @@
+#ifndef BITHV_H
+#define BITHV_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "hv_matrix.h"
+
+/**
+ * @class BitHVs
+ * @brief A batch of bit-packed binary hypervectors.
+ *
+ * Every hypervector is stored as ceil(n_dim / 64) consecutive 64-bit words in one row of
+ * an HVMatrix. Bit d of a row is set when dimension d is +1 and cleared when it is -1,
+ * matching binarize(). Unused bits of the last word, and the padding words of each row,
+ * are always zero so they never contribute to a popcount.
+ */
+class BitHVs {
+public:
+    static constexpr int BITS_PER_WORD = 64; ///< Dimensions packed into one word.
+
+    BitHVs() = default;
+
+    /**
+     * @brief Creates a batch of n hypervectors with every dimension set to -1.
+     *
+     * @param n Number of hypervectors.
+     * @param n_dim Dimension of each hypervector.
+     */
+    BitHVs(size_t n, int n_dim);
+
+    /**
+     * @brief Wraps packed words owned elsewhere, e.g. a mapped file, without copying.
+     *
+     * The batch is read-only and only valid while the words are. Rows must follow the
+     * layout above, with words() words of zero-padded bits per row.
+     *
+     * @param words One row of packed words per hypervector.
+     * @param n_dim Dimension of each hypervector.
+     */
+    BitHVs(HVView<const uint64_t> words, int n_dim);
+
+    BitHVs(const BitHVs&) = default;
+
+    /**
+     * @brief Takes the words of other and leaves it empty, with no rows and dimension 0.
+     */
+    BitHVs(BitHVs&& other) noexcept { swap(other); }
+
+    BitHVs& operator=(BitHVs other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    /**
+     * @brief Exchanges the hypervectors of two batches.
+     */
+    void swap(BitHVs& other) noexcept {
+        std::swap(n_rows, other.n_rows);
+        std::swap(n_dim, other.n_dim);
+        std::swap(n_words, other.n_words);
+        bits.swap(other.bits);
+        std::swap(borrowed, other.borrowed);
+    }
+
+    /**
+     * @brief Number of hypervectors in the batch.
+     */
+    size_t size() const { return n_rows; }
+
+    /**
+     * @brief Dimension of each hypervector.
+     */
+    int dim() const { return n_dim; }
+
+    /**
+     * @brief Number of 64-bit words per hypervector.
+     */
+    int words() const { return n_words; }
+
+    /**
+     * @brief Returns a pointer to the packed words of hypervector i.
+     */
+    uint64_t* row(size_t i) { return bits.row(i); }
+    const uint64_t* row(size_t i) const { return borrowed.data() ? borrowed.row(i) : bits.row(i); }
+
+    /**
+     * @brief Returns a read-only view of the packed words.
+     */
+    HVView<const uint64_t> view() const { return borrowed.data() ? borrowed : bits.view(); }
+
+    /**
+     * @brief Packs the sign of an integer hypervector into row i.
+     *
+     * @param i Row to overwrite.
+     * @param x n_dim values; positive values become +1, everything else -1.
+     */
+    void pack(size_t i, const int* x);
+
+    /**
+     * @brief Adds sign * (+1/-1) of every dimension of row i onto an integer accumulator.
+     *
+     * @param i Row to read.
+     * @param acc n_dim accumulator values.
+     * @param sign +1 to add the hypervector, -1 to subtract it.
+     */
+    void accumulate(size_t i, int* acc, int sign) const;
+
+    /**
+     * @brief Expands row i back into +1/-1 integers.
+     */
+    std::vector<int> unpack(size_t i) const;
+
+private:
+    size_t n_rows = 0; ///< Number of hypervectors.
+    int n_dim = 0; ///< Dimension of each hypervector.
+    int n_words = 0; ///< Words per hypervector.
+    HVMatrix<uint64_t> bits; ///< Row-major packed words.
+    HVView<const uint64_t> borrowed; ///< Words owned elsewhere; used instead of bits when set.
+};
+
+/**
+ * @class BitCounters
+ * @brief Per-dimension counts of set bits over many packed hypervectors, kept bit-sliced.
+ *
+ * Plane p holds bit p of every dimension's count, so adding a hypervector is a ripple
+ * carry of whole words through the planes (about two word operations per word on
+ * average) instead of one integer add per dimension. The planes hold at most
+ * MAX_PENDING additions and must then be flushed into integer counts.
+ */
+class BitCounters {
+public:
+    static constexpr int PLANES = 8; ///< Bits per bit-sliced count.
+    static constexpr int MAX_PENDING = (1 << PLANES) - 1; ///< Additions the planes can hold.
+
+    BitCounters() = default;
+
+    /**
+     * @brief Creates zeroed counters for hypervectors of n_dim dimensions.
+     */
+    explicit BitCounters(int n_dim);
+
+    /**
+     * @brief Counts the set bits of one packed hypervector of words() words.
+     */
+    void add(const uint64_t* hv) {
+        for (int w = 0; w < n_words; ++w) {
+            uint64_t* plane = &planes[static_cast<size_t>(w) * PLANES];
+            uint64_t carry = hv[w];
+            for (int p = 0; carry != 0 && p < PLANES; ++p) {
+                uint64_t next = plane[p] & carry;
+                plane[p] ^= carry;
+                carry = next;
+            }
+        }
+        ++n_pending;
+    }
+
+    /**
+     * @brief Whether the planes must be flushed before the next add().
+     */
+    bool full() const { return n_pending == MAX_PENDING; }
+
+    /**
+     * @brief Adds the pending count of every dimension to counts and clears the planes.
+     *
+     * @param counts n_dim counters of set bits.
+     */
+    void flush(int* counts);
+
+    int words() const { return n_words; } ///< Number of 64-bit words per hypervector.
+
+private:
+    int n_dim = 0; ///< Dimension of the hypervectors.
+    int n_words = 0; ///< Words per hypervector.
+    int n_pending = 0; ///< Additions since the last flush.
+    std::vector<uint64_t> planes; ///< PLANES words per hypervector word, plane-minor.
+};
+
+/**
+ * @brief Computes the bipolar dot product of two packed hypervectors.
+ *
+ * For +1/-1 vectors the dot product is n_dim - 2 * hamming(a, b), so the similarity
+ * reduces to XOR and popcount over the packed words, with the kernel of xor_popcount_kernel().
+ *
+ * @param a First packed hypervector.
+ * @param b Second packed hypervector.
+ * @param n_words Number of words per hypervector.
+ * @param n_dim Dimension of the hypervectors.
+ * @return The dot product of the unpacked +1/-1 vectors.
+ */
+int bit_dot(const uint64_t* a, const uint64_t* b, int n_words, int n_dim);
+
+#endif // BITHV_H
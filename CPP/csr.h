@@ -0,0 +1,55 @@
+#ifndef CSR_H
+#define CSR_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class CSRView
+ * @brief A non-owning view of sparse samples in compressed sparse row form.
+ *
+ * Matches the csr_info / spectra_idx / spectra_intensities layout of the mass
+ * spectrometry datasets: the entries of sample i are [offsets[i], offsets[i + 1]), each
+ * one a feature (identifier) index and its quantized level. Absent features are simply
+ * not stored, so samples are never padded to the largest one.
+ */
+class CSRView {
+public:
+    CSRView() = default;
+
+    /**
+     * @brief Creates a view over existing CSR arrays.
+     *
+     * @param offsets n_rows + 1 entry offsets (csr_info), starting at 0.
+     * @param ids Feature index of every entry (spectra_idx).
+     * @param levels Quantized level of every entry.
+     * @param n_rows Number of samples.
+     */
+    CSRView(const int64_t* offsets, const int* ids, const int* levels, size_t n_rows)
+        : offsets(offsets), id_ptr(ids), level_ptr(levels), n_rows(n_rows) {}
+
+    size_t rows() const { return n_rows; } ///< Number of samples.
+    size_t size() const { return n_rows; } ///< Number of samples, for container-style loops.
+    size_t nnz() const { return n_rows ? offsets[n_rows] : 0; } ///< Total number of entries.
+    size_t row_nnz(size_t i) const { return offsets[i + 1] - offsets[i]; } ///< Entries of sample i.
+
+    const int* ids(size_t i) const { return id_ptr + offsets[i]; } ///< Feature indices of sample i.
+    const int* levels(size_t i) const { return level_ptr + offsets[i]; } ///< Levels of sample i.
+
+    /**
+     * @brief Returns a view over samples [begin, begin + count).
+     *
+     * The offsets keep pointing into the full entry arrays, so no entry is copied.
+     */
+    CSRView slice(size_t begin, size_t count) const {
+        return CSRView(offsets + begin, id_ptr, level_ptr, count);
+    }
+
+private:
+    const int64_t* offsets = nullptr; ///< Entry offset of every sample, plus the end.
+    const int* id_ptr = nullptr; ///< Feature index of every entry.
+    const int* level_ptr = nullptr; ///< Quantized level of every entry.
+    size_t n_rows = 0; ///< Number of samples.
+};
+
+#endif // CSR_H
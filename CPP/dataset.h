@@ -8,9 +8,135 @@
 #include <vector>
 #include <memory>
 #include <utility>
+#include <initializer_list>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/stat.h>
+
+#include "hv_matrix.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "utils.h"
 
 #define DATASET "EMG_Hand"
 
+/**
+ * @brief Read-only view of the level indices of a subset.
+ *
+ * Text datasets are held as int32, while binary dataset files store levels as uint8 or
+ * uint16 and are viewed in place. visit() hands the typed HVView to a callback, e.g. one
+ * of the HDC::encode overloads.
+ */
+class LevelView {
+public:
+    LevelView() = default;
+    LevelView(HVView<const int> v) : width(sizeof(int)), i32(v) {} ///< View of int32 levels.
+    LevelView(HVView<const uint16_t> v) : width(sizeof(uint16_t)), u16(v) {} ///< View of uint16 levels.
+    LevelView(HVView<const uint8_t> v) : width(sizeof(uint8_t)), u8(v) {} ///< View of uint8 levels.
+
+    size_t rows() const { return width == 1 ? u8.rows() : width == 2 ? u16.rows() : i32.rows(); } ///< Number of samples.
+    size_t cols() const { return width == 1 ? u8.cols() : width == 2 ? u16.cols() : i32.cols(); } ///< Points per sample.
+    int bytes() const { return width; } ///< Bytes per stored level.
+
+    /**
+     * @brief Level j of sample i.
+     */
+    int operator()(size_t i, size_t j) const {
+        return width == 1 ? u8(i, j) : width == 2 ? u16(i, j) : i32(i, j);
+    }
+
+    /**
+     * @brief Returns a view over samples [begin, begin + count).
+     */
+    LevelView slice(size_t begin, size_t count) const {
+        return visit([&](auto v) { return LevelView(v.slice(begin, count)); });
+    }
+
+    /**
+     * @brief Calls fn with the typed view and returns its result.
+     */
+    template <typename Fn>
+    auto visit(Fn&& fn) const -> decltype(fn(std::declval<HVView<const int>>())) {
+        if (width == 1) {
+            return fn(u8);
+        }
+        if (width == 2) {
+            return fn(u16);
+        }
+        return fn(i32);
+    }
+
+private:
+    int width = sizeof(int); ///< Bytes per stored level.
+    HVView<const int> i32; ///< Valid when width == 4.
+    HVView<const uint16_t> u16; ///< Valid when width == 2.
+    HVView<const uint8_t> u8; ///< Valid when width == 1.
+};
+
+/**
+ * @brief Text files a dataset is parsed from, in the order their stamps are stored in DatasetFileHeader.
+ */
+static const char *const DATASET_SOURCE_FILES[] = {"dataset_parameters", "train.val", "train.label", "test.val",
+                                                   "test.label"};
+static const int N_DATASET_SOURCES = 5;
+
+/**
+ * @brief Size and modification time of a file, enough to notice that it was edited.
+ */
+struct FileStamp {
+    uint64_t size = 0; ///< Size in bytes.
+    int64_t mtime_ns = -1; ///< Modification time in nanoseconds since the epoch, or -1 if the file is missing.
+
+    bool operator==(const FileStamp &other) const { return size == other.size && mtime_ns == other.mtime_ns; }
+};
+
+/**
+ * @brief Returns the stamp of a file; a missing file has mtime_ns == -1.
+ */
+inline FileStamp stamp_file(const std::string &filename) {
+    FileStamp stamp;
+    struct stat st;
+    if (::stat(filename.c_str(), &st) == 0) {
+        stamp.size = st.st_size;
+        stamp.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    }
+    return stamp;
+}
+
+/**
+ * @brief Header of a binary dataset file (dataset.bin).
+ *
+ * The header is followed by the train values, train labels, test values and test labels
+ * at the given byte offsets, each aligned to HV_ROW_ALIGN. Values are row-major with a
+ * row stride of HVMatrix<T>::padded_stride(sample_size) elements of value_bytes bytes;
+ * labels are int32. The stamps of the text files it was converted from let readers
+ * notice when those files have changed since.
+ */
+struct DatasetFileHeader {
+    char magic[8]; ///< DATASET_FILE_MAGIC.
+    uint32_t version; ///< DATASET_FILE_VERSION.
+    uint32_t value_bytes; ///< Bytes per level: 1, 2 or 4.
+    uint64_t test_size; ///< Number of test samples.
+    uint64_t train_size; ///< Number of train samples.
+    uint64_t sample_size; ///< Number of points per sample.
+    uint64_t row_stride; ///< Elements between consecutive rows.
+    uint64_t train_values; ///< Byte offset of the train values.
+    uint64_t train_labels; ///< Byte offset of the train labels.
+    uint64_t test_values; ///< Byte offset of the test values.
+    uint64_t test_labels; ///< Byte offset of the test labels.
+    uint64_t file_size; ///< Total size of the file in bytes.
+    uint64_t source_sizes[N_DATASET_SOURCES]; ///< Sizes of the DATASET_SOURCE_FILES at conversion.
+    int64_t source_mtimes[N_DATASET_SOURCES]; ///< Their modification times in nanoseconds, -1 if unknown.
+};
+
+static const char DATASET_FILE_MAGIC[8] = {'H', 'D', 'C', 'D', 'S', 'E', 'T', '\0'};
+static const uint32_t DATASET_FILE_VERSION = 2;
+
 /**
  * @brief Class representing a subset of data (either training or test).
  */
@@ -18,7 +144,8 @@ class DataSubset {
 public:
     int size; /**< The number of samples in the subset. */
     int sample_size; /**< The number of points in each sample. */
-    std::vector<std::vector<int>> values; /**< The values of the samples. */
+    HVMatrix<int> values; /**< The values of the samples read from text, one row per sample. */
+    LevelView view; /**< Read-only view of the values, either of `values` or of a mapped dataset file. */
     std::vector<int> labels; /**< The labels of the samples. */
 
     /**
@@ -38,40 +165,160 @@ public:
     bool read_labels(const std::string &filename);
 };
 
-bool DataSubset::read_values(const std::string &filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file " << filename << std::endl;
+/**
+ * @brief Returns whether c separates values on a line.
+ */
+inline bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * @brief Parses the whitespace-separated integers of one line.
+ *
+ * @param begin First character of the line.
+ * @param end One past the last character, excluding the newline.
+ * @param out Destination of the values.
+ * @param max_values Capacity of out.
+ * @return The number of values on the line, or -1 if a token is not an integer or the
+ *         line holds more than max_values values.
+ */
+inline int parse_int_line(const char *begin, const char *end, int *out, int max_values) {
+    int n = 0;
+    const char *p = begin;
+    while (true) {
+        while (p != end && is_blank(*p)) {
+            ++p;
+        }
+        if (p == end) {
+            return n;
+        }
+        if (n == max_values) {
+            return -1;
+        }
+        auto result = std::from_chars(p, end, out[n]);
+        if (result.ec != std::errc() || (result.ptr != end && !is_blank(*result.ptr))) {
+            return -1;
+        }
+        p = result.ptr;
+        ++n;
+    }
+}
+
+/**
+ * @brief Returns whether [begin, end) holds only blanks.
+ */
+inline bool is_blank_line(const char *begin, const char *end) {
+    return std::all_of(begin, end, is_blank);
+}
+
+inline bool DataSubset::read_values(const std::string &filename) {
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile file;
+    if (!file.open(filename)) {
         return false;
     }
+    const char *data = file.data();
+    const char *data_end = data + file.size();
+
+    // Line-aligned chunks: every chunk starts right after a newline (or at the start of the file)
+    ThreadPool &pool = ThreadPool::global();
+    size_t n_chunks = std::max<size_t>(1, std::min<size_t>(pool.size() * 4, file.size() / (1 << 16)));
+    std::vector<const char *> bounds(n_chunks + 1, data_end);
+    bounds[0] = data;
+    for (size_t c = 1; c < n_chunks; ++c) {
+        const char *p = std::max(bounds[c - 1], data + file.size() * c / n_chunks);
+        const char *nl = static_cast<const char *>(std::memchr(p, '\n', data_end - p));
+        bounds[c] = nl ? nl + 1 : data_end;
+    }
 
-    std::string line;
-    values.resize(size, std::vector<int>(sample_size));
-    int sample_idx = 0;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        for (int point_idx = 0; point_idx < sample_size; ++point_idx) {
-            iss >> values[sample_idx][point_idx];
+    auto for_each_line = [](const char *begin, const char *end, auto fn) {
+        while (begin < end) {
+            const char *nl = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+            const char *line_end = nl ? nl : end;
+            if (!is_blank_line(begin, line_end)) {
+                fn(begin, line_end);
+            }
+            begin = line_end + 1;
+        }
+    };
+
+    // First pass counts the samples of every chunk, so each chunk knows its first row
+    std::vector<size_t> first_row(n_chunks + 1, 0);
+    pool.parallel_for(0, n_chunks, 1, [&](size_t begin, size_t end, int) {
+        for (size_t c = begin; c < end; ++c) {
+            size_t rows = 0;
+            for_each_line(bounds[c], bounds[c + 1], [&](const char *, const char *) { ++rows; });
+            first_row[c + 1] = rows;
         }
-        sample_idx++;
+    });
+    for (size_t c = 0; c < n_chunks; ++c) {
+        first_row[c + 1] += first_row[c];
     }
+    if (first_row[n_chunks] != static_cast<size_t>(size)) {
+        std::cerr << "Error in file " << filename << ": expected " << size << " samples, found "
+                  << first_row[n_chunks] << std::endl;
+        return false;
+    }
+
+    // Second pass parses every chunk straight into its rows
+    values = HVMatrix<int>(size, sample_size, 0, true);
+    std::vector<long> bad_row(n_chunks, -1);
+    pool.parallel_for(0, n_chunks, 1, [&](size_t begin, size_t end, int) {
+        for (size_t c = begin; c < end; ++c) {
+            size_t row = first_row[c];
+            for_each_line(bounds[c], bounds[c + 1], [&](const char *line, const char *line_end) {
+                if (bad_row[c] < 0 && parse_int_line(line, line_end, values.row(row), sample_size) != sample_size) {
+                    bad_row[c] = row;
+                }
+                ++row;
+            });
+        }
+    });
+    for (long row : bad_row) {
+        if (row >= 0) {
+            std::cerr << "Error in file " << filename << ": sample " << row << " does not hold " << sample_size
+                      << " integer values" << std::endl;
+            return false;
+        }
+    }
+
+    view = HVView<const int>(values.view());
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = file.size() / 1e6;
+    std::cout << "INFO: parsed " << filename << " (" << megabytes << " MB) in " << seconds << " s, "
+              << megabytes / seconds << " MB/s" << std::endl;
     return true;
 }
 
-bool DataSubset::read_labels(const std::string &filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file " << filename << std::endl;
+inline bool DataSubset::read_labels(const std::string &filename) {
+    MappedFile file;
+    if (!file.open(filename)) {
         return false;
     }
 
-    std::string line;
-    labels.resize(size);
+    labels.assign(size, 0);
+    const char *p = file.data();
+    const char *end = p + file.size();
     int sample_idx = 0;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        iss >> labels[sample_idx];
-        sample_idx++;
+    while (p < end) {
+        const char *nl = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        const char *line_end = nl ? nl : end;
+        if (!is_blank_line(p, line_end)) {
+            if (sample_idx == size || parse_int_line(p, line_end, &labels[sample_idx], 1) != 1) {
+                std::cerr << "Error in file " << filename << ": bad or extra label on sample " << sample_idx
+                          << std::endl;
+                return false;
+            }
+            sample_idx++;
+        }
+        p = line_end + 1;
+    }
+    if (sample_idx != size) {
+        std::cerr << "Error in file " << filename << ": expected " << size << " labels, found " << sample_idx
+                  << std::endl;
+        return false;
     }
     return true;
 }
@@ -86,6 +333,8 @@ public:
     int sample_size; /**< The number of points in each sample. */
     DataSubset train; /**< The training subset of the dataset. */
     DataSubset test; /**< The test subset of the dataset. */
+    MappedFile file; /**< Mapping of dataset.bin when the dataset was loaded from it. */
+    std::vector<FileStamp> sources; /**< Stamps of the DATASET_SOURCE_FILES when they were parsed. */
 
     /**
      * @brief Reads the dataset parameters from a file.
@@ -97,12 +346,54 @@ public:
 
     /**
      * @brief Loads the dataset from files.
+     *
+     * Maps dataset.bin when it exists and is up to date (see binary_is_current()), so the
+     * values are used in place without parsing or copying; otherwise parses the text files.
      * 
      * @return 0 if the dataset was loaded successfully, 1 otherwise.
      */
 
     int load_dataset(std::string& dataset_name); 
 
+    /**
+     * @brief Parses the text files of a dataset, ignoring any dataset.bin.
+     *
+     * @return 0 if the dataset was loaded successfully, 1 otherwise.
+     */
+    int load_text(const std::string &dataset_name);
+
+    /**
+     * @brief Returns whether base_path holds a dataset.bin that matches its text files.
+     *
+     * A dataset.bin of another version, or one whose recorded stamps differ from a text
+     * file that exists, is stale: a warning is printed and false returned, so the caller
+     * parses the text files instead. Text files that are missing are not compared, so a
+     * dataset shipped as dataset.bin alone is still used.
+     *
+     * @param base_path Directory of the dataset, ending in '/'.
+     * @return false if there is no dataset.bin or it is stale.
+     */
+    static bool binary_is_current(const std::string &base_path);
+
+    /**
+     * @brief Maps a binary dataset file and points the subsets' views into it.
+     *
+     * @param filename The name of the file to map.
+     * @return True if the file was mapped and is valid, false otherwise.
+     */
+    bool map_binary(const std::string &filename);
+
+    /**
+     * @brief Writes the loaded dataset as a binary dataset file.
+     *
+     * Levels are stored in the narrowest of uint8, uint16 and int32 that holds every value,
+     * along with the stamps load_text() took of the text files.
+     *
+     * @param filename The name of the file to write.
+     * @return True if the file was written successfully, false otherwise.
+     */
+    bool write_binary(const std::string &filename);
+
     /**
      * @brief Calculates the checksum of the dataset.
      * 
@@ -110,22 +401,33 @@ public:
      */
     int get_checksum();
 
+    /**
+     * @brief Computes a 64-bit hash of the sizes, levels and labels of both subsets.
+     *
+     * Unlike get_checksum() it is sensitive to the order of values, and it does not depend
+     * on whether the levels were parsed from text or mapped from dataset.bin, so it can key
+     * caches derived from the dataset.
+     *
+     * @return The content hash.
+     */
+    uint64_t get_content_hash() const;
+
     /**
      * @brief Returns the training set as a pair of values and labels.
      * 
-     * @return A pair of vectors, where the first vector contains the values and the second vector contains the labels.
+     * @return A pair where the first element is a view of the values and the second refers to the labels.
      */
-    std::pair<std::vector<std::vector<int>>, std::vector<int>> get_trainset();
+    std::pair<LevelView, const std::vector<int>&> get_trainset() const;
 
     /**
      * @brief Returns the test set as a pair of values and labels.
      * 
-     * @return A pair of vectors, where the first vector contains the values and the second vector contains the labels.
+     * @return A pair where the first element is a view of the values and the second refers to the labels.
      */
-    std::pair<std::vector<std::vector<int>>, std::vector<int>> get_testset();
+    std::pair<LevelView, const std::vector<int>&> get_testset() const;
 };
 
-bool Dataset::read_parameters(const std::string &filename) {
+inline bool Dataset::read_parameters(const std::string &filename) {
     std::ifstream file(filename);
     if (!file.is_open()) {
         std::cerr << "Error opening file " << filename << std::endl;
@@ -147,9 +449,24 @@ bool Dataset::read_parameters(const std::string &filename) {
     return true;
 }
 
-int Dataset::load_dataset(std::string& dataset_name) {
+inline int Dataset::load_dataset(std::string& dataset_name) {
     std::string base_path = "./dataset/" + dataset_name + "/";
 
+    if (binary_is_current(base_path)) {
+        return map_binary(base_path + "dataset.bin") ? 0 : 1;
+    }
+    return load_text(dataset_name);
+}
+
+inline int Dataset::load_text(const std::string &dataset_name) {
+    std::string base_path = "./dataset/" + dataset_name + "/";
+
+    // Stamped before parsing, so an edit made meanwhile leaves a converted file stale
+    sources.clear();
+    for (const char *source : DATASET_SOURCE_FILES) {
+        sources.push_back(stamp_file(base_path + source));
+    }
+
     if (!read_parameters(base_path + "dataset_parameters")) {
         return 1;
     }
@@ -173,31 +490,218 @@ int Dataset::load_dataset(std::string& dataset_name) {
     return 0;
 }
 
-int Dataset::get_checksum() {
-    int N = (1L << 20);
-    int acc = 0;
+inline bool Dataset::binary_is_current(const std::string &base_path) {
+    std::string filename = base_path + "dataset.bin";
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    DatasetFileHeader header;
+    bool current = in.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+                   std::memcmp(header.magic, DATASET_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                   header.version == DATASET_FILE_VERSION;
+    for (int s = 0; s < N_DATASET_SOURCES && current; ++s) {
+        FileStamp stamp = stamp_file(base_path + DATASET_SOURCE_FILES[s]);
+        FileStamp recorded;
+        recorded.size = header.source_sizes[s];
+        recorded.mtime_ns = header.source_mtimes[s];
+        current = stamp.mtime_ns < 0 || stamp == recorded;
+    }
+    if (!current) {
+        std::cerr << "WARNING: " << filename << " does not match the text files of the dataset, parsing them "
+                  << "instead (rerun --convert to refresh it)" << std::endl;
+    }
+    return current;
+}
 
-    for (const auto &sample : train.values) {
-        for (const auto &point : sample) {
-            acc = (point + acc) % N;
+inline bool Dataset::map_binary(const std::string &filename) {
+    if (!file.open(filename)) {
+        return false;
+    }
+
+    DatasetFileHeader header;
+    if (file.size() < sizeof(header)) {
+        std::cerr << "Invalid dataset file " << filename << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, DATASET_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != DATASET_FILE_VERSION || header.file_size != file.size() ||
+        (header.value_bytes != 1 && header.value_bytes != 2 && header.value_bytes != 4) ||
+        header.row_stride < header.sample_size) {
+        std::cerr << "Invalid dataset file " << filename << std::endl;
+        return false;
+    }
+    uint64_t test_end = header.test_values + header.test_size * header.row_stride * header.value_bytes;
+    if (header.train_labels + header.train_size * sizeof(int32_t) > file.size() ||
+        header.test_labels + header.test_size * sizeof(int32_t) > file.size() ||
+        header.train_values + header.train_size * header.row_stride * header.value_bytes > header.train_labels ||
+        test_end > header.test_labels) {
+        std::cerr << "Truncated dataset file " << filename << std::endl;
+        return false;
+    }
+
+    test_size = header.test_size;
+    train_size = header.train_size;
+    sample_size = header.sample_size;
+
+    for (DataSubset *subset : {&train, &test}) {
+        bool is_train = subset == &train;
+        subset->size = is_train ? train_size : test_size;
+        subset->sample_size = sample_size;
+        subset->values = HVMatrix<int>();
+
+        const char *values = file.data() + (is_train ? header.train_values : header.test_values);
+        if (header.value_bytes == 1) {
+            subset->view = HVView<const uint8_t>(reinterpret_cast<const uint8_t *>(values), subset->size,
+                                                 sample_size, header.row_stride);
+        } else if (header.value_bytes == 2) {
+            subset->view = HVView<const uint16_t>(reinterpret_cast<const uint16_t *>(values), subset->size,
+                                                  sample_size, header.row_stride);
+        } else {
+            subset->view = HVView<const int>(reinterpret_cast<const int *>(values), subset->size,
+                                             sample_size, header.row_stride);
         }
+
+        const int32_t *labels = reinterpret_cast<const int32_t *>(
+            file.data() + (is_train ? header.train_labels : header.test_labels));
+        subset->labels.assign(labels, labels + subset->size);
     }
+    return true;
+}
+
+/**
+ * @brief Writes the levels of a view as rows of type T, padded to row_stride elements.
+ */
+template <typename T>
+void write_levels(AlignedFileWriter &out, const LevelView &view, uint64_t row_stride) {
+    std::vector<T> row(row_stride, 0);
+    for (size_t i = 0; i < view.rows(); ++i) {
+        for (size_t j = 0; j < view.cols(); ++j) {
+            row[j] = static_cast<T>(view(i, j));
+        }
+        out.write(row.data(), row_stride * sizeof(T));
+    }
+}
 
-    for (const auto &sample : test.values) {
-        for (const auto &point : sample) {
-            acc = (point + acc) % N;
+inline bool Dataset::write_binary(const std::string &filename) {
+    int max_value = 0;
+    for (const LevelView *view : {&train.view, &test.view}) {
+        for (size_t i = 0; i < view->rows(); ++i) {
+            for (size_t j = 0; j < view->cols(); ++j) {
+                if ((*view)(i, j) < 0) {
+                    std::cerr << "Negative level " << (*view)(i, j) << " cannot be stored" << std::endl;
+                    return false;
+                }
+                max_value = std::max(max_value, (*view)(i, j));
+            }
+        }
+    }
+
+    DatasetFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DATASET_FILE_MAGIC, sizeof(header.magic));
+    header.version = DATASET_FILE_VERSION;
+    header.value_bytes = max_value <= UINT8_MAX ? 1 : max_value <= UINT16_MAX ? 2 : 4;
+    header.test_size = test_size;
+    header.train_size = train_size;
+    header.sample_size = sample_size;
+    header.row_stride = header.value_bytes == 1   ? HVMatrix<uint8_t>::padded_stride(sample_size)
+                        : header.value_bytes == 2 ? HVMatrix<uint16_t>::padded_stride(sample_size)
+                                                  : HVMatrix<int>::padded_stride(sample_size);
+    uint64_t row_bytes = header.row_stride * header.value_bytes;
+    header.train_values = align_to_row(sizeof(header));
+    header.train_labels = align_to_row(header.train_values + train_size * row_bytes);
+    header.test_values = align_to_row(header.train_labels + train_size * sizeof(int32_t));
+    header.test_labels = align_to_row(header.test_values + test_size * row_bytes);
+    header.file_size = header.test_labels + test_size * sizeof(int32_t);
+    for (int s = 0; s < N_DATASET_SOURCES; ++s) {
+        FileStamp stamp = s < static_cast<int>(sources.size()) ? sources[s] : FileStamp();
+        header.source_sizes[s] = stamp.size;
+        header.source_mtimes[s] = stamp.mtime_ns;
+    }
+
+    AlignedFileWriter out;
+    if (!out.open(filename)) {
+        return false;
+    }
+
+    auto write_values = [&](const LevelView &view) {
+        if (header.value_bytes == 1) {
+            write_levels<uint8_t>(out, view, header.row_stride);
+        } else if (header.value_bytes == 2) {
+            write_levels<uint16_t>(out, view, header.row_stride);
+        } else {
+            write_levels<int32_t>(out, view, header.row_stride);
+        }
+    };
+    auto write_labels = [&](const std::vector<int> &labels) {
+        std::vector<int32_t> data(labels.begin(), labels.end());
+        out.write(data.data(), data.size() * sizeof(int32_t));
+    };
+
+    out.write(&header, sizeof(header));
+    out.pad_to(header.train_values);
+    write_values(train.view);
+    out.pad_to(header.train_labels);
+    write_labels(train.labels);
+    out.pad_to(header.test_values);
+    write_values(test.view);
+    out.pad_to(header.test_labels);
+    write_labels(test.labels);
+    return out.commit();
+}
+
+inline int Dataset::get_checksum() {
+    int N = (1L << 20);
+    int acc = 0;
+
+    for (const LevelView *values : {&train.view, &test.view}) {
+        for (size_t i = 0; i < values->rows(); ++i) {
+            for (size_t j = 0; j < values->cols(); ++j) {
+                acc = ((*values)(i, j) + acc) % N;
+            }
         }
     }
 
     return acc;
 }
 
-std::pair<std::vector<std::vector<int>>, std::vector<int>> Dataset::get_trainset() {
-    return std::make_pair(train.values, train.labels);
+inline uint64_t Dataset::get_content_hash() const {
+    uint64_t hash = hash_mix(0, sample_size);
+
+    for (const DataSubset *subset : {&train, &test}) {
+        const LevelView &values = subset->view;
+        // Rows are hashed in parallel and folded in order, so the result is thread-count independent
+        std::vector<uint64_t> row_hash(values.rows());
+        ThreadPool::global().parallel_for(0, values.rows(), 0, [&](size_t begin, size_t end, int) {
+            values.visit([&](auto v) {
+                for (size_t i = begin; i < end; ++i) {
+                    uint64_t h = 0;
+                    for (size_t j = 0; j < v.cols(); ++j) {
+                        h = hash_mix(h, static_cast<uint64_t>(static_cast<int64_t>(v(i, j))));
+                    }
+                    row_hash[i] = h;
+                }
+            });
+        });
+
+        hash = hash_mix(hash, values.rows());
+        for (size_t i = 0; i < values.rows(); ++i) {
+            hash = hash_mix(hash, row_hash[i]);
+            hash = hash_mix(hash, static_cast<uint64_t>(static_cast<int64_t>(subset->labels[i])));
+        }
+    }
+    return hash;
+}
+
+inline std::pair<LevelView, const std::vector<int>&> Dataset::get_trainset() const {
+    return std::pair<LevelView, const std::vector<int>&>(train.view, train.labels);
 }
 
-std::pair<std::vector<std::vector<int>>, std::vector<int>> Dataset::get_testset() {
-    return std::make_pair(test.values, test.labels);
+inline std::pair<LevelView, const std::vector<int>&> Dataset::get_testset() const {
+    return std::pair<LevelView, const std::vector<int>&>(test.view, test.labels);
 }
 
 #endif // DATASET_H
@@ -0,0 +1,1317 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <immintrin.h>
+
+#include "encode_kernels.h"
+
+namespace {
+
+/**
+ * @brief Portable kernel, one block of dimensions at a time so the accumulators stay hot.
+ */
+void bind_bundle_scalar(const int8_t* hv_id, size_t id_stride, const int8_t* hv_lv, size_t lv_stride,
+                        const int* ids, const int* levels, int n_id, int n_dim, int, int* out) {
+    const int block = 64;
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        int n = std::min(block, n_dim - d0);
+        int acc[block] = {0};
+        for (int j = 0; j < n_id; ++j) {
+            const int8_t* id = hv_id + (ids ? ids[j] : j) * id_stride + d0;
+            const int8_t* lv = hv_lv + levels[j] * lv_stride + d0;
+            for (int d = 0; d < n; ++d) {
+                acc[d] += id[d] * lv[d];
+            }
+        }
+        std::memcpy(out + d0, acc, n * sizeof(int));
+    }
+}
+
+/**
+ * @brief SSE4.1 kernel: 32 dimensions per pass, four int16x8 accumulators.
+ */
+__attribute__((target("sse4.2")))
+void bind_bundle_sse42(const int8_t* hv_id, size_t id_stride, const int8_t* hv_lv, size_t lv_stride,
+                       const int* ids, const int* levels, int n_id, int n_dim, int flush_every, int* out) {
+    const int block = 32;
+    alignas(64) int tail[block];
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        __m128i acc32[8];
+        __m128i acc16[4];
+        for (int k = 0; k < 8; ++k) acc32[k] = _mm_setzero_si128();
+        for (int k = 0; k < 4; ++k) acc16[k] = _mm_setzero_si128();
+
+        int pending = 0;
+        for (int j = 0; j < n_id; ++j) {
+            const int8_t* id = hv_id + (ids ? ids[j] : j) * id_stride + d0;
+            const int8_t* lv = hv_lv + levels[j] * lv_stride + d0;
+            for (int h = 0; h < 2; ++h) {
+                __m128i id8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(id + 16 * h));
+                __m128i lv8 = _mm_load_si128(reinterpret_cast<const __m128i*>(lv + 16 * h));
+                __m128i id_lo = _mm_cvtepi8_epi16(id8);
+                __m128i lv_lo = _mm_cvtepi8_epi16(lv8);
+                __m128i id_hi = _mm_cvtepi8_epi16(_mm_srli_si128(id8, 8));
+                __m128i lv_hi = _mm_cvtepi8_epi16(_mm_srli_si128(lv8, 8));
+                acc16[2 * h] = _mm_add_epi16(acc16[2 * h], _mm_mullo_epi16(id_lo, lv_lo));
+                acc16[2 * h + 1] = _mm_add_epi16(acc16[2 * h + 1], _mm_mullo_epi16(id_hi, lv_hi));
+            }
+            if (++pending == flush_every || j == n_id - 1) {
+                for (int k = 0; k < 4; ++k) {
+                    acc32[2 * k] = _mm_add_epi32(acc32[2 * k], _mm_cvtepi16_epi32(acc16[k]));
+                    acc32[2 * k + 1] = _mm_add_epi32(acc32[2 * k + 1], _mm_cvtepi16_epi32(_mm_srli_si128(acc16[k], 8)));
+                    acc16[k] = _mm_setzero_si128();
+                }
+                pending = 0;
+            }
+        }
+
+        int n = std::min(block, n_dim - d0);
+        int* dst = n == block ? out + d0 : tail;
+        for (int k = 0; k < 8; ++k) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * k), acc32[k]);
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief AVX2 kernel: 64 dimensions per pass, four int16x16 accumulators.
+ */
+__attribute__((target("avx2")))
+void bind_bundle_avx2(const int8_t* hv_id, size_t id_stride, const int8_t* hv_lv, size_t lv_stride,
+                      const int* ids, const int* levels, int n_id, int n_dim, int flush_every, int* out) {
+    const int block = 64;
+    alignas(64) int tail[block];
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        __m256i acc32[8];
+        __m256i acc16[4];
+        for (int k = 0; k < 8; ++k) acc32[k] = _mm256_setzero_si256();
+        for (int k = 0; k < 4; ++k) acc16[k] = _mm256_setzero_si256();
+
+        int pending = 0;
+        for (int j = 0; j < n_id; ++j) {
+            const int8_t* id = hv_id + (ids ? ids[j] : j) * id_stride + d0;
+            const int8_t* lv = hv_lv + levels[j] * lv_stride + d0;
+            for (int h = 0; h < 2; ++h) {
+                __m256i id8 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(id + 32 * h));
+                __m256i lv8 = _mm256_load_si256(reinterpret_cast<const __m256i*>(lv + 32 * h));
+                __m256i id_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(id8));
+                __m256i lv_lo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(lv8));
+                __m256i id_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(id8, 1));
+                __m256i lv_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(lv8, 1));
+                acc16[2 * h] = _mm256_add_epi16(acc16[2 * h], _mm256_mullo_epi16(id_lo, lv_lo));
+                acc16[2 * h + 1] = _mm256_add_epi16(acc16[2 * h + 1], _mm256_mullo_epi16(id_hi, lv_hi));
+            }
+            if (++pending == flush_every || j == n_id - 1) {
+                for (int k = 0; k < 4; ++k) {
+                    acc32[2 * k] = _mm256_add_epi32(acc32[2 * k], _mm256_cvtepi16_epi32(_mm256_castsi256_si128(acc16[k])));
+                    acc32[2 * k + 1] = _mm256_add_epi32(acc32[2 * k + 1], _mm256_cvtepi16_epi32(_mm256_extracti128_si256(acc16[k], 1)));
+                    acc16[k] = _mm256_setzero_si256();
+                }
+                pending = 0;
+            }
+        }
+
+        int n = std::min(block, n_dim - d0);
+        int* dst = n == block ? out + d0 : tail;
+        for (int k = 0; k < 8; ++k) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 8 * k), acc32[k]);
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief Portable procedural kernel: one generated word of signs per 64-dimension block.
+ */
+void bind_bundle_procedural_scalar(uint64_t id_seed, const int8_t* hv_lv, size_t lv_stride, const int* ids,
+                                   const int* levels, int n_id, int n_dim, int, int* out) {
+    const int block = 64;
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        int n = std::min(block, n_dim - d0);
+        int acc[block] = {0};
+        for (int j = 0; j < n_id; ++j) {
+            uint64_t bits = item_hv_word(id_seed, ids ? ids[j] : j, d0 / block);
+            const int8_t* lv = hv_lv + levels[j] * lv_stride + d0;
+            for (int d = 0; d < n; ++d) {
+                // (x ^ -1) + 1 == -x, so a set bit negates the level
+                int sign = -static_cast<int>((bits >> d) & 1);
+                acc[d] += (lv[d] ^ sign) - sign;
+            }
+        }
+        std::memcpy(out + d0, acc, n * sizeof(int));
+    }
+}
+
+/**
+ * @brief SSE4.1 procedural kernel: bits expanded to +1/-1 bytes and applied with PSIGNB.
+ */
+__attribute__((target("sse4.2")))
+void bind_bundle_procedural_sse42(uint64_t id_seed, const int8_t* hv_lv, size_t lv_stride, const int* ids,
+                                  const int* levels, int n_id, int n_dim, int flush_every, int* out) {
+    const int block = 32;
+    alignas(64) int tail[block];
+    // Byte i of a 16-bit chunk selects bit i % 8 of source byte i / 8
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i select = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i one = _mm_set1_epi8(1);
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        __m128i acc32[8];
+        __m128i acc16[4];
+        for (int k = 0; k < 8; ++k) acc32[k] = _mm_setzero_si128();
+        for (int k = 0; k < 4; ++k) acc16[k] = _mm_setzero_si128();
+
+        int pending = 0;
+        for (int j = 0; j < n_id; ++j) {
+            uint64_t bits = item_hv_word(id_seed, ids ? ids[j] : j, d0 / 64) >> (d0 % 64);
+            const int8_t* lv = hv_lv + levels[j] * lv_stride + d0;
+            for (int h = 0; h < 2; ++h) {
+                __m128i chunk = _mm_shuffle_epi8(_mm_cvtsi32_si128(static_cast<int>(bits >> (16 * h))), spread);
+                __m128i negate = _mm_cmpeq_epi8(_mm_and_si128(chunk, select), select);
+                __m128i lv8 = _mm_load_si128(reinterpret_cast<const __m128i*>(lv + 16 * h));
+                __m128i bound = _mm_sign_epi8(lv8, _mm_or_si128(negate, one));
+                acc16[2 * h] = _mm_add_epi16(acc16[2 * h], _mm_cvtepi8_epi16(bound));
+                acc16[2 * h + 1] = _mm_add_epi16(acc16[2 * h + 1], _mm_cvtepi8_epi16(_mm_srli_si128(bound, 8)));
+            }
+            if (++pending == flush_every || j == n_id - 1) {
+                for (int k = 0; k < 4; ++k) {
+                    acc32[2 * k] = _mm_add_epi32(acc32[2 * k], _mm_cvtepi16_epi32(acc16[k]));
+                    acc32[2 * k + 1] = _mm_add_epi32(acc32[2 * k + 1], _mm_cvtepi16_epi32(_mm_srli_si128(acc16[k], 8)));
+                    acc16[k] = _mm_setzero_si128();
+                }
+                pending = 0;
+            }
+        }
+
+        int n = std::min(block, n_dim - d0);
+        int* dst = n == block ? out + d0 : tail;
+        for (int k = 0; k < 8; ++k) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * k), acc32[k]);
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief AVX2 procedural kernel: 64 dimensions per pass, signs applied with VPSIGNB.
+ */
+__attribute__((target("avx2")))
+void bind_bundle_procedural_avx2(uint64_t id_seed, const int8_t* hv_lv, size_t lv_stride, const int* ids,
+                                 const int* levels, int n_id, int n_dim, int flush_every, int* out) {
+    const int block = 64;
+    alignas(64) int tail[block];
+    // Byte i of a 32-bit chunk selects bit i % 8 of source byte i / 8; shuffles stay within 128-bit lanes
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i select = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m256i one = _mm256_set1_epi8(1);
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        __m256i acc32[8];
+        __m256i acc16[4];
+        for (int k = 0; k < 8; ++k) acc32[k] = _mm256_setzero_si256();
+        for (int k = 0; k < 4; ++k) acc16[k] = _mm256_setzero_si256();
+
+        int pending = 0;
+        for (int j = 0; j < n_id; ++j) {
+            uint64_t bits = item_hv_word(id_seed, ids ? ids[j] : j, d0 / block);
+            const int8_t* lv = hv_lv + levels[j] * lv_stride + d0;
+            for (int h = 0; h < 2; ++h) {
+                __m256i chunk = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(bits >> (32 * h))), spread);
+                __m256i negate = _mm256_cmpeq_epi8(_mm256_and_si256(chunk, select), select);
+                __m256i lv8 = _mm256_load_si256(reinterpret_cast<const __m256i*>(lv + 32 * h));
+                __m256i bound = _mm256_sign_epi8(lv8, _mm256_or_si256(negate, one));
+                acc16[2 * h] = _mm256_add_epi16(acc16[2 * h], _mm256_cvtepi8_epi16(_mm256_castsi256_si128(bound)));
+                acc16[2 * h + 1] = _mm256_add_epi16(acc16[2 * h + 1],
+                                                    _mm256_cvtepi8_epi16(_mm256_extracti128_si256(bound, 1)));
+            }
+            if (++pending == flush_every || j == n_id - 1) {
+                for (int k = 0; k < 4; ++k) {
+                    acc32[2 * k] = _mm256_add_epi32(acc32[2 * k], _mm256_cvtepi16_epi32(_mm256_castsi256_si128(acc16[k])));
+                    acc32[2 * k + 1] = _mm256_add_epi32(acc32[2 * k + 1], _mm256_cvtepi16_epi32(_mm256_extracti128_si256(acc16[k], 1)));
+                    acc16[k] = _mm256_setzero_si256();
+                }
+                pending = 0;
+            }
+        }
+
+        int n = std::min(block, n_dim - d0);
+        int* dst = n == block ? out + d0 : tail;
+        for (int k = 0; k < 8; ++k) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 8 * k), acc32[k]);
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief Adds lv[d] * (n_members - 2 * count[d]) onto out for bit-sliced counts.
+ *
+ * Bit p of count[d] is bit d % 64 of counts[p * plane_stride + d / 64]. The group-binding
+ * kernels below call the variant of their instruction set once per block of dimensions.
+ */
+void bind_counts_scalar(const uint64_t* counts, int plane_stride, int n_planes, int n_members, const int8_t* lv,
+                        int n_dim, int* out) {
+    for (int d = 0; d < n_dim; ++d) {
+        int count = 0;
+        for (int p = 0; p < n_planes; ++p) {
+            count |= static_cast<int>((counts[p * plane_stride + d / 64] >> (d % 64)) & 1) << p;
+        }
+        out[d] += lv[d] * (n_members - 2 * count);
+    }
+}
+
+/**
+ * @brief Portable group-binding kernel: one word of every member at a time, counted in a ripple of planes.
+ */
+void bind_group_scalar(const uint64_t* const* signs, int n_members, const int8_t* lv, int n_dim, int* out) {
+    const int block = 64;
+    int n_planes = 32 - __builtin_clz(n_members);
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        uint64_t planes[8] = {0};
+        for (int k = 0; k < n_members; ++k) {
+            uint64_t carry = signs[k][d0 / block];
+            // Fully unrolled, so the planes stay in registers
+#pragma GCC unroll 8
+            for (int p = 0; p < 8 && p < n_planes; ++p) {
+                uint64_t next = planes[p] & carry;
+                planes[p] ^= carry;
+                carry = next;
+            }
+        }
+        bind_counts_scalar(planes, 1, n_planes, n_members, lv + d0, std::min(block, n_dim - d0), out + d0);
+    }
+}
+
+/**
+ * @brief SSE4.1 bind_counts_scalar(): bits spread over int16 lanes, counts built by Horner's rule.
+ */
+__attribute__((target("sse4.2")))
+void bind_counts_sse42(const uint64_t* counts, int plane_stride, int n_planes, int n_members, const int8_t* lv,
+                       int n_dim, int* out) {
+    const int block = 64;
+    alignas(64) int tail[block];
+    // Lane i of an 8-dimension chunk tests bit i of its byte
+    const __m128i select = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m128i members = _mm_set1_epi16(static_cast<short>(n_members));
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        const uint64_t* planes = counts + d0 / 64;
+        __m128i count[8];
+        for (int k = 0; k < 8; ++k) count[k] = _mm_setzero_si128();
+        // From the top plane down, count = 2 * count + bit, where a set lane of cmpeq is -1
+        for (int p = n_planes - 1; p >= 0; --p) {
+            for (int k = 0; k < 8; ++k) {
+                __m128i bits = _mm_set1_epi16(static_cast<short>((planes[p * plane_stride] >> (8 * k)) & 0xff));
+                __m128i set = _mm_cmpeq_epi16(_mm_and_si128(bits, select), select);
+                count[k] = _mm_sub_epi16(_mm_add_epi16(count[k], count[k]), set);
+            }
+        }
+
+        int n = std::min(block, n_dim - d0);
+        int* dst = n == block ? out + d0 : tail;
+        if (dst == tail) {
+            std::memcpy(tail, out + d0, n * sizeof(int));
+        }
+        for (int h = 0; h < 4; ++h) {
+            __m128i lv8 = _mm_load_si128(reinterpret_cast<const __m128i*>(lv + d0 + 16 * h));
+            for (int k = 2 * h; k < 2 * h + 2; ++k) {
+                __m128i lv16 = _mm_cvtepi8_epi16(k == 2 * h ? lv8 : _mm_srli_si128(lv8, 8));
+                __m128i sum = _mm_sub_epi16(members, _mm_add_epi16(count[k], count[k]));
+                __m128i bound = _mm_mullo_epi16(sum, lv16);
+                __m128i* acc = reinterpret_cast<__m128i*>(dst + 8 * k);
+                _mm_storeu_si128(acc, _mm_add_epi32(_mm_loadu_si128(acc), _mm_cvtepi16_epi32(bound)));
+                _mm_storeu_si128(acc + 1, _mm_add_epi32(_mm_loadu_si128(acc + 1),
+                                                        _mm_cvtepi16_epi32(_mm_srli_si128(bound, 8))));
+            }
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief AVX2 bind_counts_scalar(): the SSE4.1 expansion on 16 dimensions per vector.
+ */
+__attribute__((target("avx2")))
+void bind_counts_avx2(const uint64_t* counts, int plane_stride, int n_planes, int n_members, const int8_t* lv,
+                      int n_dim, int* out) {
+    const int block = 64;
+    alignas(64) int tail[block];
+    // Lane i of a 16-dimension chunk tests bit i of its 16-bit word
+    const __m256i select = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384,
+                                             -32768);
+    const __m256i members = _mm256_set1_epi16(static_cast<short>(n_members));
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        const uint64_t* planes = counts + d0 / 64;
+        __m256i count[4];
+        for (int k = 0; k < 4; ++k) count[k] = _mm256_setzero_si256();
+        for (int p = n_planes - 1; p >= 0; --p) {
+            for (int k = 0; k < 4; ++k) {
+                __m256i bits = _mm256_set1_epi16(static_cast<short>(planes[p * plane_stride] >> (16 * k)));
+                __m256i set = _mm256_cmpeq_epi16(_mm256_and_si256(bits, select), select);
+                count[k] = _mm256_sub_epi16(_mm256_add_epi16(count[k], count[k]), set);
+            }
+        }
+
+        int n = std::min(block, n_dim - d0);
+        int* dst = n == block ? out + d0 : tail;
+        if (dst == tail) {
+            std::memcpy(tail, out + d0, n * sizeof(int));
+        }
+        for (int h = 0; h < 2; ++h) {
+            __m256i lv8 = _mm256_load_si256(reinterpret_cast<const __m256i*>(lv + d0 + 32 * h));
+            for (int k = 2 * h; k < 2 * h + 2; ++k) {
+                __m256i lv16 = _mm256_cvtepi8_epi16(k == 2 * h ? _mm256_castsi256_si128(lv8)
+                                                               : _mm256_extracti128_si256(lv8, 1));
+                __m256i sum = _mm256_sub_epi16(members, _mm256_add_epi16(count[k], count[k]));
+                __m256i bound = _mm256_mullo_epi16(sum, lv16);
+                __m256i* acc = reinterpret_cast<__m256i*>(dst + 16 * k);
+                _mm256_storeu_si256(acc, _mm256_add_epi32(_mm256_loadu_si256(acc),
+                                                          _mm256_cvtepi16_epi32(_mm256_castsi256_si128(bound))));
+                _mm256_storeu_si256(acc + 1, _mm256_add_epi32(_mm256_loadu_si256(acc + 1),
+                                                              _mm256_cvtepi16_epi32(_mm256_extracti128_si256(bound, 1))));
+            }
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief SSE4.1 group-binding kernel: 128 dimensions per pass, bit-sliced counts kept in registers.
+ */
+__attribute__((target("sse4.2")))
+void bind_group_sse42(const uint64_t* const* signs, int n_members, const int8_t* lv, int n_dim, int* out) {
+    const int block = 128;
+    const int words = block / 64;
+    int n_planes = 32 - __builtin_clz(n_members);
+    alignas(64) uint64_t counts[8 * words];
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        __m128i planes[8];
+        for (int p = 0; p < 8; ++p) planes[p] = _mm_setzero_si128();
+        for (int k = 0; k < n_members; ++k) {
+            __m128i carry = _mm_loadu_si128(reinterpret_cast<const __m128i*>(signs[k] + d0 / 64));
+#pragma GCC unroll 8
+            for (int p = 0; p < 8 && p < n_planes; ++p) {
+                __m128i next = _mm_and_si128(planes[p], carry);
+                planes[p] = _mm_xor_si128(planes[p], carry);
+                carry = next;
+            }
+        }
+        for (int p = 0; p < n_planes; ++p) {
+            _mm_store_si128(reinterpret_cast<__m128i*>(counts + words * p), planes[p]);
+        }
+        bind_counts_sse42(counts, words, n_planes, n_members, lv + d0, std::min(block, n_dim - d0), out + d0);
+    }
+}
+
+/**
+ * @brief AVX2 group-binding kernel: 256 dimensions per pass, bit-sliced counts kept in registers.
+ */
+__attribute__((target("avx2")))
+void bind_group_avx2(const uint64_t* const* signs, int n_members, const int8_t* lv, int n_dim, int* out) {
+    const int block = 256;
+    const int words = block / 64;
+    int n_planes = 32 - __builtin_clz(n_members);
+    alignas(64) uint64_t counts[8 * words];
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        __m256i planes[8];
+        for (int p = 0; p < 8; ++p) planes[p] = _mm256_setzero_si256();
+        for (int k = 0; k < n_members; ++k) {
+            __m256i carry = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(signs[k] + d0 / 64));
+#pragma GCC unroll 8
+            for (int p = 0; p < 8 && p < n_planes; ++p) {
+                __m256i next = _mm256_and_si256(planes[p], carry);
+                planes[p] = _mm256_xor_si256(planes[p], carry);
+                carry = next;
+            }
+        }
+        for (int p = 0; p < n_planes; ++p) {
+            _mm256_store_si256(reinterpret_cast<__m256i*>(counts + words * p), planes[p]);
+        }
+        bind_counts_avx2(counts, words, n_planes, n_members, lv + d0, std::min(block, n_dim - d0), out + d0);
+    }
+}
+
+/**
+ * @brief Bit planes that hold the counts of n XOR-bound features: ones to eights, then the sixteens.
+ */
+int xor_planes(int n) {
+    return 4 + (n < 16 ? 0 : 32 - __builtin_clz(n / 16));
+}
+
+/**
+ * @brief Most planes xor_planes() returns, for the 65535 features a XOR-binding kernel accepts.
+ */
+constexpr int MAX_XOR_PLANES = 16;
+
+/**
+ * @brief Writes the packed binarization of n - 2 * count[d] for n_words words of bit-sliced counts.
+ *
+ * A dimension is +1, a set bit, when count < (n + 1) / 2. The comparison runs bit-serially from
+ * the top plane down on whole words, so it is shared by every instruction set.
+ */
+void threshold_counts(const uint64_t* counts, int plane_stride, int n_planes, int n, int n_words, uint64_t* bits) {
+    const uint64_t threshold = static_cast<uint64_t>(n + 1) / 2;
+    for (int w = 0; w < n_words; ++w) {
+        uint64_t less = 0;
+        uint64_t equal = ~0ULL;
+        for (int p = n_planes - 1; p >= 0; --p) {
+            uint64_t plane = counts[p * plane_stride + w];
+            uint64_t bound = (threshold >> p) & 1 ? ~0ULL : 0;
+            less |= equal & ~plane & bound;
+            equal &= ~(plane ^ bound);
+        }
+        bits[w] = less;
+    }
+}
+
+/**
+ * @brief Overwrites out with n - 2 * count[d] for bit-sliced counts laid out as in bind_counts_scalar().
+ */
+void xor_sums_scalar(const uint64_t* counts, int plane_stride, int n_planes, int n, int n_dim, int* out) {
+    for (int d = 0; d < n_dim; ++d) {
+        int count = 0;
+        for (int p = 0; p < n_planes; ++p) {
+            count |= static_cast<int>((counts[p * plane_stride + d / 64] >> (d % 64)) & 1) << p;
+        }
+        out[d] = n - 2 * count;
+    }
+}
+
+/**
+ * @brief Carry-save adder: high and low are the carry and sum bits of a + b + c, bit by bit.
+ */
+inline void csa_scalar(uint64_t& high, uint64_t& low, uint64_t a, uint64_t b, uint64_t c) {
+    uint64_t u = a ^ b;
+    high = (a & b) | (u & c);
+    low = u ^ c;
+}
+
+/**
+ * @brief Harley-Seal step: adds 16 inputs into the ones to eights planes and returns the carry into the sixteens.
+ */
+inline uint64_t csa_tree_scalar(uint64_t& ones, uint64_t& twos, uint64_t& fours, uint64_t& eights, const uint64_t* x) {
+    uint64_t eights_ab[2];
+    for (int q = 0; q < 2; ++q) {
+        uint64_t fours_ab[2];
+        for (int h = 0; h < 2; ++h) {
+            uint64_t twos_a, twos_b;
+            csa_scalar(twos_a, ones, ones, x[8 * q + 4 * h], x[8 * q + 4 * h + 1]);
+            csa_scalar(twos_b, ones, ones, x[8 * q + 4 * h + 2], x[8 * q + 4 * h + 3]);
+            csa_scalar(fours_ab[h], twos, twos, twos_a, twos_b);
+        }
+        csa_scalar(eights_ab[q], fours, fours, fours_ab[0], fours_ab[1]);
+    }
+    uint64_t sixteens;
+    csa_scalar(sixteens, eights, eights, eights_ab[0], eights_ab[1]);
+    return sixteens;
+}
+
+/**
+ * @brief Portable XOR-binding kernel: one word of every feature at a time.
+ */
+void bind_xor_scalar(const uint64_t* const* ids, const uint64_t* const* lvs, int n, int n_dim, int* out,
+                     uint64_t* bits) {
+    const int block = 64;
+    int n_planes = xor_planes(n);
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        int w = d0 / block;
+        uint64_t planes[MAX_XOR_PLANES] = {0};
+        for (int j0 = 0; j0 < n; j0 += 16) {
+            uint64_t x[16];
+            for (int k = 0; k < 16; ++k) {
+                x[k] = j0 + k < n ? ids[j0 + k][w] ^ lvs[j0 + k][w] : 0;
+            }
+            uint64_t carry = csa_tree_scalar(planes[0], planes[1], planes[2], planes[3], x);
+            for (int p = 4; p < n_planes; ++p) {
+                uint64_t next = planes[p] & carry;
+                planes[p] ^= carry;
+                carry = next;
+            }
+        }
+        if (out) {
+            xor_sums_scalar(planes, 1, n_planes, n, std::min(block, n_dim - d0), out + d0);
+        } else {
+            threshold_counts(planes, 1, n_planes, n, 1, bits + w);
+        }
+    }
+    if (!out && n_dim % 64) {
+        bits[n_dim / 64] &= (1ULL << (n_dim % 64)) - 1;
+    }
+}
+
+/**
+ * @brief SSE4.1 xor_sums_scalar(): the Horner expansion of bind_counts_sse42(), widened to int32.
+ */
+__attribute__((target("sse4.2")))
+void xor_sums_sse42(const uint64_t* counts, int plane_stride, int n_planes, int n, int n_dim, int* out) {
+    const int block = 64;
+    alignas(64) int tail[block];
+    const __m128i select = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m128i total = _mm_set1_epi32(n);
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        const uint64_t* planes = counts + d0 / 64;
+        __m128i count[8];
+        for (int k = 0; k < 8; ++k) count[k] = _mm_setzero_si128();
+        // Counts stay below 65536, so the unsigned int16 lanes are exact
+        for (int p = n_planes - 1; p >= 0; --p) {
+            for (int k = 0; k < 8; ++k) {
+                __m128i bits = _mm_set1_epi16(static_cast<short>((planes[p * plane_stride] >> (8 * k)) & 0xff));
+                __m128i set = _mm_cmpeq_epi16(_mm_and_si128(bits, select), select);
+                count[k] = _mm_sub_epi16(_mm_add_epi16(count[k], count[k]), set);
+            }
+        }
+
+        int n_d = std::min(block, n_dim - d0);
+        int* dst = n_d == block ? out + d0 : tail;
+        for (int k = 0; k < 8; ++k) {
+            __m128i lo = _mm_cvtepu16_epi32(count[k]);
+            __m128i hi = _mm_cvtepu16_epi32(_mm_srli_si128(count[k], 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8 * k), _mm_sub_epi32(total, _mm_add_epi32(lo, lo)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8 * k + 4), _mm_sub_epi32(total, _mm_add_epi32(hi, hi)));
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n_d * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief SSE4.1 carry-save adder on 128-bit vectors.
+ */
+__attribute__((target("sse4.2")))
+inline void csa_sse42(__m128i& high, __m128i& low, __m128i a, __m128i b, __m128i c) {
+    __m128i u = _mm_xor_si128(a, b);
+    high = _mm_or_si128(_mm_and_si128(a, b), _mm_and_si128(u, c));
+    low = _mm_xor_si128(u, c);
+}
+
+/**
+ * @brief SSE4.1 XOR-binding kernel: 128 dimensions per pass, a Harley-Seal tree over 16 features at a time.
+ */
+__attribute__((target("sse4.2")))
+void bind_xor_sse42(const uint64_t* const* ids, const uint64_t* const* lvs, int n, int n_dim, int* out,
+                    uint64_t* bits) {
+    const int block = 128;
+    const int words = block / 64;
+    int n_planes = xor_planes(n);
+    alignas(64) uint64_t counts[MAX_XOR_PLANES * words];
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        int w0 = d0 / 64;
+        __m128i planes[MAX_XOR_PLANES];
+        for (int p = 4; p < n_planes; ++p) planes[p] = _mm_setzero_si128();
+        __m128i ones = _mm_setzero_si128(), twos = ones, fours = ones, eights = ones;
+        for (int j0 = 0; j0 < n; j0 += 16) {
+            __m128i x[16];
+            for (int k = 0; k < 16; ++k) {
+                x[k] = j0 + k < n ? _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ids[j0 + k] + w0)),
+                                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(lvs[j0 + k] + w0)))
+                                  : _mm_setzero_si128();
+            }
+            __m128i eights_ab[2];
+            for (int q = 0; q < 2; ++q) {
+                __m128i fours_ab[2];
+                for (int h = 0; h < 2; ++h) {
+                    __m128i twos_a, twos_b;
+                    csa_sse42(twos_a, ones, ones, x[8 * q + 4 * h], x[8 * q + 4 * h + 1]);
+                    csa_sse42(twos_b, ones, ones, x[8 * q + 4 * h + 2], x[8 * q + 4 * h + 3]);
+                    csa_sse42(fours_ab[h], twos, twos, twos_a, twos_b);
+                }
+                csa_sse42(eights_ab[q], fours, fours, fours_ab[0], fours_ab[1]);
+            }
+            __m128i carry;
+            csa_sse42(carry, eights, eights, eights_ab[0], eights_ab[1]);
+            for (int p = 4; p < n_planes; ++p) {
+                __m128i next = _mm_and_si128(planes[p], carry);
+                planes[p] = _mm_xor_si128(planes[p], carry);
+                carry = next;
+            }
+        }
+        planes[0] = ones;
+        planes[1] = twos;
+        planes[2] = fours;
+        planes[3] = eights;
+        for (int p = 0; p < n_planes; ++p) {
+            _mm_store_si128(reinterpret_cast<__m128i*>(counts + words * p), planes[p]);
+        }
+        if (out) {
+            xor_sums_sse42(counts, words, n_planes, n, std::min(block, n_dim - d0), out + d0);
+        } else {
+            threshold_counts(counts, words, n_planes, n, std::min(words, (n_dim - d0 + 63) / 64), bits + w0);
+        }
+    }
+    if (!out && n_dim % 64) {
+        bits[n_dim / 64] &= (1ULL << (n_dim % 64)) - 1;
+    }
+}
+
+/**
+ * @brief AVX2 xor_sums_scalar(): the Horner expansion of bind_counts_avx2(), widened to int32.
+ */
+__attribute__((target("avx2")))
+void xor_sums_avx2(const uint64_t* counts, int plane_stride, int n_planes, int n, int n_dim, int* out) {
+    const int block = 64;
+    alignas(64) int tail[block];
+    const __m256i select = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384,
+                                             -32768);
+    const __m256i total = _mm256_set1_epi32(n);
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        const uint64_t* planes = counts + d0 / 64;
+        __m256i count[4];
+        for (int k = 0; k < 4; ++k) count[k] = _mm256_setzero_si256();
+        for (int p = n_planes - 1; p >= 0; --p) {
+            for (int k = 0; k < 4; ++k) {
+                __m256i bits = _mm256_set1_epi16(static_cast<short>(planes[p * plane_stride] >> (16 * k)));
+                __m256i set = _mm256_cmpeq_epi16(_mm256_and_si256(bits, select), select);
+                count[k] = _mm256_sub_epi16(_mm256_add_epi16(count[k], count[k]), set);
+            }
+        }
+
+        int n_d = std::min(block, n_dim - d0);
+        int* dst = n_d == block ? out + d0 : tail;
+        for (int k = 0; k < 4; ++k) {
+            __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(count[k]));
+            __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(count[k], 1));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 16 * k),
+                                _mm256_sub_epi32(total, _mm256_add_epi32(lo, lo)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 16 * k + 8),
+                                _mm256_sub_epi32(total, _mm256_add_epi32(hi, hi)));
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n_d * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief AVX2 carry-save adder on 256-bit vectors.
+ */
+__attribute__((target("avx2")))
+inline void csa_avx2(__m256i& high, __m256i& low, __m256i a, __m256i b, __m256i c) {
+    __m256i u = _mm256_xor_si256(a, b);
+    high = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+    low = _mm256_xor_si256(u, c);
+}
+
+/**
+ * @brief AVX2 XOR-binding kernel: 256 dimensions per pass, a Harley-Seal tree over 16 features at a time.
+ */
+__attribute__((target("avx2")))
+void bind_xor_avx2(const uint64_t* const* ids, const uint64_t* const* lvs, int n, int n_dim, int* out,
+                   uint64_t* bits) {
+    const int block = 256;
+    const int words = block / 64;
+    int n_planes = xor_planes(n);
+    alignas(64) uint64_t counts[MAX_XOR_PLANES * words];
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        int w0 = d0 / 64;
+        __m256i planes[MAX_XOR_PLANES];
+        for (int p = 4; p < n_planes; ++p) planes[p] = _mm256_setzero_si256();
+        __m256i ones = _mm256_setzero_si256(), twos = ones, fours = ones, eights = ones;
+        for (int j0 = 0; j0 < n; j0 += 16) {
+            __m256i x[16];
+            for (int k = 0; k < 16; ++k) {
+                x[k] = j0 + k < n
+                           ? _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids[j0 + k] + w0)),
+                                              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lvs[j0 + k] + w0)))
+                           : _mm256_setzero_si256();
+            }
+            __m256i eights_ab[2];
+            for (int q = 0; q < 2; ++q) {
+                __m256i fours_ab[2];
+                for (int h = 0; h < 2; ++h) {
+                    __m256i twos_a, twos_b;
+                    csa_avx2(twos_a, ones, ones, x[8 * q + 4 * h], x[8 * q + 4 * h + 1]);
+                    csa_avx2(twos_b, ones, ones, x[8 * q + 4 * h + 2], x[8 * q + 4 * h + 3]);
+                    csa_avx2(fours_ab[h], twos, twos, twos_a, twos_b);
+                }
+                csa_avx2(eights_ab[q], fours, fours, fours_ab[0], fours_ab[1]);
+            }
+            __m256i carry;
+            csa_avx2(carry, eights, eights, eights_ab[0], eights_ab[1]);
+            for (int p = 4; p < n_planes; ++p) {
+                __m256i next = _mm256_and_si256(planes[p], carry);
+                planes[p] = _mm256_xor_si256(planes[p], carry);
+                carry = next;
+            }
+        }
+        planes[0] = ones;
+        planes[1] = twos;
+        planes[2] = fours;
+        planes[3] = eights;
+        for (int p = 0; p < n_planes; ++p) {
+            _mm256_store_si256(reinterpret_cast<__m256i*>(counts + words * p), planes[p]);
+        }
+        if (out) {
+            xor_sums_avx2(counts, words, n_planes, n, std::min(block, n_dim - d0), out + d0);
+        } else {
+            threshold_counts(counts, words, n_planes, n, std::min(words, (n_dim - d0 + 63) / 64), bits + w0);
+        }
+    }
+    if (!out && n_dim % 64) {
+        bits[n_dim / 64] &= (1ULL << (n_dim % 64)) - 1;
+    }
+}
+
+// GCC 12 flags the _mm512_undefined_* placeholders inside its own AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/**
+ * @brief AVX-512BW kernel: 64 dimensions per pass, two int16x32 accumulators.
+ */
+__attribute__((target("avx512f,avx512bw")))
+void bind_bundle_avx512(const int8_t* hv_id, size_t id_stride, const int8_t* hv_lv, size_t lv_stride,
+                        const int* ids, const int* levels, int n_id, int n_dim, int flush_every, int* out) {
+    const int block = 64;
+    alignas(64) int tail[block];
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        __m512i acc32[4];
+        __m512i acc16[2];
+        for (int k = 0; k < 4; ++k) acc32[k] = _mm512_setzero_si512();
+        for (int k = 0; k < 2; ++k) acc16[k] = _mm512_setzero_si512();
+
+        int pending = 0;
+        for (int j = 0; j < n_id; ++j) {
+            __m512i id8 = _mm512_loadu_si512(hv_id + (ids ? ids[j] : j) * id_stride + d0);
+            __m512i lv8 = _mm512_load_si512(hv_lv + levels[j] * lv_stride + d0);
+            __m512i id_lo = _mm512_cvtepi8_epi16(_mm512_castsi512_si256(id8));
+            __m512i lv_lo = _mm512_cvtepi8_epi16(_mm512_castsi512_si256(lv8));
+            __m512i id_hi = _mm512_cvtepi8_epi16(_mm512_extracti64x4_epi64(id8, 1));
+            __m512i lv_hi = _mm512_cvtepi8_epi16(_mm512_extracti64x4_epi64(lv8, 1));
+            acc16[0] = _mm512_add_epi16(acc16[0], _mm512_mullo_epi16(id_lo, lv_lo));
+            acc16[1] = _mm512_add_epi16(acc16[1], _mm512_mullo_epi16(id_hi, lv_hi));
+            if (++pending == flush_every || j == n_id - 1) {
+                for (int k = 0; k < 2; ++k) {
+                    acc32[2 * k] = _mm512_add_epi32(acc32[2 * k], _mm512_cvtepi16_epi32(_mm512_castsi512_si256(acc16[k])));
+                    acc32[2 * k + 1] = _mm512_add_epi32(acc32[2 * k + 1], _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(acc16[k], 1)));
+                    acc16[k] = _mm512_setzero_si512();
+                }
+                pending = 0;
+            }
+        }
+
+        int n = std::min(block, n_dim - d0);
+        int* dst = n == block ? out + d0 : tail;
+        for (int k = 0; k < 4; ++k) {
+            _mm512_storeu_si512(dst + 16 * k, acc32[k]);
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief AVX-512BW procedural kernel: the generated word is the mask of a masked subtract.
+ */
+__attribute__((target("avx512f,avx512bw")))
+void bind_bundle_procedural_avx512(uint64_t id_seed, const int8_t* hv_lv, size_t lv_stride, const int* ids,
+                                   const int* levels, int n_id, int n_dim, int flush_every, int* out) {
+    const int block = 64;
+    alignas(64) int tail[block];
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        __m512i acc32[4];
+        __m512i acc16[2];
+        for (int k = 0; k < 4; ++k) acc32[k] = _mm512_setzero_si512();
+        for (int k = 0; k < 2; ++k) acc16[k] = _mm512_setzero_si512();
+
+        int pending = 0;
+        for (int j = 0; j < n_id; ++j) {
+            uint64_t bits = item_hv_word(id_seed, ids ? ids[j] : j, d0 / block);
+            __m512i lv8 = _mm512_load_si512(hv_lv + levels[j] * lv_stride + d0);
+            __m512i lv_lo = _mm512_cvtepi8_epi16(_mm512_castsi512_si256(lv8));
+            __m512i lv_hi = _mm512_cvtepi8_epi16(_mm512_extracti64x4_epi64(lv8, 1));
+            acc16[0] = _mm512_mask_sub_epi16(_mm512_add_epi16(acc16[0], lv_lo), static_cast<__mmask32>(bits),
+                                             acc16[0], lv_lo);
+            acc16[1] = _mm512_mask_sub_epi16(_mm512_add_epi16(acc16[1], lv_hi), static_cast<__mmask32>(bits >> 32),
+                                             acc16[1], lv_hi);
+            if (++pending == flush_every || j == n_id - 1) {
+                for (int k = 0; k < 2; ++k) {
+                    acc32[2 * k] = _mm512_add_epi32(acc32[2 * k], _mm512_cvtepi16_epi32(_mm512_castsi512_si256(acc16[k])));
+                    acc32[2 * k + 1] = _mm512_add_epi32(acc32[2 * k + 1], _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(acc16[k], 1)));
+                    acc16[k] = _mm512_setzero_si512();
+                }
+                pending = 0;
+            }
+        }
+
+        int n = std::min(block, n_dim - d0);
+        int* dst = n == block ? out + d0 : tail;
+        for (int k = 0; k < 4; ++k) {
+            _mm512_storeu_si512(dst + 16 * k, acc32[k]);
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief AVX-512BW bind_counts_scalar(): every plane word is the mask of a masked increment.
+ */
+__attribute__((target("avx512f,avx512bw")))
+void bind_counts_avx512(const uint64_t* counts, int plane_stride, int n_planes, int n_members, const int8_t* lv,
+                        int n_dim, int* out) {
+    const int block = 64;
+    alignas(64) int tail[block];
+    const __m512i one = _mm512_set1_epi16(1);
+    const __m512i members = _mm512_set1_epi16(static_cast<short>(n_members));
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        const uint64_t* planes = counts + d0 / 64;
+        __m512i count[2] = {_mm512_setzero_si512(), _mm512_setzero_si512()};
+        for (int p = n_planes - 1; p >= 0; --p) {
+            for (int k = 0; k < 2; ++k) {
+                __m512i twice = _mm512_add_epi16(count[k], count[k]);
+                __mmask32 set = static_cast<__mmask32>(planes[p * plane_stride] >> (32 * k));
+                count[k] = _mm512_mask_add_epi16(twice, set, twice, one);
+            }
+        }
+
+        int n = std::min(block, n_dim - d0);
+        int* dst = n == block ? out + d0 : tail;
+        if (dst == tail) {
+            std::memcpy(tail, out + d0, n * sizeof(int));
+        }
+        __m512i lv8 = _mm512_load_si512(lv + d0);
+        for (int k = 0; k < 2; ++k) {
+            __m512i lv16 = _mm512_cvtepi8_epi16(k == 0 ? _mm512_castsi512_si256(lv8)
+                                                       : _mm512_extracti64x4_epi64(lv8, 1));
+            __m512i sum = _mm512_sub_epi16(members, _mm512_add_epi16(count[k], count[k]));
+            __m512i bound = _mm512_mullo_epi16(sum, lv16);
+            int* acc = dst + 32 * k;
+            _mm512_storeu_si512(acc, _mm512_add_epi32(_mm512_loadu_si512(acc),
+                                                      _mm512_cvtepi16_epi32(_mm512_castsi512_si256(bound))));
+            _mm512_storeu_si512(acc + 16, _mm512_add_epi32(_mm512_loadu_si512(acc + 16),
+                                                           _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(bound, 1))));
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief AVX-512BW group-binding kernel: 512 dimensions per pass, bit-sliced counts kept in registers.
+ */
+__attribute__((target("avx512f,avx512bw")))
+void bind_group_avx512(const uint64_t* const* signs, int n_members, const int8_t* lv, int n_dim, int* out) {
+    const int block = 512;
+    const int words = block / 64;
+    int n_planes = 32 - __builtin_clz(n_members);
+    alignas(64) uint64_t counts[8 * words];
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        __m512i planes[8];
+        for (int p = 0; p < 8; ++p) planes[p] = _mm512_setzero_si512();
+        for (int k = 0; k < n_members; ++k) {
+            __m512i carry = _mm512_loadu_si512(signs[k] + d0 / 64);
+#pragma GCC unroll 8
+            for (int p = 0; p < 8 && p < n_planes; ++p) {
+                __m512i next = _mm512_and_si512(planes[p], carry);
+                planes[p] = _mm512_xor_si512(planes[p], carry);
+                carry = next;
+            }
+        }
+        for (int p = 0; p < n_planes; ++p) {
+            _mm512_store_si512(counts + words * p, planes[p]);
+        }
+        bind_counts_avx512(counts, words, n_planes, n_members, lv + d0, std::min(block, n_dim - d0), out + d0);
+    }
+}
+
+/**
+ * @brief AVX-512BW xor_sums_scalar(): the masked-increment expansion of bind_counts_avx512(), widened to int32.
+ */
+__attribute__((target("avx512f,avx512bw")))
+void xor_sums_avx512(const uint64_t* counts, int plane_stride, int n_planes, int n, int n_dim, int* out) {
+    const int block = 64;
+    alignas(64) int tail[block];
+    const __m512i one = _mm512_set1_epi16(1);
+    const __m512i total = _mm512_set1_epi32(n);
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        const uint64_t* planes = counts + d0 / 64;
+        __m512i count[2] = {_mm512_setzero_si512(), _mm512_setzero_si512()};
+        for (int p = n_planes - 1; p >= 0; --p) {
+            for (int k = 0; k < 2; ++k) {
+                __m512i twice = _mm512_add_epi16(count[k], count[k]);
+                __mmask32 set = static_cast<__mmask32>(planes[p * plane_stride] >> (32 * k));
+                count[k] = _mm512_mask_add_epi16(twice, set, twice, one);
+            }
+        }
+
+        int n_d = std::min(block, n_dim - d0);
+        int* dst = n_d == block ? out + d0 : tail;
+        for (int k = 0; k < 2; ++k) {
+            __m512i lo = _mm512_cvtepu16_epi32(_mm512_castsi512_si256(count[k]));
+            __m512i hi = _mm512_cvtepu16_epi32(_mm512_extracti64x4_epi64(count[k], 1));
+            _mm512_storeu_si512(dst + 32 * k, _mm512_sub_epi32(total, _mm512_add_epi32(lo, lo)));
+            _mm512_storeu_si512(dst + 32 * k + 16, _mm512_sub_epi32(total, _mm512_add_epi32(hi, hi)));
+        }
+        if (dst == tail) {
+            std::memcpy(out + d0, tail, n_d * sizeof(int));
+        }
+    }
+}
+
+/**
+ * @brief AVX-512 carry-save adder: each output is a single VPTERNLOGQ (parity 0x96, majority 0xe8).
+ */
+__attribute__((target("avx512f")))
+inline void csa_avx512(__m512i& high, __m512i& low, __m512i a, __m512i b, __m512i c) {
+    high = _mm512_ternarylogic_epi64(a, b, c, 0xe8);
+    low = _mm512_ternarylogic_epi64(a, b, c, 0x96);
+}
+
+/**
+ * @brief AVX-512BW XOR-binding kernel: 512 dimensions per pass, a Harley-Seal tree over 16 features at a time.
+ */
+__attribute__((target("avx512f,avx512bw")))
+void bind_xor_avx512(const uint64_t* const* ids, const uint64_t* const* lvs, int n, int n_dim, int* out,
+                     uint64_t* bits) {
+    const int block = 512;
+    const int words = block / 64;
+    int n_planes = xor_planes(n);
+    alignas(64) uint64_t counts[MAX_XOR_PLANES * words];
+    for (int d0 = 0; d0 < n_dim; d0 += block) {
+        int w0 = d0 / 64;
+        __m512i planes[MAX_XOR_PLANES];
+        for (int p = 4; p < n_planes; ++p) planes[p] = _mm512_setzero_si512();
+        __m512i ones = _mm512_setzero_si512(), twos = ones, fours = ones, eights = ones;
+        for (int j0 = 0; j0 < n; j0 += 16) {
+            __m512i x[16];
+            for (int k = 0; k < 16; ++k) {
+                x[k] = j0 + k < n ? _mm512_xor_si512(_mm512_loadu_si512(ids[j0 + k] + w0),
+                                                     _mm512_loadu_si512(lvs[j0 + k] + w0))
+                                  : _mm512_setzero_si512();
+            }
+            __m512i eights_ab[2];
+            for (int q = 0; q < 2; ++q) {
+                __m512i fours_ab[2];
+                for (int h = 0; h < 2; ++h) {
+                    __m512i twos_a, twos_b;
+                    csa_avx512(twos_a, ones, ones, x[8 * q + 4 * h], x[8 * q + 4 * h + 1]);
+                    csa_avx512(twos_b, ones, ones, x[8 * q + 4 * h + 2], x[8 * q + 4 * h + 3]);
+                    csa_avx512(fours_ab[h], twos, twos, twos_a, twos_b);
+                }
+                csa_avx512(eights_ab[q], fours, fours, fours_ab[0], fours_ab[1]);
+            }
+            __m512i carry;
+            csa_avx512(carry, eights, eights, eights_ab[0], eights_ab[1]);
+            for (int p = 4; p < n_planes; ++p) {
+                __m512i next = _mm512_and_si512(planes[p], carry);
+                planes[p] = _mm512_xor_si512(planes[p], carry);
+                carry = next;
+            }
+        }
+        planes[0] = ones;
+        planes[1] = twos;
+        planes[2] = fours;
+        planes[3] = eights;
+        for (int p = 0; p < n_planes; ++p) {
+            _mm512_store_si512(counts + words * p, planes[p]);
+        }
+        if (out) {
+            xor_sums_avx512(counts, words, n_planes, n, std::min(block, n_dim - d0), out + d0);
+        } else {
+            threshold_counts(counts, words, n_planes, n, std::min(words, (n_dim - d0 + 63) / 64), bits + w0);
+        }
+    }
+    if (!out && n_dim % 64) {
+        bits[n_dim / 64] &= (1ULL << (n_dim % 64)) - 1;
+    }
+}
+
+#pragma GCC diagnostic pop
+
+/**
+ * @brief Scalar popcount kernel; XOR counts differing bits instead of common ones.
+ */
+template <bool XOR>
+uint64_t popcount_scalar(const uint64_t* a, const uint64_t* b, size_t n_words) {
+    uint64_t count = 0;
+    for (size_t w = 0; w < n_words; ++w) {
+        count += __builtin_popcountll(XOR ? a[w] ^ b[w] : a[w] & b[w]);
+    }
+    return count;
+}
+
+/**
+ * @brief SSE4.2 popcount kernel: the hardware POPCNT instruction, one word at a time.
+ */
+template <bool XOR>
+__attribute__((target("sse4.2,popcnt")))
+uint64_t popcount_sse42(const uint64_t* a, const uint64_t* b, size_t n_words) {
+    uint64_t count = 0;
+    for (size_t w = 0; w < n_words; ++w) {
+        count += _mm_popcnt_u64(XOR ? a[w] ^ b[w] : a[w] & b[w]);
+    }
+    return count;
+}
+
+/**
+ * @brief AVX2 popcount kernel: nibble lookups with PSHUFB, summed per 64-bit lane with PSADBW.
+ */
+template <bool XOR>
+__attribute__((target("avx2,popcnt")))
+uint64_t popcount_avx2(const uint64_t* a, const uint64_t* b, size_t n_words) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    size_t w = 0;
+    for (; w + 4 <= n_words; w += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + w));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + w));
+        __m256i v = XOR ? _mm256_xor_si256(x, y) : _mm256_and_si256(x, y);
+        __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low)),
+                                         _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+    }
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    uint64_t count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; w < n_words; ++w) {
+        count += _mm_popcnt_u64(XOR ? a[w] ^ b[w] : a[w] & b[w]);
+    }
+    return count;
+}
+
+// Same _mm512_undefined_* placeholders, in the broadcast and reduction intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+/**
+ * @brief AVX-512BW popcount kernel: the AVX2 nibble lookup on 512-bit vectors.
+ */
+template <bool XOR>
+__attribute__((target("avx512f,avx512bw,popcnt")))
+uint64_t popcount_avx512(const uint64_t* a, const uint64_t* b, size_t n_words) {
+    const __m512i lookup = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+    const __m512i low = _mm512_set1_epi8(0x0f);
+    __m512i acc = _mm512_setzero_si512();
+    size_t w = 0;
+    for (; w + 8 <= n_words; w += 8) {
+        __m512i x = _mm512_loadu_si512(a + w);
+        __m512i y = _mm512_loadu_si512(b + w);
+        __m512i v = XOR ? _mm512_xor_si512(x, y) : _mm512_and_si512(x, y);
+        __m512i counts = _mm512_add_epi8(_mm512_shuffle_epi8(lookup, _mm512_and_si512(v, low)),
+                                         _mm512_shuffle_epi8(lookup, _mm512_and_si512(_mm512_srli_epi16(v, 4), low)));
+        acc = _mm512_add_epi64(acc, _mm512_sad_epu8(counts, _mm512_setzero_si512()));
+    }
+    uint64_t count = _mm512_reduce_add_epi64(acc);
+    for (; w < n_words; ++w) {
+        count += _mm_popcnt_u64(XOR ? a[w] ^ b[w] : a[w] & b[w]);
+    }
+    return count;
+}
+
+#pragma GCC diagnostic pop
+
+template <bool XOR>
+PopcountFn popcount_kernel_for(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::AVX512:
+        return popcount_avx512<XOR>;
+    case SimdIsa::AVX2:
+        return popcount_avx2<XOR>;
+    case SimdIsa::SSE42:
+        return popcount_sse42<XOR>;
+    default:
+        return popcount_scalar<XOR>;
+    }
+}
+
+BindBundleFn kernel_for(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::AVX512:
+        return bind_bundle_avx512;
+    case SimdIsa::AVX2:
+        return bind_bundle_avx2;
+    case SimdIsa::SSE42:
+        return bind_bundle_sse42;
+    default:
+        return bind_bundle_scalar;
+    }
+}
+
+BindBundleProceduralFn procedural_kernel_for(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::AVX512:
+        return bind_bundle_procedural_avx512;
+    case SimdIsa::AVX2:
+        return bind_bundle_procedural_avx2;
+    case SimdIsa::SSE42:
+        return bind_bundle_procedural_sse42;
+    default:
+        return bind_bundle_procedural_scalar;
+    }
+}
+
+BindGroupFn group_kernel_for(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::AVX512:
+        return bind_group_avx512;
+    case SimdIsa::AVX2:
+        return bind_group_avx2;
+    case SimdIsa::SSE42:
+        return bind_group_sse42;
+    default:
+        return bind_group_scalar;
+    }
+}
+
+BindXorFn xor_kernel_for(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::AVX512:
+        return bind_xor_avx512;
+    case SimdIsa::AVX2:
+        return bind_xor_avx2;
+    case SimdIsa::SSE42:
+        return bind_xor_sse42;
+    default:
+        return bind_xor_scalar;
+    }
+}
+
+SimdIsa initial_isa() {
+    const char* env = std::getenv("HDC_ISA");
+    if (env != nullptr) {
+        SimdIsa isa;
+        if (!parse_isa(env, isa)) {
+            std::cerr << "WARNING: unknown HDC_ISA=" << env << ", using auto-detection" << std::endl;
+        } else if (!isa_supported(isa)) {
+            std::cerr << "WARNING: HDC_ISA=" << env << " is not supported by this CPU, using auto-detection" << std::endl;
+        } else {
+            return isa;
+        }
+    }
+    return detect_isa();
+}
+
+std::atomic<int> current_isa(-1);
+
+} // namespace
+
+bool isa_supported(SimdIsa isa) {
+    __builtin_cpu_init();
+    // The popcount kernels of every level also use POPCNT, which some VMs hide
+    bool popcnt = __builtin_cpu_supports("popcnt");
+    switch (isa) {
+    case SimdIsa::AVX512:
+        return popcnt && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    case SimdIsa::AVX2:
+        return popcnt && __builtin_cpu_supports("avx2");
+    case SimdIsa::SSE42:
+        return popcnt && __builtin_cpu_supports("sse4.2");
+    default:
+        return true;
+    }
+}
+
+SimdIsa detect_isa() {
+    for (SimdIsa isa : {SimdIsa::AVX512, SimdIsa::AVX2, SimdIsa::SSE42}) {
+        if (isa_supported(isa)) {
+            return isa;
+        }
+    }
+    return SimdIsa::SCALAR;
+}
+
+SimdIsa active_isa() {
+    int isa = current_isa.load();
+    if (isa < 0) {
+        int expected = -1;
+        current_isa.compare_exchange_strong(expected, static_cast<int>(initial_isa()));
+        isa = current_isa.load();
+    }
+    return static_cast<SimdIsa>(isa);
+}
+
+BindBundleFn bind_bundle_kernel() {
+    return kernel_for(active_isa());
+}
+
+BindBundleProceduralFn bind_bundle_procedural_kernel() {
+    return procedural_kernel_for(active_isa());
+}
+
+BindGroupFn bind_group_kernel() {
+    return group_kernel_for(active_isa());
+}
+
+BindXorFn bind_xor_kernel() {
+    return xor_kernel_for(active_isa());
+}
+
+PopcountFn and_popcount_kernel() {
+    return popcount_kernel_for<false>(active_isa());
+}
+
+PopcountFn xor_popcount_kernel() {
+    return popcount_kernel_for<true>(active_isa());
+}
+
+bool set_isa(SimdIsa isa) {
+    if (!isa_supported(isa)) {
+        return false;
+    }
+    current_isa.store(static_cast<int>(isa));
+    return true;
+}
+
+bool parse_isa(const std::string& name, SimdIsa& isa) {
+    if (name == "scalar") {
+        isa = SimdIsa::SCALAR;
+    } else if (name == "sse4.2" || name == "sse42") {
+        isa = SimdIsa::SSE42;
+    } else if (name == "avx2") {
+        isa = SimdIsa::AVX2;
+    } else if (name == "avx512") {
+        isa = SimdIsa::AVX512;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* isa_name(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::AVX512:
+        return "avx512";
+    case SimdIsa::AVX2:
+        return "avx2";
+    case SimdIsa::SSE42:
+        return "sse4.2";
+    default:
+        return "scalar";
+    }
+}
+
+int bind_flush_interval(HVView<const int8_t> hv_id, HVView<const int8_t> hv_lv) {
+    auto max_abs = [](HVView<const int8_t> hvs) {
+        int m = 0;
+        for (size_t i = 0; i < hvs.rows(); ++i) {
+            for (size_t d = 0; d < hvs.cols(); ++d) {
+                m = std::max(m, std::abs(static_cast<int>(hvs(i, d))));
+            }
+        }
+        return m;
+    };
+    int bound = max_abs(hv_id) * max_abs(hv_lv);
+    return bound == 0 ? 32767 : 32767 / bound;
+}
@@ -0,0 +1,199 @@
+#ifndef ENCODE_KERNELS_H
+#define ENCODE_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "hv_matrix.h"
+
+/**
+ * @brief Instruction sets the ID-LV encoding kernel is specialized for.
+ */
+enum class SimdIsa {
+    SCALAR, ///< Portable C++ fallback.
+    SSE42, ///< 128-bit SSE4.1/4.2.
+    AVX2, ///< 256-bit AVX2.
+    AVX512, ///< 512-bit AVX-512BW.
+};
+
+/**
+ * @brief Bind-and-bundle kernel: out[d] = sum_j id[ids[j]][d] * lv[levels[j]][d].
+ *
+ * Item memories are stored as int8 since ID and level hypervectors only hold small
+ * values. Products are summed in 16-bit lanes and widened into the 32-bit output every
+ * flush_every features, which keeps the result exact as long as flush_every products
+ * fit in int16 (see bind_flush_interval()).
+ *
+ * @param hv_id Identifier hypervectors, n_id rows of stride id_stride. Rows need not be
+ *              aligned, but must be readable up to the next multiple of 64 dimensions.
+ * @param id_stride Row stride of hv_id; 1 makes ids element offsets, e.g. into rotated rows.
+ * @param hv_lv Level hypervectors of stride lv_stride.
+ * @param lv_stride Row stride of hv_lv, a multiple of 64 elements.
+ * @param ids Identifier index of each feature, or nullptr for dense samples where
+ *            feature j uses identifier j.
+ * @param levels Level index of each of the n_id features.
+ * @param n_id Number of features.
+ * @param n_dim Dimension of hypervectors.
+ * @param flush_every Number of features that can be summed in int16 without overflow.
+ * @param out n_dim output values, overwritten.
+ */
+using BindBundleFn = void (*)(const int8_t* hv_id, size_t id_stride, const int8_t* hv_lv, size_t lv_stride,
+                              const int* ids, const int* levels, int n_id, int n_dim, int flush_every,
+                              int* out);
+
+/**
+ * @brief Bind-and-bundle kernel with procedural identifier hypervectors.
+ *
+ * Same as BindBundleFn, but every identifier hypervector is generated from item_hv_word()
+ * while it is bound instead of being loaded from an item memory, so only the level
+ * hypervectors are read from memory.
+ *
+ * @param id_seed Seed of the identifier hypervectors.
+ */
+using BindBundleProceduralFn = void (*)(uint64_t id_seed, const int8_t* hv_lv, size_t lv_stride, const int* ids,
+                                        const int* levels, int n_id, int n_dim, int flush_every, int* out);
+
+/**
+ * @brief Group-binding kernel: out[d] += lv[d] * sum_k (bit d of signs[k] ? -1 : +1).
+ *
+ * Binds the sum of n_members +1/-1 identifier hypervectors that share one level with that
+ * level hypervector in a single pass. The identifiers are given as sign bits, a set bit
+ * for -1, and their -1 dimensions are counted in bit-sliced counters: plane p holds bit p
+ * of every count, so adding a hypervector is a ripple carry of whole vector registers
+ * through the planes. Each block of dimensions is then expanded once and multiplied by
+ * the level, so the cost is n_members word-wide additions plus one multiply per dimension.
+ *
+ * @param signs Sign bits of each member, readable in whole 512-dimension blocks (8 words);
+ *              bits past n_dim are ignored.
+ * @param n_members Number of members, from 1 to 255, so group sums times levels fit in int16.
+ * @param lv Level hypervector, 64-byte aligned and readable up to the next multiple of 64 dimensions.
+ * @param n_dim Dimension of hypervectors.
+ * @param out n_dim accumulated values.
+ */
+using BindGroupFn = void (*)(const uint64_t* const* signs, int n_members, const int8_t* lv, int n_dim, int* out);
+
+/**
+ * @brief XOR-binding kernel: bundles n features whose identifiers and levels are all +1/-1.
+ *
+ * With bipolar hypervectors binding is XOR of sign bits, a set bit for -1, so feature j
+ * contributes ids[j] ^ lvs[j]. The set bits of all features are counted per dimension with
+ * vertical carry-save adders: a Harley-Seal tree folds 16 features at a time into ones,
+ * twos, fours and eights planes and ripples the carry into higher planes, so a feature
+ * costs about one XOR and two adders per vector register rather than one add per dimension.
+ * The count c[d] is then either expanded into out[d] = n - 2 * c[d], or compared with n / 2
+ * bit-serially to give the binarized bundle as packed bits without any integer sums.
+ *
+ * @param ids Identifier sign bits of each feature, readable in whole 512-dimension blocks (8 words).
+ * @param lvs Level sign bits of each feature, with the same layout.
+ * @param n Number of features, from 0 to 65535, so counts fit in 16 bits.
+ * @param n_dim Dimension of hypervectors.
+ * @param out n_dim output values, overwritten, or nullptr to write bits instead.
+ * @param bits Used when out is nullptr: (n_dim + 63) / 64 words, overwritten with a set bit
+ *             where n - 2 * c[d] > 0 (see binarize()) and zeros past n_dim.
+ */
+using BindXorFn = void (*)(const uint64_t* const* ids, const uint64_t* const* lvs, int n, int n_dim, int* out,
+                           uint64_t* bits);
+
+/**
+ * @brief Popcount kernel: returns the number of bits set in a[w] & b[w], or a[w] ^ b[w], over n_words words.
+ */
+using PopcountFn = uint64_t (*)(const uint64_t* a, const uint64_t* b, size_t n_words);
+
+/**
+ * @brief Returns bits 64 * word to 64 * word + 63 of row `row` of a procedural item memory.
+ *
+ * A set bit stands for -1 and a clear bit for +1. Word w of a row is output w + 1 of a
+ * SplitMix64 generator whose state starts from a hash of (seed, row), so any word of any
+ * row is computed directly in a few multiplies, without state or a stored table.
+ */
+inline uint64_t item_hv_word(uint64_t seed, uint64_t row, uint64_t word) {
+    auto mix = [](uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    };
+    const uint64_t golden = 0x9e3779b97f4a7c15ULL;
+    return mix(mix(seed + row * golden) + (word + 1) * golden);
+}
+
+/**
+ * @brief Returns the best instruction set supported by the running CPU.
+ */
+SimdIsa detect_isa();
+
+/**
+ * @brief Returns whether the running CPU supports isa.
+ */
+bool isa_supported(SimdIsa isa);
+
+/**
+ * @brief Returns the kernel currently used by HDC::encode.
+ *
+ * On first use the kernel is chosen from the HDC_ISA environment variable when set,
+ * otherwise from detect_isa().
+ */
+BindBundleFn bind_bundle_kernel();
+
+/**
+ * @brief Returns the procedural-identifier kernel of the instruction set currently used by HDC::encode.
+ */
+BindBundleProceduralFn bind_bundle_procedural_kernel();
+
+/**
+ * @brief Returns the group-binding kernel of the instruction set currently used by HDC::encode.
+ */
+BindGroupFn bind_group_kernel();
+
+/**
+ * @brief Returns the XOR-binding kernel of the instruction set currently used by HDC::encode.
+ */
+BindXorFn bind_xor_kernel();
+
+/**
+ * @brief Returns the popcount kernel of a[w] & b[w] for the instruction set currently used by HDC::encode.
+ */
+PopcountFn and_popcount_kernel();
+
+/**
+ * @brief Returns the popcount kernel of a[w] ^ b[w], i.e. the Hamming distance, used by bit_dot().
+ */
+PopcountFn xor_popcount_kernel();
+
+/**
+ * @brief Returns the instruction set of the kernel currently used by HDC::encode.
+ */
+SimdIsa active_isa();
+
+/**
+ * @brief Forces the kernel used by HDC::encode, e.g. for benchmarking.
+ *
+ * @param isa Requested instruction set.
+ * @return false if the CPU does not support isa, in which case nothing changes.
+ */
+bool set_isa(SimdIsa isa);
+
+/**
+ * @brief Parses "scalar", "sse4.2", "avx2" or "avx512".
+ *
+ * @param name Instruction set name.
+ * @param isa Parsed instruction set.
+ * @return false if the name is not recognized.
+ */
+bool parse_isa(const std::string& name, SimdIsa& isa);
+
+/**
+ * @brief Returns the printable name of isa.
+ */
+const char* isa_name(SimdIsa isa);
+
+/**
+ * @brief Computes how many ID-LV products can be summed in int16 without overflow.
+ *
+ * @param hv_id Identifier hypervectors.
+ * @param hv_lv Level hypervectors.
+ * @return 32767 / (max|id| * max|lv|), or 32767 when either memory is all zeros.
+ */
+int bind_flush_interval(HVView<const int8_t> hv_id, HVView<const int8_t> hv_lv);
+
+#endif // ENCODE_KERNELS_H
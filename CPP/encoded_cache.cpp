@@ -0,0 +1,126 @@
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "encoded_cache.h"
+#include "utils.h"
+
+namespace {
+
+bool same_key(const EncodedCacheKey& a, const EncodedCacheKey& b) {
+    return a.dataset_hash == b.dataset_hash && a.item_memory_hash == b.item_memory_hash && a.n_dim == b.n_dim &&
+           a.n_lv == b.n_lv && a.n_id == b.n_id && a.binary == b.binary;
+}
+
+/**
+ * @brief Fills the sizes and offsets of a header for train_size + test_size rows.
+ */
+EncodedCacheHeader make_header(const EncodedCacheKey& key, uint32_t word_bytes, size_t train_size,
+                               size_t test_size, size_t row_stride) {
+    EncodedCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, ENCODED_CACHE_MAGIC, sizeof(header.magic));
+    header.version = ENCODED_CACHE_VERSION;
+    header.word_bytes = word_bytes;
+    header.key = key;
+    header.train_size = train_size;
+    header.test_size = test_size;
+    header.row_stride = row_stride;
+    uint64_t row_bytes = row_stride * word_bytes;
+    header.train_offset = align_to_row(sizeof(header));
+    header.test_offset = align_to_row(header.train_offset + train_size * row_bytes);
+    header.file_size = header.test_offset + test_size * row_bytes;
+    return header;
+}
+
+} // namespace
+
+std::string EncodedCache::path(const std::string& dir, const EncodedCacheKey& key) {
+    uint64_t hash = hash_mix(key.dataset_hash, key.item_memory_hash);
+    for (uint32_t v : {key.n_dim, key.n_lv, key.n_id, key.binary}) {
+        hash = hash_mix(hash, v);
+    }
+    std::ostringstream name;
+    name << dir << "/encoded-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+    return name.str();
+}
+
+bool EncodedCache::open(const std::string& filename, const EncodedCacheKey& key) {
+    if (!std::ifstream(filename).good() || !file.open(filename)) {
+        return false;
+    }
+
+    if (file.size() < sizeof(header)) {
+        std::cerr << "Invalid encoding cache " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    uint32_t word_bytes = key.binary ? sizeof(uint64_t) : sizeof(int);
+    uint64_t row_bytes = header.row_stride * header.word_bytes;
+    if (std::memcmp(header.magic, ENCODED_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != ENCODED_CACHE_VERSION || header.word_bytes != word_bytes ||
+        header.file_size != file.size() || header.train_offset % HV_ROW_ALIGN != 0 ||
+        header.test_offset % HV_ROW_ALIGN != 0 || header.train_offset + header.train_size * row_bytes > header.test_offset ||
+        header.test_offset + header.test_size * row_bytes > header.file_size) {
+        std::cerr << "Invalid encoding cache " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    if (!same_key(header.key, key)) {
+        file.close();
+        return false;
+    }
+    uint64_t n_words = key.binary ? (key.n_dim + BitHVs::BITS_PER_WORD - 1) / BitHVs::BITS_PER_WORD : key.n_dim;
+    if (header.row_stride < n_words) {
+        std::cerr << "Invalid encoding cache " << filename << std::endl;
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool EncodedCache::write_file(const std::string& filename, EncodedCacheHeader header, const char* train,
+                              const char* test) {
+    AlignedFileWriter out;
+    if (!out.open(filename)) {
+        return false;
+    }
+
+    uint64_t row_bytes = header.row_stride * header.word_bytes;
+    out.write(&header, sizeof(header));
+    out.pad_to(header.train_offset);
+    out.write(train, header.train_size * row_bytes);
+    out.pad_to(header.test_offset);
+    out.write(test, header.test_size * row_bytes);
+    return out.commit();
+}
+
+bool EncodedCache::write(const std::string& filename, const EncodedCacheKey& key, const HVMatrix<int>& train,
+                         const HVMatrix<int>& test) {
+    EncodedCacheHeader header = make_header(key, sizeof(int), train.rows(), test.rows(), train.stride());
+    return write_file(filename, header, reinterpret_cast<const char*>(train.data()),
+                      reinterpret_cast<const char*>(test.data()));
+}
+
+bool EncodedCache::write(const std::string& filename, const EncodedCacheKey& key, const BitHVs& train,
+                         const BitHVs& test) {
+    EncodedCacheHeader header = make_header(key, sizeof(uint64_t), train.size(), test.size(), train.view().stride());
+    return write_file(filename, header, reinterpret_cast<const char*>(train.view().data()),
+                      reinterpret_cast<const char*>(test.view().data()));
+}
+
+HVView<const int> EncodedCache::values(bool train) const {
+    const int* data = reinterpret_cast<const int*>(file.data() + (train ? header.train_offset : header.test_offset));
+    return HVView<const int>(data, train ? header.train_size : header.test_size, header.key.n_dim, header.row_stride);
+}
+
+BitHVs EncodedCache::bits(bool train) const {
+    const uint64_t* data =
+        reinterpret_cast<const uint64_t*>(file.data() + (train ? header.train_offset : header.test_offset));
+    size_t n_words = (header.key.n_dim + BitHVs::BITS_PER_WORD - 1) / BitHVs::BITS_PER_WORD;
+    HVView<const uint64_t> words(data, train ? header.train_size : header.test_size, n_words, header.row_stride);
+    return BitHVs(words, header.key.n_dim);
+}
@@ -0,0 +1,104 @@
+#ifndef ENCODED_CACHE_H
+#define ENCODED_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "bithv.h"
+#include "hv_matrix.h"
+#include "mapped_file.h"
+
+/**
+ * @brief Everything the encodings of a dataset depend on.
+ */
+struct EncodedCacheKey {
+    uint64_t dataset_hash; ///< Dataset::get_content_hash().
+    uint64_t item_memory_hash; ///< HDC::item_memory_hash(), covering the ID/LV seed and method.
+    uint32_t n_dim; ///< Dimension of the hypervectors.
+    uint32_t n_lv; ///< Number of level hypervectors.
+    uint32_t n_id; ///< Number of identifier hypervectors.
+    uint32_t binary; ///< 1 for bit-packed encodings, 0 for int32 encodings.
+};
+
+/**
+ * @brief Header of an encoded-hypervector cache file.
+ *
+ * The header is followed by the train and test encodings at the given byte offsets, each
+ * aligned to HV_ROW_ALIGN. Rows are row_stride words of word_bytes bytes: int32 values for
+ * integer models, packed uint64 words (see BitHVs) for binary models.
+ */
+struct EncodedCacheHeader {
+    char magic[8]; ///< ENCODED_CACHE_MAGIC.
+    uint32_t version; ///< ENCODED_CACHE_VERSION.
+    uint32_t word_bytes; ///< 4 for int32 rows, 8 for packed rows.
+    EncodedCacheKey key; ///< Key the encodings were computed for.
+    uint64_t train_size; ///< Number of train encodings.
+    uint64_t test_size; ///< Number of test encodings.
+    uint64_t row_stride; ///< Words between consecutive rows.
+    uint64_t train_offset; ///< Byte offset of the train encodings.
+    uint64_t test_offset; ///< Byte offset of the test encodings.
+    uint64_t file_size; ///< Total size of the file in bytes.
+};
+
+static const char ENCODED_CACHE_MAGIC[8] = {'H', 'D', 'C', 'E', 'N', 'C', '\0', '\0'};
+static const uint32_t ENCODED_CACHE_VERSION = 1;
+
+/**
+ * @class EncodedCache
+ * @brief Memory-mapped cache of the train and test encodings of a dataset.
+ *
+ * A cache file is only used when its key matches the current dataset and model exactly,
+ * and its encodings are handed out as views into the mapping, so a hit costs neither
+ * encoding nor copying.
+ */
+class EncodedCache {
+public:
+    /**
+     * @brief Returns the cache file name for a key inside a directory.
+     */
+    static std::string path(const std::string& dir, const EncodedCacheKey& key);
+
+    /**
+     * @brief Maps a cache file if it exists and was written for key.
+     *
+     * @param filename The name of the cache file.
+     * @param key Key of the current dataset and model.
+     * @return True if the file was mapped and matches key, false otherwise.
+     */
+    bool open(const std::string& filename, const EncodedCacheKey& key);
+
+    /**
+     * @brief Writes integer encodings to a cache file.
+     *
+     * @return True if the file was written successfully, false otherwise.
+     */
+    static bool write(const std::string& filename, const EncodedCacheKey& key, const HVMatrix<int>& train,
+                      const HVMatrix<int>& test);
+
+    /**
+     * @brief Writes bit-packed encodings to a cache file.
+     *
+     * @return True if the file was written successfully, false otherwise.
+     */
+    static bool write(const std::string& filename, const EncodedCacheKey& key, const BitHVs& train,
+                      const BitHVs& test);
+
+    /**
+     * @brief Returns a view of the mapped integer train or test encodings.
+     */
+    HVView<const int> values(bool train) const;
+
+    /**
+     * @brief Returns a read-only BitHVs over the mapped packed train or test encodings.
+     */
+    BitHVs bits(bool train) const;
+
+private:
+    MappedFile file; ///< Mapping of the cache file.
+    EncodedCacheHeader header; ///< Header of the mapped file.
+
+    static bool write_file(const std::string& filename, EncodedCacheHeader header, const char* train,
+                           const char* test);
+};
+
+#endif // ENCODED_CACHE_H
@@ -0,0 +1,585 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include "bithv.h"
+#include "encode_kernels.h"
+#include "genome.h"
+#include "thread_pool.h"
+
+namespace {
+
+const uint64_t KMER_HASH_BASE = 0x9e3779b97f4a7c15ULL; ///< Odd multiplier of the rolling k-mer hash.
+
+/**
+ * @brief Returns the rolling hash of every valid k-mer, paired with its start position.
+ *
+ * The hash of s_j ... s_{j+k-1} is sum (code(s_{j+i}) + 1) * KMER_HASH_BASE^(k-1-i) modulo
+ * 2^64, updated in O(1) per position. Windows with an invalid base are left out.
+ */
+std::vector<std::pair<uint64_t, uint32_t>> kmer_hashes(const char* seq, size_t len, int k) {
+    uint64_t top = 1;
+    for (int i = 1; i < k; ++i) {
+        top *= KMER_HASH_BASE;
+    }
+    std::vector<std::pair<uint64_t, uint32_t>> hashes;
+    hashes.reserve(len >= static_cast<size_t>(k) ? len - k + 1 : 0);
+    uint64_t h = 0;
+    int valid = 0; // Valid bases ending at position i
+    for (size_t i = 0; i < len; ++i) {
+        int code = base_code(seq[i]);
+        if (code < 0) {
+            valid = 0;
+            h = 0;
+            continue;
+        }
+        if (valid == k) {
+            h -= (base_code(seq[i - k]) + 1) * top;
+        } else {
+            ++valid;
+        }
+        h = h * KMER_HASH_BASE + code + 1;
+        if (valid == k) {
+            hashes.emplace_back(h, i + 1 - k);
+        }
+    }
+    return hashes;
+}
+
+/**
+ * @brief Returns n <= 64 bits of a packed hypervector starting at bit pos, with pos + n
+ *        inside the hypervector.
+ */
+uint64_t read_bits(const uint64_t* src, int pos, int n) {
+    int w = pos / BitHVs::BITS_PER_WORD;
+    int b = pos % BitHVs::BITS_PER_WORD;
+    uint64_t bits = src[w] >> b;
+    if (b != 0 && b + n > BitHVs::BITS_PER_WORD) {
+        bits |= src[w + 1] << (BitHVs::BITS_PER_WORD - b);
+    }
+    return n == BitHVs::BITS_PER_WORD ? bits : bits & ((uint64_t(1) << n) - 1);
+}
+
+/**
+ * @brief Computes dst = np.roll(src, shift) on packed hypervectors of n_dim bits.
+ *
+ * Bit d of dst is bit (d - shift) mod n_dim of src; every destination word is read as
+ * at most two runs of source bits.
+ */
+void rotate_bits(const uint64_t* src, uint64_t* dst, int n_dim, int shift) {
+    int n_words = (n_dim + BitHVs::BITS_PER_WORD - 1) / BitHVs::BITS_PER_WORD;
+    for (int w = 0; w < n_words; ++w) {
+        int n = std::min(BitHVs::BITS_PER_WORD, n_dim - w * BitHVs::BITS_PER_WORD);
+        int pos = ((w * BitHVs::BITS_PER_WORD - shift) % n_dim + n_dim) % n_dim;
+        int head = std::min(n, n_dim - pos);
+        uint64_t bits = read_bits(src, pos, head);
+        if (head < n) {
+            bits |= read_bits(src, 0, n - head) << head;
+        }
+        dst[w] = bits;
+    }
+}
+
+/**
+ * @brief Marks the first occurrence of every distinct k-mer among the windows starting in
+ *        [begin, end), given their hashes in position order.
+ */
+void mark_first(std::vector<std::pair<uint64_t, uint32_t>>::const_iterator begin,
+                std::vector<std::pair<uint64_t, uint32_t>>::const_iterator end, std::vector<char>& first) {
+    std::vector<std::pair<uint64_t, uint32_t>> sorted(begin, end);
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        if (i == 0 || sorted[i].first != sorted[i - 1].first) {
+            first[sorted[i].second] = 1;
+        }
+    }
+}
+
+const size_t FASTA_BUFFER_SIZE = 1 << 20; ///< Bytes read from a FASTA file at a time.
+
+} // namespace
+
+bool FastaReader::open(const std::string& filename) {
+    file.open(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file " << filename << std::endl;
+        return false;
+    }
+    buffer.resize(FASTA_BUFFER_SIZE);
+    return true;
+}
+
+bool FastaReader::next(std::string& chunk, size_t max_bases, int& record) {
+    chunk.clear();
+    while (chunk.size() < max_bases) {
+        if (pos == filled) {
+            file.read(buffer.data(), buffer.size());
+            filled = file.gcount();
+            pos = 0;
+            if (filled == 0) {
+                break;
+            }
+        }
+        char c = buffer[pos];
+        if (line_start && c == '>') {
+            if (!chunk.empty()) {
+                break; // The chunk ends with its record
+            }
+            in_header = true;
+            record_names.emplace_back();
+            ++pos;
+            line_start = false;
+            continue;
+        }
+        ++pos;
+        line_start = c == '\n';
+        if (in_header) {
+            if (line_start) {
+                in_header = false;
+            } else if (c != '\r') {
+                record_names.back() += c;
+            }
+        } else if (!std::isspace(static_cast<unsigned char>(c))) {
+            if (record_names.empty()) {
+                record_names.emplace_back();
+            }
+            chunk += c;
+        }
+    }
+    record = static_cast<int>(record_names.size()) - 1;
+    return !chunk.empty();
+}
+
+GenomeHDC::GenomeHDC(int k, int n_dim, uint64_t seed)
+    : k(k), n_dim(n_dim), n_words((n_dim + BitHVs::BITS_PER_WORD - 1) / BitHVs::BITS_PER_WORD),
+      base_hvs(4, n_words), shifted_hvs(4, n_words) {
+    if (k < 1 || k > n_dim) {
+        // Left without base hypervectors; add_ref() and add_fasta() report the invalid length
+        return;
+    }
+    std::mt19937_64 rng(seed);
+    for (int b = 0; b < 4; ++b) {
+        uint64_t* base = base_hvs.row(b);
+        for (int d = 0; d < n_dim; ++d) {
+            // A clear bit is +1
+            base[d / BitHVs::BITS_PER_WORD] |= static_cast<uint64_t>(!(rng() & 1)) << (d % BitHVs::BITS_PER_WORD);
+        }
+        rotate_bits(base, shifted_hvs.row(b), n_dim, k % n_dim);
+    }
+}
+
+bool GenomeHDC::encode(const char* kmer, uint64_t* out) const {
+    std::fill(out, out + n_words, 0);
+    std::vector<uint64_t> rolled(n_words);
+    for (int i = 0; i < k; ++i) {
+        int code = base_code(kmer[i]);
+        if (code < 0) {
+            return false;
+        }
+        rotate_bits(base_hvs.row(code), rolled.data(), n_dim, i % n_dim);
+        for (int w = 0; w < n_words; ++w) {
+            out[w] ^= rolled[w];
+        }
+    }
+    return true;
+}
+
+void GenomeHDC::roll_step(const uint64_t* cur, int out, int in, uint64_t* next) const {
+    const uint64_t* unbind = base_hvs.row(out);
+    const uint64_t* bind = shifted_hvs.row(in);
+    // Rolling by -1 moves bit d + 1 to bit d, and bit 0 to bit n_dim - 1
+    uint64_t first = cur[0] ^ unbind[0] ^ bind[0];
+    uint64_t word = first;
+    for (int w = 0; w + 1 < n_words; ++w) {
+        uint64_t following = cur[w + 1] ^ unbind[w + 1] ^ bind[w + 1];
+        next[w] = (word >> 1) | (following << (BitHVs::BITS_PER_WORD - 1));
+        word = following;
+    }
+    next[n_words - 1] = (word >> 1) | ((first & 1) << ((n_dim - 1) % BitHVs::BITS_PER_WORD));
+}
+
+long long GenomeHDC::RefBundle::dot(const uint64_t* hv, int n_words, long long n_set, long long floor) const {
+    // sum_d counts[d] * (1 - 2 bit_d) = sum - 2 * sum over set bits of (offset + planes).
+    // The planes left only lower it, so the partial value bounds the dot product.
+    PopcountFn and_popcount = and_popcount_kernel();
+    long long bound = sum - 2 * offset * n_set;
+    for (int p = n_planes - 1; p >= 0 && bound > floor; --p) {
+        const uint64_t* plane = &planes[static_cast<size_t>(p) * n_words];
+        bound -= static_cast<long long>(and_popcount(plane, hv, n_words)) << (p + 1);
+    }
+    return bound;
+}
+
+long long GenomeHDC::RefBundle::dot(const ReadBundle& read, int n_words) const {
+    // With s_d set bits over the read's m k-mers and counts[d] = offset + v_d,
+    // sum_d (m - 2 s_d) * counts[d] = m * sum - 2 * (offset * sum_d s_d + sum_d s_d * v_d),
+    // and sum_d s_d * v_d adds 2^(p + q) * popcount(plane_p & read_q) over both bit planes.
+    PopcountFn and_popcount = and_popcount_kernel();
+    long long cross = 0;
+    for (int p = 0; p < n_planes; ++p) {
+        const uint64_t* plane = &planes[static_cast<size_t>(p) * n_words];
+        for (int q = 0; q < read.n_planes; ++q) {
+            cross += static_cast<long long>(and_popcount(plane, &read.planes[static_cast<size_t>(q) * n_words],
+                                                         n_words)) << (p + q);
+        }
+    }
+    return read.n_kmers * sum - 2 * (offset * read.n_set + cross);
+}
+
+GenomeHDC::RefBundle GenomeHDC::make_bundle(long long n_kmers, const std::vector<int>& set_counts,
+                                            const GenomeInterval& interval) const {
+    std::vector<int> counts(n_dim);
+    for (int d = 0; d < n_dim; ++d) {
+        counts[d] = n_kmers - 2 * set_counts[d];
+    }
+    return bundle_counts(counts, interval);
+}
+
+GenomeHDC::RefBundle GenomeHDC::bundle_counts(const std::vector<int>& counts, const GenomeInterval& interval) const {
+    RefBundle ref;
+    ref.interval = interval;
+    for (int d = 0; d < n_dim; ++d) {
+        ref.sum += counts[d];
+    }
+    ref.offset = *std::min_element(counts.begin(), counts.end());
+    int range = *std::max_element(counts.begin(), counts.end()) - ref.offset;
+    while (range >> ref.n_planes) {
+        ++ref.n_planes;
+    }
+    ref.planes.assign(static_cast<size_t>(ref.n_planes) * n_words, 0);
+    for (int d = 0; d < n_dim; ++d) {
+        int value = counts[d] - ref.offset;
+        for (int p = 0; p < ref.n_planes; ++p) {
+            ref.planes[static_cast<size_t>(p) * n_words + d / BitHVs::BITS_PER_WORD] |=
+                static_cast<uint64_t>((value >> p) & 1) << (d % BitHVs::BITS_PER_WORD);
+        }
+    }
+    return ref;
+}
+
+void GenomeHDC::add_counts(const RefBundle& ref, std::vector<int>& counts) const {
+    for (int d = 0; d < n_dim; ++d) {
+        int value = 0;
+        for (int p = 0; p < ref.n_planes; ++p) {
+            value |= static_cast<int>((ref.planes[static_cast<size_t>(p) * n_words + d / BitHVs::BITS_PER_WORD] >>
+                                       (d % BitHVs::BITS_PER_WORD)) & 1) << p;
+        }
+        counts[d] += ref.offset + value;
+    }
+}
+
+bool GenomeHDC::check_k() const {
+    if (k < 1 || k > n_dim) {
+        std::cerr << "K-mer length " << k << " must be between 1 and the dimension " << n_dim << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool GenomeHDC::add_ref(const std::string& seq) {
+    if (!check_k()) {
+        return false;
+    }
+    if (seq.size() < static_cast<size_t>(k)) {
+        std::cerr << "Reference must have length >= " << k << std::endl;
+        return false;
+    }
+
+    // Only the first occurrence of every k-mer is bundled, like the set in HDC_GEN.add_ref()
+    std::vector<char> first(seq.size(), 0);
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> hashes = kmer_hashes(seq.data(), seq.size(), k);
+        mark_first(hashes.begin(), hashes.end(), first);
+    }
+
+    // Every thread counts the set bits (-1 dimensions) of its k-mers
+    ThreadPool& pool = ThreadPool::global();
+    std::vector<std::vector<int>> set_counts(pool.size());
+    std::vector<long long> n_kmers(pool.size(), 0);
+    size_t n_windows = seq.size() - k + 1;
+    pool.parallel_for(0, n_windows, 0, [&](size_t begin, size_t end, int tid) {
+        std::vector<int>& counts = set_counts[tid];
+        counts.resize(n_dim, 0);
+        BitCounters counters(n_dim);
+        for_each_kmer(seq.data() + begin, end - begin + k - 1, [&](size_t pos, const uint64_t* hv) {
+            if (first[begin + pos]) {
+                if (counters.full()) {
+                    counters.flush(counts.data());
+                }
+                counters.add(hv);
+                ++n_kmers[tid];
+            }
+        });
+        counters.flush(counts.data());
+    });
+
+    std::vector<int> total(n_dim, 0);
+    long long n_total = 0;
+    for (int t = 0; t < pool.size(); ++t) {
+        n_total += n_kmers[t];
+        for (size_t d = 0; d < set_counts[t].size(); ++d) {
+            total[d] += set_counts[t][d];
+        }
+    }
+    GenomeInterval interval;
+    interval.end = n_windows;
+    ref_hvs.push_back(make_bundle(n_total, total, interval));
+    return true;
+}
+
+void GenomeHDC::build_shards(const Segment& segment, size_t shard_kmers, std::vector<RefBundle>& shards) const {
+    const std::string& bases = segment.bases;
+    size_t n_windows = bases.size() - k + 1;
+
+    // Hashes come in position order, so every shard's windows are one contiguous run
+    std::vector<char> first(n_windows, 0);
+    std::vector<std::pair<uint64_t, uint32_t>> hashes = kmer_hashes(bases.data(), bases.size(), k);
+    for (auto run = hashes.cbegin(); run != hashes.cend();) {
+        size_t shard = run->second / shard_kmers;
+        auto run_end = std::find_if(run, hashes.cend(), [&](const std::pair<uint64_t, uint32_t>& h) {
+            return h.second / shard_kmers != shard;
+        });
+        mark_first(run, run_end, first);
+        run = run_end;
+    }
+
+    BitCounters counters(n_dim);
+    std::vector<int> set_counts(n_dim, 0);
+    long long n_kmers = 0;
+    size_t current = 0;
+    auto finish = [&]() {
+        if (n_kmers > 0) {
+            counters.flush(set_counts.data());
+            GenomeInterval interval;
+            interval.record = segment.record;
+            interval.begin = segment.start + current * shard_kmers;
+            interval.end = segment.start + std::min(n_windows, (current + 1) * shard_kmers);
+            shards.push_back(make_bundle(n_kmers, set_counts, interval));
+            std::fill(set_counts.begin(), set_counts.end(), 0);
+            n_kmers = 0;
+        }
+    };
+    for_each_kmer(bases.data(), bases.size(), [&](size_t pos, const uint64_t* hv) {
+        if (pos / shard_kmers != current) {
+            finish();
+            current = pos / shard_kmers;
+        }
+        if (first[pos]) {
+            if (counters.full()) {
+                counters.flush(set_counts.data());
+            }
+            counters.add(hv);
+            ++n_kmers;
+        }
+    });
+    finish();
+}
+
+bool GenomeHDC::add_fasta(const std::string& filename, size_t shard_kmers) {
+    if (!check_k()) {
+        return false;
+    }
+    if (shard_kmers == 0) {
+        std::cerr << "Shards must hold at least one k-mer" << std::endl;
+        return false;
+    }
+    FastaReader reader;
+    if (!reader.open(filename)) {
+        return false;
+    }
+
+    ThreadPool& pool = ThreadPool::global();
+    size_t batch_size = 4 * pool.size();
+    std::vector<Segment> batch;
+    auto build_batch = [&]() {
+        std::vector<std::vector<RefBundle>> shards(batch.size());
+        pool.parallel_for(0, batch.size(), 1, [&](size_t begin, size_t end, int) {
+            for (size_t i = begin; i < end; ++i) {
+                build_shards(batch[i], shard_kmers, shards[i]);
+            }
+        });
+        for (std::vector<RefBundle>& segment_shards : shards) {
+            for (RefBundle& shard : segment_shards) {
+                ref_hvs.push_back(std::move(shard));
+            }
+        }
+        batch.clear();
+    };
+
+    // Consecutive segments of a record share k - 1 bases, so no window is lost at the cut
+    std::string chunk;
+    std::string tail;
+    uint64_t tail_start = 0;
+    int prev_record = -1;
+    int record;
+    while (reader.next(chunk, SHARDS_PER_SEGMENT * shard_kmers, record)) {
+        if (record != prev_record) {
+            tail.clear();
+            tail_start = 0;
+            prev_record = record;
+        }
+        Segment segment{record, tail_start, tail + chunk};
+        size_t keep = std::min<size_t>(k - 1, segment.bases.size());
+        tail.assign(segment.bases, segment.bases.size() - keep, keep);
+        tail_start = segment.start + segment.bases.size() - keep;
+        if (segment.bases.size() >= static_cast<size_t>(k)) {
+            batch.push_back(std::move(segment));
+        }
+        if (batch.size() == batch_size) {
+            build_batch();
+        }
+    }
+    build_batch();
+    record_names = reader.names();
+    return true;
+}
+
+std::pair<bool, long long> GenomeHDC::query(const std::string& kmer, double threshold) const {
+    std::vector<uint64_t> query_hv(n_words);
+    if (kmer.size() != static_cast<size_t>(k) || !encode(kmer.data(), query_hv.data())) {
+        return {false, 0};
+    }
+    long long n_set = 0;
+    for (uint64_t word : query_hv) {
+        n_set += __builtin_popcountll(word);
+    }
+
+    long long largest = 0;
+    for (const RefBundle& ref : ref_hvs) {
+        largest = std::max(largest, ref.dot(query_hv.data(), n_words, n_set, largest));
+        if (largest > threshold * n_dim) {
+            break;
+        }
+    }
+    return {largest > threshold * n_dim, largest};
+}
+
+bool GenomeHDC::build_tree(int branching) {
+    if (branching < 2) {
+        std::cerr << "Tree nodes need at least 2 children" << std::endl;
+        return false;
+    }
+    this->branching = branching;
+    tree.clear();
+    const std::vector<RefBundle>* children = &ref_hvs;
+    while (children->size() > static_cast<size_t>(branching)) {
+        size_t n_nodes = (children->size() + branching - 1) / branching;
+        std::vector<RefBundle> level(n_nodes);
+        ThreadPool::global().parallel_for(0, n_nodes, 1, [&](size_t begin, size_t end, int) {
+            std::vector<int> counts(n_dim);
+            for (size_t i = begin; i < end; ++i) {
+                size_t first = i * branching;
+                size_t last = std::min(children->size(), first + branching);
+                std::fill(counts.begin(), counts.end(), 0);
+                for (size_t c = first; c < last; ++c) {
+                    add_counts((*children)[c], counts);
+                }
+                GenomeInterval interval = (*children)[first].interval;
+                const GenomeInterval& back = (*children)[last - 1].interval;
+                interval.record = interval.record == back.record ? interval.record : -1;
+                interval.end = back.end;
+                level[i] = bundle_counts(counts, interval);
+            }
+        });
+        tree.push_back(std::move(level));
+        children = &tree.back();
+    }
+    return true;
+}
+
+bool GenomeHDC::encode_read(const std::string& read, ReadBundle& bundle) const {
+    std::vector<int> set_counts(n_dim, 0);
+    BitCounters counters(n_dim);
+    bundle = ReadBundle();
+    bundle.n_kmers = for_each_kmer(read.data(), read.size(), [&](uint64_t, const uint64_t* hv) {
+        if (counters.full()) {
+            counters.flush(set_counts.data());
+        }
+        counters.add(hv);
+    });
+    counters.flush(set_counts.data());
+    if (bundle.n_kmers == 0) {
+        return false;
+    }
+
+    int max_count = *std::max_element(set_counts.begin(), set_counts.end());
+    while (max_count >> bundle.n_planes) {
+        ++bundle.n_planes;
+    }
+    bundle.planes.assign(static_cast<size_t>(bundle.n_planes) * n_words, 0);
+    for (int d = 0; d < n_dim; ++d) {
+        bundle.n_set += set_counts[d];
+        for (int q = 0; q < bundle.n_planes; ++q) {
+            bundle.planes[static_cast<size_t>(q) * n_words + d / BitHVs::BITS_PER_WORD] |=
+                static_cast<uint64_t>((set_counts[d] >> q) & 1) << (d % BitHVs::BITS_PER_WORD);
+        }
+    }
+    return true;
+}
+
+void GenomeHDC::keep_best(std::vector<std::pair<long long, size_t>>& scored, size_t n_best) {
+    n_best = std::min(n_best, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + n_best, scored.end(),
+                      [](const std::pair<long long, size_t>& a, const std::pair<long long, size_t>& b) {
+                          return a.first != b.first ? a.first > b.first : a.second < b.second;
+                      });
+    scored.resize(n_best);
+}
+
+std::vector<GenomeHit> GenomeHDC::locate(const std::string& read, int beam_width, size_t* checks) const {
+    ReadBundle bundle;
+    std::vector<GenomeHit> hits;
+    if (branching == 0 || beam_width < 1 || !encode_read(read, bundle)) {
+        return hits;
+    }
+
+    // (score, node) pairs of the beam; the top level is scored whole, lower levels score
+    // the children of the beam
+    int top = static_cast<int>(tree.size());
+    std::vector<std::pair<long long, size_t>> beam;
+    std::vector<std::pair<long long, size_t>> scored;
+    for (int level = top; level >= 0; --level) {
+        const std::vector<RefBundle>& nodes = level == 0 ? ref_hvs : tree[level - 1];
+        scored.clear();
+        if (level == top) {
+            for (size_t c = 0; c < nodes.size(); ++c) {
+                scored.emplace_back(nodes[c].dot(bundle, n_words), c);
+            }
+        }
+        for (const auto& entry : beam) {
+            size_t first = entry.second * branching;
+            size_t last = std::min(nodes.size(), first + branching);
+            for (size_t c = first; c < last; ++c) {
+                scored.emplace_back(nodes[c].dot(bundle, n_words), c);
+            }
+        }
+        if (checks) {
+            *checks += scored.size();
+        }
+        keep_best(scored, beam_width);
+        beam.swap(scored);
+    }
+    for (const auto& entry : beam) {
+        hits.push_back({ref_hvs[entry.second].interval, entry.first});
+    }
+    return hits;
+}
+
+std::vector<GenomeHit> GenomeHDC::scan(const std::string& read, int n_best) const {
+    ReadBundle bundle;
+    std::vector<GenomeHit> hits;
+    if (n_best < 1 || !encode_read(read, bundle)) {
+        return hits;
+    }
+    std::vector<std::pair<long long, size_t>> scored(ref_hvs.size());
+    for (size_t i = 0; i < ref_hvs.size(); ++i) {
+        scored[i] = {ref_hvs[i].dot(bundle, n_words), i};
+    }
+    keep_best(scored, n_best);
+    for (const auto& entry : scored) {
+        hits.push_back({ref_hvs[entry.second].interval, entry.first});
+    }
+    return hits;
+}
@@ -0,0 +1,394 @@
+#ifndef GENOME_H
+#define GENOME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hv_matrix.h"
+
+/**
+ * @brief Returns the 2-bit code of a nucleotide (A, C, G, T in either case), or -1.
+ */
+inline int base_code(char c) {
+    switch (c) {
+    case 'A': case 'a': return 0;
+    case 'C': case 'c': return 1;
+    case 'G': case 'g': return 2;
+    case 'T': case 't': return 3;
+    default: return -1;
+    }
+}
+
+/**
+ * @class FastaReader
+ * @brief Streams the bases of a multi-record FASTA (.fna) file in bounded chunks.
+ *
+ * Line breaks and whitespace are dropped, every other character of a sequence line is
+ * returned as is (including N and other ambiguity codes), and header lines start a new
+ * record. Sequence lines before the first header form a record with an empty name.
+ */
+class FastaReader {
+public:
+    /**
+     * @brief Opens a FASTA file.
+     *
+     * @return True if the file was opened successfully, false otherwise.
+     */
+    bool open(const std::string& filename);
+
+    /**
+     * @brief Reads the next bases of the current record.
+     *
+     * A chunk never spans two records, so it may be shorter than max_bases at the end of
+     * a record.
+     *
+     * @param chunk Output bases, overwritten.
+     * @param max_bases Most bases returned.
+     * @param record Output index of the record the bases belong to.
+     * @return True if bases were read, false at the end of the file.
+     */
+    bool next(std::string& chunk, size_t max_bases, int& record);
+
+    /**
+     * @brief Names (header lines without '>') of the records seen so far.
+     */
+    const std::vector<std::string>& names() const { return record_names; }
+
+private:
+    std::ifstream file; ///< The FASTA file.
+    std::vector<char> buffer; ///< Bytes read from the file.
+    size_t pos = 0; ///< Next unread byte of buffer.
+    size_t filled = 0; ///< Valid bytes in buffer.
+    bool line_start = true; ///< Whether pos is at the start of a line.
+    bool in_header = false; ///< Whether pos is inside a header line.
+    std::vector<std::string> record_names; ///< Name of every record seen.
+};
+
+/**
+ * @brief Window start positions [begin, end) of a record covered by a reference hypervector.
+ */
+struct GenomeInterval {
+    int record = -1; ///< Index of the FASTA record, or -1 for add_ref().
+    uint64_t begin = 0; ///< First k-mer start position.
+    uint64_t end = 0; ///< One past the last k-mer start position.
+};
+
+/**
+ * @brief A reference hypervector matched by a read, with its dot product.
+ */
+struct GenomeHit {
+    GenomeInterval interval; ///< Windows covered by the reference hypervector.
+    long long dot; ///< Sum of the dot products of the read's k-mers with the bundle.
+};
+
+/**
+ * @class GenomeHDC
+ * @brief C++ counterpart of HDC_GEN in Python/genome.py: k-mer hypervectors bundled into
+ *        reference hypervectors that answer k-mer membership queries.
+ *
+ * The hypervector of the k-mer s_0 ... s_{k-1} is the product of roll(B[s_i], i) over its
+ * bases, where B holds one random +1/-1 hypervector per base and roll() is np.roll. The
+ * k-mer starting one base later follows from it in O(n_dim), whatever k is:
+ *
+ *     H_{j+1} = roll(H_j * B[s_j] * roll(B[s_{j+k}], k), -1)
+ *
+ * i.e. the outgoing base is unbound, the incoming base is bound at shift k and the whole
+ * product is shifted back by one. for_each_kmer() walks a sequence this way.
+ *
+ * K-mer hypervectors are bit-packed like BitHVs rows, but bit d is set when dimension d
+ * is -1, so the elementwise product is XOR and roll() a rotation across words. Reference
+ * hypervectors keep their counters bit-sliced, so that query() is a popcount per counter
+ * bit instead of a multiply per dimension.
+ *
+ * Base hypervectors come from std::mt19937_64, so they differ from the NumPy ones.
+ */
+class GenomeHDC {
+public:
+    static constexpr int SHARDS_PER_SEGMENT = 64; ///< Shards built by one task of add_fasta().
+
+    /**
+     * @brief Creates the base hypervectors.
+     *
+     * @param k Length of a k-mer, from 1 to n_dim; add_ref() and add_fasta() fail for other lengths.
+     * @param n_dim Dimension of hypervectors.
+     * @param seed Seed of the base hypervectors.
+     */
+    GenomeHDC(int k, int n_dim, uint64_t seed = 0);
+
+    int get_k() const { return k; } ///< Length of a k-mer.
+    int get_n_dim() const { return n_dim; } ///< Dimension of hypervectors.
+    int words() const { return n_words; } ///< Number of 64-bit words per k-mer hypervector.
+    size_t get_n_ref() const { return ref_hvs.size(); } ///< Number of reference hypervectors.
+
+    /**
+     * @brief Returns the windows bundled into reference hypervector i.
+     */
+    const GenomeInterval& ref_interval(size_t i) const { return ref_hvs[i].interval; }
+
+    /**
+     * @brief Names of the FASTA records read by add_fasta().
+     */
+    const std::vector<std::string>& get_record_names() const { return record_names; }
+
+    /**
+     * @brief Encodes one k-mer from scratch, in O(k * n_dim / 64).
+     *
+     * @param kmer k bases.
+     * @param out words() packed words.
+     * @return True if every base is A, C, G or T, false otherwise.
+     */
+    bool encode(const char* kmer, uint64_t* out) const;
+
+    /**
+     * @brief Calls fn(pos, hv) for the k-mer at every position of a sequence.
+     *
+     * Each k-mer costs O(n_dim / 64) after the first. Windows containing a base other
+     * than A, C, G or T (e.g. N) are skipped, and the walk restarts after them.
+     *
+     * @param seq The sequence.
+     * @param len Length of seq.
+     * @param fn Called with the start position and the words() packed words of the k-mer.
+     * @return Number of k-mers visited.
+     */
+    template <typename Fn>
+    size_t for_each_kmer(const char* seq, size_t len, Fn fn) const;
+
+    /**
+     * @brief Bundles every distinct k-mer of a sequence into a new reference hypervector.
+     *
+     * Equivalent to HDC_GEN.add_ref(). Distinct k-mers are found by a rolling 64-bit hash
+     * instead of a set of strings, and the windows are encoded on the global thread pool
+     * and counted with BitCounters.
+     *
+     * @param seq The reference sequence, at least k bases long.
+     * @return True if the reference was added, false if it is too short.
+     */
+    bool add_ref(const std::string& seq);
+
+    /**
+     * @brief Streams a FASTA file into reference hypervectors of at most shard_kmers windows.
+     *
+     * A single bundle saturates as it grows: the dot product of a member k-mer is about
+     * n_dim, plus noise of standard deviation sqrt((n - 1) * n_dim) from the n - 1 other
+     * k-mers. Shards bound n, so their margins stay usable at any genome size; n_dim / 64
+     * k-mers keep the noise below n_dim / 8.
+     *
+     * Every record is cut into segments of SHARDS_PER_SEGMENT shards that overlap by
+     * k - 1 bases, batches of segments are built in parallel on the global thread pool,
+     * and k-mers are deduplicated within each shard. Only one batch of bases is held in
+     * memory at a time.
+     *
+     * @param filename The name of the FASTA file.
+     * @param shard_kmers Most k-mer windows per shard.
+     * @return True if the file was read successfully, false otherwise.
+     */
+    bool add_fasta(const std::string& filename, size_t shard_kmers);
+
+    /**
+     * @brief Looks a k-mer up in the reference hypervectors, like HDC_GEN.query().
+     *
+     * References are scanned in order and the scan stops at the first match. A reference
+     * is abandoned as soon as its counter bits processed so far prove that it cannot beat
+     * the largest dot product seen, so the result is exact.
+     *
+     * @param kmer k bases.
+     * @param threshold Fraction of n_dim the dot product must exceed.
+     * @return Whether the k-mer was found, and the largest dot product seen (at least 0).
+     */
+    std::pair<bool, long long> query(const std::string& kmer, double threshold = 0.8) const;
+
+    /**
+     * @brief Builds a tree of bundles over the reference hypervectors for locate().
+     *
+     * The reference hypervectors are the leaves, in genome order; every node of the next
+     * level up bundles (sums) `branching` consecutive nodes, until at most `branching`
+     * nodes remain at the top. Nodes are built level by level on the global thread pool.
+     *
+     * @param branching Children per node, at least 2.
+     * @return True if the tree was built, false if branching is invalid.
+     */
+    bool build_tree(int branching);
+
+    /**
+     * @brief Number of levels of the tree, counting the leaves; 0 before build_tree().
+     */
+    int tree_depth() const { return tree.empty() ? 0 : static_cast<int>(tree.size()) + 1; }
+
+    /**
+     * @brief Returns the leaves most similar to a read by beam search down the tree.
+     *
+     * A node scores the sum of the dot products of every k-mer of the read with its
+     * bundle. The nodes of the top level are scored, the beam_width best are kept and their
+     * children scored at the next level, down to the leaves, so a read costs about
+     * beam_width * branching * tree_depth() node scores instead of one per leaf.
+     *
+     * A node of n k-mers scores about m * n_dim for the m k-mers of a read it contains,
+     * plus noise of standard deviation sqrt(m * n * n_dim), so the upper levels only rank
+     * the right branch first when m * n_dim is well above n: reads much longer than k
+     * localize through deep trees, single k-mers need a wide beam.
+     *
+     * @param read At least k bases; windows with bases other than A, C, G or T are skipped.
+     * @param beam_width Nodes kept per level, and leaves returned.
+     * @param checks If not null, incremented by the number of dot products computed.
+     * @return The best leaves, best first; empty if the read is invalid or there is no tree.
+     */
+    std::vector<GenomeHit> locate(const std::string& read, int beam_width, size_t* checks = nullptr) const;
+
+    /**
+     * @brief Returns the n_best leaves most similar to a read by scoring every leaf.
+     *
+     * The linear-scan baseline of locate(), with the same scores.
+     */
+    std::vector<GenomeHit> scan(const std::string& read, int n_best) const;
+
+private:
+    /**
+     * @brief The k-mers of a read, with the number of -1s in every dimension bit-sliced.
+     */
+    struct ReadBundle {
+        long long n_kmers = 0; ///< Number of k-mers.
+        long long n_set = 0; ///< Set bits over all k-mers.
+        int n_planes = 0; ///< Bits of the largest count.
+        std::vector<uint64_t> planes; ///< n_planes rows of n_words words.
+    };
+
+    /**
+     * @brief A bundled reference hypervector.
+     *
+     * Bit p of dimension d in planes is bit p of counts[d] - offset, where counts is the
+     * sum of the +1/-1 k-mer hypervectors, so the dot product with a packed hypervector
+     * needs n_planes popcounts per word.
+     */
+    struct RefBundle {
+        GenomeInterval interval; ///< Windows bundled into the hypervector.
+        long long sum = 0; ///< Sum of counts.
+        int offset = 0; ///< Smallest count.
+        int n_planes = 0; ///< Bits of the largest count - offset.
+        std::vector<uint64_t> planes; ///< n_planes rows of n_words words.
+
+        /**
+         * @brief Returns the dot product of counts with a packed hypervector.
+         *
+         * Planes are processed from the most significant bit down, and the scan stops
+         * once the dot product is known to be at most floor.
+         *
+         * @param hv Packed hypervector.
+         * @param n_words Words per hypervector.
+         * @param n_set Number of set bits of hv.
+         * @param floor Value the caller does not need to see exceeded.
+         * @return The dot product, or a value at most floor if it is at most floor.
+         */
+        long long dot(const uint64_t* hv, int n_words, long long n_set, long long floor) const;
+
+        /**
+         * @brief Returns the sum of the dot products of counts with the k-mers of a read.
+         */
+        long long dot(const ReadBundle& read, int n_words) const;
+    };
+
+    /**
+     * @brief A piece of one record for add_fasta(): bases starting at start.
+     */
+    struct Segment {
+        int record; ///< Index of the FASTA record.
+        uint64_t start; ///< Position of the first base in the record.
+        std::string bases; ///< The bases, at least k.
+    };
+
+    int k; ///< Length of a k-mer.
+    int n_dim; ///< Dimension of hypervectors.
+    int n_words; ///< Words per packed hypervector.
+    HVMatrix<uint64_t> base_hvs; ///< B[b] for the codes of A, C, G, T.
+    HVMatrix<uint64_t> shifted_hvs; ///< roll(B[b], k), bound to the incoming base.
+    std::vector<RefBundle> ref_hvs; ///< Bundled k-mer hypervectors of every reference.
+    std::vector<std::string> record_names; ///< Names of the FASTA records.
+    std::vector<std::vector<RefBundle>> tree; ///< Levels of build_tree() above the leaves, bottom up.
+    int branching = 0; ///< Children per tree node.
+
+    /**
+     * @brief Computes roll(cur * B[out] * roll(B[in], k), -1) into next.
+     */
+    void roll_step(const uint64_t* cur, int out, int in, uint64_t* next) const;
+
+    /**
+     * @brief Builds a bundle of n_kmers k-mers from the number of -1s in every dimension.
+     */
+    RefBundle make_bundle(long long n_kmers, const std::vector<int>& set_counts, const GenomeInterval& interval) const;
+
+    /**
+     * @brief Builds a bundle from its counters.
+     */
+    RefBundle bundle_counts(const std::vector<int>& counts, const GenomeInterval& interval) const;
+
+    /**
+     * @brief Adds the counters of a bundle to counts.
+     */
+    void add_counts(const RefBundle& ref, std::vector<int>& counts) const;
+
+    /**
+     * @brief Encodes every k-mer of a read for RefBundle::dot().
+     *
+     * @return False if the read holds no valid k-mer.
+     */
+    bool encode_read(const std::string& read, ReadBundle& bundle) const;
+
+    /**
+     * @brief Checks that k is from 1 to n_dim.
+     *
+     * @return True if it is, false after printing an error otherwise.
+     */
+    bool check_k() const;
+
+    /**
+     * @brief Returns the n_best (score, index) pairs, best first, ties to the lower index.
+     */
+    static void keep_best(std::vector<std::pair<long long, size_t>>& scored, size_t n_best);
+
+    /**
+     * @brief Bundles the windows of a segment into shards of at most shard_kmers windows.
+     */
+    void build_shards(const Segment& segment, size_t shard_kmers, std::vector<RefBundle>& shards) const;
+};
+
+template <typename Fn>
+size_t GenomeHDC::for_each_kmer(const char* seq, size_t len, Fn fn) const {
+    std::vector<uint64_t> cur(n_words);
+    std::vector<uint64_t> next(n_words);
+    size_t visited = 0;
+    size_t pos = 0;
+    while (pos + k <= len) {
+        // (Re)start from scratch, skipping past the last invalid base of the window
+        size_t bad = pos + k;
+        for (size_t i = pos + k; i-- > pos;) {
+            if (base_code(seq[i]) < 0) {
+                bad = i;
+                break;
+            }
+        }
+        if (bad < pos + k) {
+            pos = bad + 1;
+            continue;
+        }
+        encode(seq + pos, cur.data());
+        fn(pos, static_cast<const uint64_t*>(cur.data()));
+        ++visited;
+        for (; pos + k < len; ++pos) {
+            int in = base_code(seq[pos + k]);
+            if (in < 0) {
+                break;
+            }
+            roll_step(cur.data(), base_code(seq[pos]), in, next.data());
+            cur.swap(next);
+            fn(pos + 1, static_cast<const uint64_t*>(cur.data()));
+            ++visited;
+        }
+        pos += k + 1;
+    }
+    return visited;
+}
+
+#endif // GENOME_H
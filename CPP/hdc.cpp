@@ -1,172 +1,1173 @@
 #include <cassert>
 #include <cstddef> 
 #include <cmath>
+#include <cstring>
+#include <fstream>
 #include <algorithm>
+#include <atomic>
+#include <initializer_list>
 #include <vector>
 #include <iostream>
 
+#include "encode_kernels.h"
 #include "hdc.h"
+#include "similarity.h"
+#include "thread_pool.h"
 #include "utils.h"
 
+namespace {
 
+/**
+ * @brief Bundles samples into one sum per class, in parallel.
+ *
+ * Every pool thread accumulates its chunk of samples into its own partial bundles, and
+ * the partials are added up afterwards. Integer addition is associative, so the result
+ * is identical to a serial pass regardless of how the samples were split.
+ *
+ * @param n_samples Number of samples.
+ * @param target Class label of each sample; out-of-range labels are ignored.
+ * @param n_class Number of classes.
+ * @param n_dim Dimension of hypervectors.
+ * @param add Callback that adds sample j onto an n_dim accumulator.
+ * @return One bundled row per class.
+ */
+template <typename AddFn>
+HVMatrix<int> bundle_by_class(size_t n_samples, const std::vector<int>& target, int n_class, int n_dim, AddFn add) {
+    ThreadPool& pool = ThreadPool::global();
+    std::vector<HVMatrix<int>> partial(pool.size());
 
+    pool.parallel_for(0, n_samples, 0, [&](size_t begin, size_t end, int tid) {
+        HVMatrix<int>& sums = partial[tid];
+        if (sums.empty()) {
+            sums = HVMatrix<int>(n_class, n_dim, 0);
+        }
+        for (size_t j = begin; j < end; ++j) {
+            if (target[j] >= 0 && target[j] < n_class) {
+                add(j, sums.row(target[j]));
+            }
+        }
+    });
 
-HDC::HDC(int n_class, int n_lv, int n_id, int n_dim, bool binary)
-    : n_class(n_class), n_lv(n_lv), n_id(n_id), n_dim(n_dim), binary(binary) {
-    // Initialize hv_lv and hv_id with random values
-    hv_lv = generate_hvs(n_lv, n_dim);
-    hv_id = generate_hvs(n_id, n_dim);
-    class_hvs = std::vector<std::vector<int>>(n_class, std::vector<int>(n_dim, 0));
+    HVMatrix<int> sums(n_class, n_dim, 0);
+    for (const HVMatrix<int>& part : partial) {
+        for (size_t i = 0; i < part.rows(); ++i) {
+            for (int d = 0; d < n_dim; ++d) {
+                sums(i, d) += part(i, d);
+            }
+        }
+    }
+    return sums;
 }
 
-std::vector<std::vector<int>> HDC::encode(const std::vector<std::vector<int>>& inp) {
-    int n_batch = inp.size();
-    std::vector<std::vector<int>> inp_enc(n_batch, std::vector<int>(n_dim, 0));
-    
-    for (int i = 0; i < n_batch; ++i) {
-        std::vector<int> tmp(n_dim, 0);
-        for (int j = 0; j < n_id; ++j) {
+/**
+ * @brief Accumulates the perceptron corrections of a mini-batch, in parallel.
+ *
+ * Every mispredicted sample is added to its target class and subtracted from its
+ * predicted class in the delta buffer of the pool thread that handles it.
+ *
+ * @param begin First sample of the batch.
+ * @param n Number of samples in the batch.
+ * @param pred Predicted class of each sample of the batch.
+ * @param target Class label of every sample.
+ * @param n_class Number of classes.
+ * @param n_dim Dimension of hypervectors.
+ * @param partial One delta buffer per pool thread, allocated on first use.
+ * @param add Callback that adds sign * sample j onto an n_dim accumulator.
+ */
+template <typename AddFn>
+void accumulate_corrections(size_t begin, size_t n, const int* pred, const std::vector<int>& target, int n_class,
+                            int n_dim, std::vector<HVMatrix<int>>& partial, AddFn add) {
+    ThreadPool& pool = ThreadPool::global();
+    partial.resize(pool.size());
+
+    pool.parallel_for(0, n, 0, [&](size_t chunk_begin, size_t chunk_end, int tid) {
+        HVMatrix<int>& delta = partial[tid];
+        if (delta.empty()) {
+            delta = HVMatrix<int>(n_class, n_dim, 0);
+        }
+        for (size_t k = chunk_begin; k < chunk_end; ++k) {
+            size_t j = begin + k;
+            if (pred[k] != target[j]) {
+                add(j, delta.row(target[j]), 1);
+                add(j, delta.row(pred[k]), -1);
+            }
+        }
+    });
+}
+
+/**
+ * @brief Adds sign * enc onto a shared class hypervector with relaxed atomic adds.
+ */
+void relaxed_add(int* hv, const int* enc, int sign, int n_dim) {
+    for (int d = 0; d < n_dim; ++d) {
+        __atomic_fetch_add(hv + d, sign * enc[d], __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Thread-local snapshot of the class hypervectors, their norms and packed copies
+ *        used by Hogwild retraining.
+ *
+ * Every class carries a shared version counter that is bumped after each update. The
+ * cache only re-reads a class, with relaxed atomic loads, when its version differs from
+ * the one it last saw, so scoring runs on private memory and classes that nobody
+ * updates are never read again. The initial snapshot must be taken before any worker
+ * updates the classes; workers then start from copies of it.
+ */
+struct HogwildCache {
+    std::vector<unsigned> seen; ///< Version of every class at its last refresh.
+    HVMatrix<int> hvs; ///< Class hypervectors as of their last refresh.
+    std::vector<double> norms; ///< L2 norm of every class hypervector.
+    BitHVs bits; ///< Packed binarized class hypervectors.
+    bool binary; ///< Refresh the packed copies instead of the norms.
+
+    HogwildCache(const HVMatrix<int>& class_hvs, const std::vector<int64_t>& norms2, const BitHVs& packed, bool binary)
+        : seen(norms2.size(), 0), hvs(class_hvs), norms(norms2.size()), bits(packed), binary(binary) {
+        for (size_t i = 0; i < norms2.size(); ++i) {
+            norms[i] = std::sqrt(static_cast<double>(norms2[i]));
+        }
+    }
+
+    /**
+     * @brief Re-reads every class that was updated since the last refresh.
+     */
+    void refresh(const std::vector<std::atomic<unsigned>>& versions, const HVMatrix<int>& class_hvs) {
+        int n_dim = bits.dim();
+        for (size_t i = 0; i < versions.size(); ++i) {
+            unsigned version = versions[i].load(std::memory_order_relaxed);
+            if (version == seen[i]) {
+                continue;
+            }
+            seen[i] = version;
+            int* hv = hvs.row(i);
             for (int d = 0; d < n_dim; ++d) {
-                tmp[d] += hv_id[j][d] * hv_lv[inp[i][j]][d];
+                hv[d] = __atomic_load_n(class_hvs.row(i) + d, __ATOMIC_RELAXED);
+            }
+            if (binary) {
+                bits.pack(i, hv);
+            } else {
+                int64_t norm2 = 0;
+                for (int d = 0; d < n_dim; ++d) {
+                    norm2 += static_cast<int64_t>(hv[d]) * hv[d];
+                }
+                norms[i] = std::sqrt(static_cast<double>(norm2));
             }
         }
-        inp_enc[i] = tmp;
     }
+};
 
-    if (binary) {
-        for (auto& vec : inp_enc) {
-            vec = binarize(vec);
+/**
+ * @brief Adds every valid element of src onto dst, which has the same shape.
+ */
+void add_rows(const HVMatrix<int>& src, HVMatrix<int>& dst) {
+    for (size_t i = 0; i < src.rows(); ++i) {
+        const int* from = src.row(i);
+        int* to = dst.row(i);
+        for (size_t d = 0; d < src.cols(); ++d) {
+            to[d] += from[d];
         }
     }
+}
 
-    return inp_enc;
+/**
+ * @brief Returns n level indices as int, widening narrow levels into scratch.
+ */
+template <typename Level>
+const int* widen_levels(const Level* levels, int n, std::vector<int>& scratch) {
+    scratch.assign(levels, levels + n);
+    return scratch.data();
 }
 
-// std::vector<std::vector<int>> HDC::generate_hvs(int n, int dim) {
-//     std::vector<std::vector<int>> hvs(n);
-//     for (int i = 0; i < n; ++i) {
-//         hvs[i] = generate_random_vector(dim, -1, 1);
-//     }
-//     return hvs;
-// }
+const int* widen_levels(const int* levels, int, std::vector<int>&) {
+    return levels;
+}
 
-std::vector<std::vector<int>> HDC::generate_hvs(int n, int dim) {
-    int fixed_value = 2;
-    std::vector<std::vector<int>> hvs(n, std::vector<int>(dim, fixed_value)); // Initialize with fixed value
-    return hvs;
+/**
+ * @brief Writes row `row` of the item memory generated from seed as n_dim +1/-1 values.
+ */
+void item_hv_row(uint64_t seed, size_t row, int n_dim, int8_t* out) {
+    for (int d0 = 0; d0 < n_dim; d0 += BitHVs::BITS_PER_WORD) {
+        uint64_t bits = item_hv_word(seed, row, d0 / BitHVs::BITS_PER_WORD);
+        int n = std::min(BitHVs::BITS_PER_WORD, n_dim - d0);
+        for (int d = 0; d < n; ++d) {
+            out[d0 + d] = (bits >> d) & 1 ? -1 : 1;
+        }
+    }
 }
 
+/**
+ * @brief Fraction of predictions that match their target label.
+ */
+double accuracy(const std::vector<int>& pred, const std::vector<int>& target) {
+    int correct = 0;
+    for (size_t i = 0; i < pred.size(); ++i) {
+        if (pred[i] == target[i]) {
+            correct++;
+        }
+    }
+    return static_cast<double>(correct) / target.size();
+}
+
+} // namespace
+
 
 
-void HDC::train_init(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target) {
-    assert(inp_enc.size() == target.size());
 
+HDC::HDC(int n_class, int n_lv, int n_id, int n_dim, bool binary, const ItemMemoryOptions& items)
+    : HDC(n_class, n_lv, n_id, n_dim, binary, nullptr) {
+    // Identifier and level hypervectors come from two streams of the same seed
+    id_seed = hash_mix(items.seed, 0);
+    uint64_t lv_seed = hash_mix(items.seed, 1);
+    if (items.method == ItemMethod::CYCLIC) {
+        hv_lv = generate_cyclic_levels(n_lv, n_dim, lv_seed);
+        generate_cyclic_ids(id_seed);
+        flush_every = bind_flush_interval(id_bases, hv_lv);
+        return;
+    }
+    procedural_ids = items.procedural_ids;
+    hv_lv = generate_hvs(n_lv, n_dim, lv_seed);
+    if (procedural_ids) {
+        // Generated identifiers are +1/-1, so the level values bound the products
+        flush_every = bind_flush_interval(HVMatrix<int8_t>(1, 1, 1), hv_lv);
+    } else {
+        hv_id = generate_hvs(n_id, n_dim, id_seed);
+        flush_every = bind_flush_interval(hv_id, hv_lv);
+    }
+}
+
+HDC::HDC(int n_class, int n_lv, int n_id, int n_dim, bool binary, std::shared_ptr<const MappedFile> file)
+    : n_class(n_class), n_lv(n_lv), n_id(n_id), n_dim(n_dim), binary(binary), model_file(std::move(file)) {
+    class_hvs = HVMatrix<int>(n_class, n_dim, 0);
+    class_norms2.assign(n_class, 0);
+    bin_class_hvs = BitHVs(n_class, n_dim);
+}
+
+bool HDC::save(const std::string& filename) const {
+    HVView<const int8_t> lv = lv_hvs();
+
+    ModelFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MODEL_FILE_MAGIC, sizeof(header.magic));
+    header.version = MODEL_FILE_VERSION;
+    header.binary = binary;
+    header.n_class = n_class;
+    header.n_lv = n_lv;
+    header.n_id = n_id;
+    header.n_dim = n_dim;
+    header.item_stride = HVMatrix<int8_t>::padded_stride(n_dim);
+    header.class_stride = binary ? bin_class_hvs.view().stride() : class_hvs.stride();
+    uint64_t class_bytes = header.class_stride * (binary ? sizeof(uint64_t) : sizeof(int32_t));
+    header.id_offset = align_to_row(sizeof(header));
+    header.lv_offset = align_to_row(header.id_offset + n_id * header.item_stride);
+    header.class_offset = align_to_row(header.lv_offset + n_lv * header.item_stride);
+    header.file_size = header.class_offset + n_class * class_bytes;
+
+    AlignedFileWriter out;
+    if (!out.open(filename)) {
+        return false;
+    }
+
+    std::vector<char> row(std::max<uint64_t>(header.item_stride, class_bytes), 0);
+    auto write_items = [&](HVView<const int8_t> hvs) {
+        for (size_t i = 0; i < hvs.rows(); ++i) {
+            std::memcpy(row.data(), hvs.row(i), n_dim);
+            out.write(row.data(), header.item_stride);
+        }
+    };
+
+    out.write(&header, sizeof(header));
+    out.pad_to(header.id_offset);
+    for (int i = 0; i < n_id; ++i) {
+        copy_id_row(i, reinterpret_cast<int8_t*>(row.data()));
+        out.write(row.data(), header.item_stride);
+    }
+    out.pad_to(header.lv_offset);
+    write_items(lv);
+    out.pad_to(header.class_offset);
     for (int i = 0; i < n_class; ++i) {
-        std::vector<int> sum(n_dim, 0);
-        for (size_t j = 0; j < target.size(); ++j) {
-            if (target[j] == i) {
-                for (int d = 0; d < n_dim; ++d) {
-                    sum[d] += inp_enc[j][d];
+        const char* src = binary ? reinterpret_cast<const char*>(bin_class_hvs.row(i))
+                                 : reinterpret_cast<const char*>(class_hvs.row(i));
+        out.write(src, class_bytes);
+    }
+    return out.commit();
+}
+
+std::unique_ptr<HDC> HDC::load(const std::string& filename) {
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(filename)) {
+        return nullptr;
+    }
+
+    ModelFileHeader header;
+    if (file->size() < sizeof(header)) {
+        std::cerr << "Invalid model file " << filename << std::endl;
+        return nullptr;
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    uint64_t n_words = (header.n_dim + BitHVs::BITS_PER_WORD - 1) / BitHVs::BITS_PER_WORD;
+    uint64_t class_bytes = header.class_stride * (header.binary ? sizeof(uint64_t) : sizeof(int32_t));
+    if (std::memcmp(header.magic, MODEL_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != MODEL_FILE_VERSION || header.file_size != file->size() || header.n_class == 0 ||
+        header.n_dim == 0 || header.item_stride != HVMatrix<int8_t>::padded_stride(header.n_dim) ||
+        header.class_stride < (header.binary ? n_words : header.n_dim) || header.id_offset % HV_ROW_ALIGN != 0 ||
+        header.lv_offset % HV_ROW_ALIGN != 0 || header.class_offset % HV_ROW_ALIGN != 0 ||
+        header.id_offset + header.n_id * header.item_stride > header.lv_offset ||
+        header.lv_offset + header.n_lv * header.item_stride > header.class_offset ||
+        header.class_offset + header.n_class * class_bytes > header.file_size) {
+        std::cerr << "Invalid model file " << filename << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr<HDC> model(new HDC(header.n_class, header.n_lv, header.n_id, header.n_dim, header.binary, file));
+    const int8_t* items = reinterpret_cast<const int8_t*>(file->data());
+    model->mapped_id = HVView<const int8_t>(items + header.id_offset, header.n_id, header.n_dim, header.item_stride);
+    model->mapped_lv = HVView<const int8_t>(items + header.lv_offset, header.n_lv, header.n_dim, header.item_stride);
+    model->flush_every = bind_flush_interval(model->mapped_id, model->mapped_lv);
+
+    const char* classes = file->data() + header.class_offset;
+    for (int i = 0; i < model->n_class; ++i) {
+        const char* src = classes + i * class_bytes;
+        if (header.binary) {
+            // Packed classes are expanded back to +1/-1, which repacks to the same bits
+            BitHVs row(HVView<const uint64_t>(reinterpret_cast<const uint64_t*>(src), 1, n_words, n_words), header.n_dim);
+            std::fill(model->class_hvs.row(i), model->class_hvs.row(i) + header.n_dim, 0);
+            row.accumulate(0, model->class_hvs.row(i), 1);
+        } else {
+            std::memcpy(model->class_hvs.row(i), src, header.n_dim * sizeof(int32_t));
+        }
+        model->refresh_class_row(i);
+    }
+    return model;
+}
+
+HVMatrix<int> HDC::encode(HVView<const int> inp) {
+    return encode_levels(inp);
+}
+
+HVMatrix<int> HDC::encode(HVView<const uint16_t> inp) {
+    return encode_levels(inp);
+}
+
+HVMatrix<int> HDC::encode(HVView<const uint8_t> inp) {
+    return encode_levels(inp);
+}
+
+BitHVs HDC::encode_binary(HVView<const int> inp) {
+    return encode_levels_binary(inp);
+}
+
+BitHVs HDC::encode_binary(HVView<const uint16_t> inp) {
+    return encode_levels_binary(inp);
+}
+
+BitHVs HDC::encode_binary(HVView<const uint8_t> inp) {
+    return encode_levels_binary(inp);
+}
+
+template <typename Level>
+HVMatrix<int> HDC::encode_levels(HVView<const Level> inp) {
+    int n_batch = inp.rows();
+    HVMatrix<int> inp_enc(n_batch, n_dim, 0);
+    // Packs the item memory signs, if needed, before the workers read them
+    encode_path();
+    
+    ThreadPool::global().parallel_for(0, n_batch, 0, [&](size_t begin, size_t end, int) {
+        EncodeScratch scratch;
+        for (size_t i = begin; i < end; ++i) {
+            encode_sample(widen_levels(inp.row(i), n_id, scratch.levels), inp_enc.row(i), scratch);
+            if (binary) {
+                binarize(inp_enc.row(i), inp_enc.row(i), n_dim);
+            }
+        }
+    });
+
+    return inp_enc;
+}
+
+template <typename Level>
+BitHVs HDC::encode_levels_binary(HVView<const Level> inp) {
+    BitHVs inp_enc(inp.rows(), n_dim);
+    bool xor_path = encode_path() == EncodePath::XOR;
+
+    ThreadPool::global().parallel_for(0, inp.rows(), 0, [&](size_t begin, size_t end, int) {
+        std::vector<int> tmp(n_dim);
+        EncodeScratch scratch;
+        for (size_t i = begin; i < end; ++i) {
+            const int* sample = widen_levels(inp.row(i), n_id, scratch.levels);
+            // XOR binding thresholds its counts straight into the packed row
+            if (xor_path && encode_xor(nullptr, sample, n_id, nullptr, inp_enc.row(i), scratch)) {
+                continue;
+            }
+            encode_sample(sample, tmp.data(), scratch);
+            inp_enc.pack(i, tmp.data());
+        }
+    });
+
+    return inp_enc;
+}
+
+HVMatrix<int> HDC::encode_sparse(const CSRView& inp) {
+    HVMatrix<int> inp_enc(inp.rows(), n_dim, 0);
+    encode_path();
+
+    ThreadPool::global().parallel_for(0, inp.rows(), 0, [&](size_t begin, size_t end, int) {
+        EncodeScratch scratch;
+        for (size_t i = begin; i < end; ++i) {
+            encode_sparse_sample(inp, i, inp_enc.row(i), scratch);
+            if (binary) {
+                binarize(inp_enc.row(i), inp_enc.row(i), n_dim);
+            }
+        }
+    });
+
+    return inp_enc;
+}
+
+BitHVs HDC::encode_sparse_binary(const CSRView& inp) {
+    BitHVs inp_enc(inp.rows(), n_dim);
+    bool xor_path = encode_path() == EncodePath::XOR;
+
+    ThreadPool::global().parallel_for(0, inp.rows(), 0, [&](size_t begin, size_t end, int) {
+        std::vector<int> tmp(n_dim);
+        EncodeScratch scratch;
+        for (size_t i = begin; i < end; ++i) {
+            if (xor_path && encode_xor(inp.ids(i), inp.levels(i), inp.row_nnz(i), nullptr, inp_enc.row(i), scratch)) {
+                continue;
+            }
+            encode_sparse_sample(inp, i, tmp.data(), scratch);
+            inp_enc.pack(i, tmp.data());
+        }
+    });
+
+    return inp_enc;
+}
+
+void HDC::encode_sample(const int* sample, int* out, EncodeScratch& scratch) const {
+    if (active_path == EncodePath::XOR && encode_xor(nullptr, sample, n_id, out, nullptr, scratch)) {
+        return;
+    }
+    if (active_path != EncodePath::FEATURE && encode_grouped(nullptr, sample, n_id, out, scratch)) {
+        return;
+    }
+    HVView<const int8_t> lv = lv_hvs();
+    if (procedural_ids) {
+        bind_bundle_procedural_kernel()(id_seed, lv.data(), lv.stride(), nullptr, sample, n_id, n_dim, flush_every,
+                                        out);
+        return;
+    }
+    if (cyclic_ids) {
+        // Offsets into id_bases with a unit stride address the rotations in place
+        bind_bundle_kernel()(id_bases.data(), 1, lv.data(), lv.stride(), id_offsets.data(), sample, n_id, n_dim,
+                             flush_every, out);
+        return;
+    }
+    HVView<const int8_t> id = id_hvs();
+    bind_bundle_kernel()(id.data(), id.stride(), lv.data(), lv.stride(), nullptr, sample, n_id, n_dim, flush_every,
+                         out);
+}
+
+void HDC::encode_sparse_sample(const CSRView& inp, size_t i, int* out, EncodeScratch& scratch) const {
+    const int* ids = inp.ids(i);
+    const int* levels = inp.levels(i);
+    int nnz = inp.row_nnz(i);
+    for (int j = 0; j < nnz; ++j) {
+        assert(ids[j] >= 0 && ids[j] < n_id);
+        assert(levels[j] >= 0 && levels[j] < n_lv);
+    }
+    if (active_path == EncodePath::XOR && encode_xor(ids, levels, nnz, out, nullptr, scratch)) {
+        return;
+    }
+    if (active_path != EncodePath::FEATURE && encode_grouped(ids, levels, nnz, out, scratch)) {
+        return;
+    }
+    HVView<const int8_t> lv = lv_hvs();
+    if (procedural_ids) {
+        bind_bundle_procedural_kernel()(id_seed, lv.data(), lv.stride(), ids, levels, nnz, n_dim, flush_every, out);
+        return;
+    }
+    if (cyclic_ids) {
+        std::vector<int>& offsets = scratch.offsets;
+        offsets.resize(nnz);
+        for (int j = 0; j < nnz; ++j) {
+            offsets[j] = id_offsets[ids[j]];
+        }
+        bind_bundle_kernel()(id_bases.data(), 1, lv.data(), lv.stride(), offsets.data(), levels, nnz, n_dim,
+                             flush_every, out);
+        return;
+    }
+    HVView<const int8_t> id = id_hvs();
+    bind_bundle_kernel()(id.data(), id.stride(), lv.data(), lv.stride(), ids, levels, nnz, n_dim, flush_every, out);
+}
+
+bool HDC::encode_grouped(const int* ids, const int* levels, int n, int* out, EncodeScratch& scratch) const {
+    // Counting sort of the identifiers by level; placing them advances every start to the next level's
+    std::vector<int>& starts = scratch.starts;
+    std::vector<const uint64_t*>& members = scratch.members;
+    starts.assign(n_lv + 1, 0);
+    for (int j = 0; j < n; ++j) {
+        ++starts[levels[j] + 1];
+    }
+    int n_groups = 0;
+    for (int l = 0; l < n_lv; ++l) {
+        n_groups += starts[l + 1] > 0;
+        starts[l + 1] += starts[l];
+    }
+    if (n < MIN_GROUP_SIZE * n_groups) {
+        return false;
+    }
+    members.resize(n);
+    for (int j = 0; j < n; ++j) {
+        members[starts[levels[j]]++] = id_sign_words(ids ? ids[j] : j);
+    }
+    for (int l = n_lv; l > 0; --l) {
+        starts[l] = starts[l - 1];
+    }
+    starts[0] = 0;
+
+    HVView<const int8_t> lv = lv_hvs();
+    BindGroupFn bind = bind_group_kernel();
+
+    std::fill(out, out + n_dim, 0);
+    for (int l = 0; l < n_lv; ++l) {
+        for (int k = starts[l]; k < starts[l + 1]; k += 255) {
+            bind(members.data() + k, std::min(255, starts[l + 1] - k), lv.row(l), n_dim, out);
+        }
+    }
+    return true;
+}
+
+bool HDC::encode_xor(const int* ids, const int* levels, int n, int* out, uint64_t* bits,
+                     EncodeScratch& scratch) const {
+    if (n > MAX_XOR_FEATURES) {
+        return false;
+    }
+    std::vector<const uint64_t*>& members = scratch.members;
+    std::vector<const uint64_t*>& level_signs = scratch.level_signs;
+    members.resize(n);
+    level_signs.resize(n);
+    for (int j = 0; j < n; ++j) {
+        members[j] = id_sign_words(ids ? ids[j] : j);
+        level_signs[j] = lv_signs.row(levels[j]);
+    }
+    bind_xor_kernel()(members.data(), level_signs.data(), n, n_dim, out, bits);
+    return true;
+}
+
+const uint64_t* HDC::id_sign_words(int j) const {
+    if (cyclic_ids) {
+        // As in id_offsets, rotation j % n_dim starts n_dim - j % n_dim bits into the doubled base
+        int start = n_dim - j % n_dim;
+        return id_signs.row((j / n_dim) * BitHVs::BITS_PER_WORD + start % BitHVs::BITS_PER_WORD) +
+               start / BitHVs::BITS_PER_WORD;
+    }
+    return id_signs.row(j);
+}
+
+EncodePath HDC::encode_path() {
+    if (!signs_packed) {
+        pack_signs();
+        signs_packed = true;
+    }
+    active_path = requested_path;
+    if (active_path == EncodePath::XOR && !bipolar_lvs) {
+        active_path = EncodePath::GROUPED;
+    }
+    if (active_path != EncodePath::FEATURE && !bipolar_ids) {
+        active_path = EncodePath::FEATURE;
+    }
+    return active_path;
+}
+
+void HDC::pack_signs() {
+    int n_words = (n_dim + BitHVs::BITS_PER_WORD - 1) / BitHVs::BITS_PER_WORD;
+    // Sign bits of the levels, which are few, unless some value is not +1/-1
+    HVView<const int8_t> lv = lv_hvs();
+    bipolar_lvs = true;
+    lv_signs = HVMatrix<uint64_t>(n_lv, n_words, 0);
+    for (int l = 0; l < n_lv && bipolar_lvs; ++l) {
+        const int8_t* row = lv.row(l);
+        uint64_t* signs = lv_signs.row(l);
+        for (int d = 0; d < n_dim && bipolar_lvs; ++d) {
+            bipolar_lvs = row[d] == 1 || row[d] == -1;
+            signs[d / BitHVs::BITS_PER_WORD] |= static_cast<uint64_t>(row[d] < 0) << (d % BitHVs::BITS_PER_WORD);
+        }
+    }
+    if (!bipolar_lvs) {
+        lv_signs = HVMatrix<uint64_t>();
+    }
+
+    if (procedural_ids) {
+        bipolar_ids = false;
+        return;
+    }
+    if (cyclic_ids) {
+        // Row 64 * b + s holds the doubled base b shifted down by s bits, so every rotation is a word offset
+        id_signs = HVMatrix<uint64_t>(id_bases.rows() * BitHVs::BITS_PER_WORD, 2 * n_words + 8, 0);
+        std::vector<uint64_t> doubled(2 * n_words + 9);
+        for (size_t b = 0; b < id_bases.rows(); ++b) {
+            std::fill(doubled.begin(), doubled.end(), 0);
+            for (size_t k = 0; k < id_bases.cols(); ++k) {
+                doubled[k / BitHVs::BITS_PER_WORD] |= static_cast<uint64_t>(id_bases(b, k) < 0)
+                                                      << (k % BitHVs::BITS_PER_WORD);
+            }
+            for (int shift = 0; shift < BitHVs::BITS_PER_WORD; ++shift) {
+                uint64_t* row = id_signs.row(b * BitHVs::BITS_PER_WORD + shift);
+                for (size_t w = 0; w < id_signs.cols(); ++w) {
+                    row[w] = shift == 0 ? doubled[w]
+                                        : (doubled[w] >> shift) | (doubled[w + 1] << (BitHVs::BITS_PER_WORD - shift));
                 }
             }
         }
-        class_hvs[i] = binary ? binarize(sum) : sum;
+        bipolar_ids = true;
+        return;
+    }
+
+    // Sign bits of the stored rows, unless some value is not +1/-1
+    HVView<const int8_t> id = id_hvs();
+    std::atomic<bool> bipolar{true};
+    id_signs = HVMatrix<uint64_t>(n_id, n_words, 0);
+    ThreadPool::global().parallel_for(0, n_id, 0, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            const int8_t* row = id.row(i);
+            uint64_t* signs = id_signs.row(i);
+            for (int d = 0; d < n_dim; ++d) {
+                if (row[d] != 1 && row[d] != -1) {
+                    bipolar = false;
+                    return;
+                }
+                signs[d / BitHVs::BITS_PER_WORD] |= static_cast<uint64_t>(row[d] < 0) << (d % BitHVs::BITS_PER_WORD);
+            }
+        }
+    });
+    bipolar_ids = bipolar;
+    if (!bipolar) {
+        id_signs = HVMatrix<uint64_t>();
     }
 }
 
-// Implementation of the getter function
-const std::vector<std::vector<int>>& HDC::get_class_hvs() const {
-    return class_hvs;
+bool parse_item_method(const std::string& name, ItemMethod& method) {
+    if (name == "random") {
+        method = ItemMethod::RANDOM;
+    } else if (name == "cyclic") {
+        method = ItemMethod::CYCLIC;
+    } else {
+        return false;
+    }
+    return true;
 }
 
+bool open_hdc_parameters(const std::string& dataset_name, int& n_dim, bool& binary, int& train_epochs, int& n_lv,
+                         int& n_class, ItemMethod& method) {
+    std::string filename = "./dataset/" + dataset_name + "/hdc_parameters";
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file " << filename << std::endl;
+        return true;
+    }
+
+    std::string line;
+    std::getline(file, line);
+    n_dim = std::stoi(line);
+    std::getline(file, line);
+    binary = std::stoi(line);
+    std::getline(file, line);
+    train_epochs = std::stoi(line);
+    std::getline(file, line);
+    n_lv = std::stoi(line);
+    std::getline(file, line);
+    n_class = std::stoi(line);
+
+    method = ItemMethod::RANDOM;
+    if (std::getline(file, line) && !line.empty() && !parse_item_method(line, method)) {
+        std::cerr << "Unknown item memory method " << line << " in " << filename << std::endl;
+        return true;
+    }
+    return false;
+}
 
+HVMatrix<int8_t> HDC::generate_hvs(int n, int dim, uint64_t seed) {
+    HVMatrix<int8_t> hvs(n, dim);
+    ThreadPool::global().parallel_for(0, n, 0, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            item_hv_row(seed, i, dim, hvs.row(i));
+        }
+    });
+    return hvs;
+}
 
-double HDC::test(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target) {
+
+
+void HDC::train_init(HVView<const int> inp_enc, const std::vector<int>& target) {
+    HVMatrix<int> sums(n_class, n_dim, 0);
+    accumulate_class_sums(inp_enc, target, sums);
+    set_class_hvs(sums);
+}
+
+void HDC::train_init(const BitHVs& inp_enc, const std::vector<int>& target) {
+    HVMatrix<int> sums(n_class, n_dim, 0);
+    accumulate_class_sums(inp_enc, target, sums);
+    set_class_hvs(sums);
+}
+
+void HDC::accumulate_class_sums(HVView<const int> inp_enc, const std::vector<int>& target, HVMatrix<int>& sums) const {
+    assert(inp_enc.size() == target.size());
+
+    HVMatrix<int> part = bundle_by_class(target.size(), target, n_class, n_dim, [&](size_t j, int* acc) {
+        const int* enc = inp_enc.row(j);
+        for (int d = 0; d < n_dim; ++d) {
+            acc[d] += enc[d];
+        }
+    });
+    add_rows(part, sums);
+}
+
+void HDC::accumulate_class_sums(const BitHVs& inp_enc, const std::vector<int>& target, HVMatrix<int>& sums) const {
     assert(inp_enc.size() == target.size());
 
-    std::vector<std::vector<double>> dist(inp_enc.size(), std::vector<double>(n_class, 0.0));
+    HVMatrix<int> part = bundle_by_class(target.size(), target, n_class, n_dim, [&](size_t j, int* acc) {
+        inp_enc.accumulate(j, acc, 1);
+    });
+    add_rows(part, sums);
+}
+
+void HDC::set_class_hvs(HVView<const int> sums) {
+    assert(static_cast<int>(sums.rows()) == n_class);
+
+    for (int i = 0; i < n_class; ++i) {
+        if (binary) {
+            binarize(sums.row(i), class_hvs.row(i), n_dim);
+        } else {
+            std::copy(sums.row(i), sums.row(i) + n_dim, class_hvs.row(i));
+        }
+        refresh_class_row(i);
+    }
+}
+
+void HDC::refresh_class_row(int i) {
+    const int* hv = class_hvs.row(i);
+    int64_t norm2 = 0;
+    for (int d = 0; d < n_dim; ++d) {
+        norm2 += static_cast<int64_t>(hv[d]) * hv[d];
+    }
+    class_norms2[i] = norm2;
+    bin_class_hvs.pack(i, hv);
+}
 
-    // Distance matching
-    for (size_t i = 0; i < inp_enc.size(); ++i) {
-        for (int j = 0; j < n_class; ++j) {
-            double dot_product = 0.0;
+ClassMatrix HDC::prepare_class_matrix() const {
+    ClassMatrix prepared;
+    prepared.hvs = HVMatrix<double>(n_class, n_dim, 0.0);
+    prepared.norms.assign(n_class, 1.0);
+    for (int i = 0; i < n_class; ++i) {
+        double* dst = prepared.hvs.row(i);
+        const int* src = class_hvs.row(i);
+        if (binary) {
             for (int d = 0; d < n_dim; ++d) {
-                if (binary) {
-                    dot_product += inp_enc[i][d] * binarize(class_hvs[j])[d];
-                } else {
-                    dot_product += inp_enc[i][d] * class_hvs[j][d];
-                }
+                dst[d] = src[d] > 0 ? 1.0 : -1.0;
+            }
+        } else {
+            std::copy(src, src + n_dim, dst);
+            prepared.norms[i] = std::sqrt(static_cast<double>(class_norms2[i]));
+        }
+    }
+    return prepared;
+}
+
+HVMatrix<int8_t> HDC::generate_cyclic_levels(int n, int dim, uint64_t seed) {
+    std::vector<int8_t> base(dim);
+    for (int d = 0; d < dim; ++d) {
+        base[d] = d < dim / 2 ? -1 : 1;
+    }
+    // Fisher-Yates shuffle, as np.random.permutation
+    for (int d = dim - 1; d > 0; --d) {
+        std::swap(base[d], base[item_hv_word(seed, 0, d) % (d + 1)]);
+    }
+
+    HVMatrix<int8_t> hvs(n, dim);
+    for (int i = 0; i < n; ++i) {
+        int flip = n > 1 ? static_cast<int>(static_cast<double>(i) / (n - 1) * dim) / 2 : 0;
+        for (int d = 0; d < dim; ++d) {
+            hvs(i, d) = d < flip ? -base[d] : base[d];
+        }
+    }
+    return hvs;
+}
+
+void HDC::generate_cyclic_ids(uint64_t seed) {
+    cyclic_ids = true;
+    int n_bases = (n_id + n_dim - 1) / n_dim;
+    // Kernels read whole blocks of 64 dimensions, up to 63 elements past the second copy
+    id_bases = HVMatrix<int8_t>(n_bases, 2 * static_cast<size_t>(n_dim) + 64);
+    for (int b = 0; b < n_bases; ++b) {
+        int8_t* row = id_bases.row(b);
+        item_hv_row(seed, b, n_dim, row);
+        for (size_t k = n_dim; k < id_bases.cols(); ++k) {
+            row[k] = row[k % n_dim];
+        }
+    }
+    id_offsets.resize(n_id);
+    for (int j = 0; j < n_id; ++j) {
+        id_offsets[j] = static_cast<int>((j / n_dim) * id_bases.stride() + n_dim - j % n_dim);
+    }
+}
+
+void HDC::copy_id_row(int i, int8_t* out) const {
+    if (procedural_ids) {
+        item_hv_row(id_seed, i, n_dim, out);
+    } else if (cyclic_ids) {
+        std::memcpy(out, id_bases.data() + id_offsets[i], n_dim);
+    } else {
+        std::memcpy(out, id_hvs().row(i), n_dim);
+    }
+}
+
+uint64_t HDC::item_memory_hash() const {
+    uint64_t hash = hash_mix(0, n_dim);
+    if (procedural_ids || cyclic_ids) {
+        // Generated identifiers are keyed by their method and seed
+        hash = hash_mix(hash_mix(hash_mix(hash, cyclic_ids ? UINT64_MAX - 1 : UINT64_MAX), id_seed), n_id);
+    }
+    for (HVView<const int8_t> hvs : {id_hvs(), lv_hvs()}) {
+        hash = hash_mix(hash, hvs.rows());
+        for (size_t i = 0; i < hvs.rows(); ++i) {
+            const int8_t* hv = hvs.row(i);
+            for (int d = 0; d < n_dim; ++d) {
+                hash = hash_mix(hash, static_cast<uint64_t>(static_cast<int64_t>(hv[d])));
             }
-            if (!binary) {
-                double norm = 0.0;
+        }
+    }
+    return hash;
+}
+
+// Implementation of the getter function
+const HVMatrix<int>& HDC::get_class_hvs() const {
+    return class_hvs;
+}
+
+
+
+std::vector<int> HDC::predict(HVView<const int> inp_enc, HVMatrix<double>& scores) const {
+    ClassMatrix classes = prepare_class_matrix();
+    std::vector<int> pred(inp_enc.size());
+    scores = HVMatrix<double>(inp_enc.size(), n_class);
+
+    // Dot products of integers are exact in double, so these scores rank like argmax_classes()
+    ThreadPool::global().parallel_for(0, inp_enc.size(), 0, [&](size_t begin, size_t end, int) {
+        for (size_t j = begin; j < end; ++j) {
+            const int* enc = inp_enc.row(j);
+            double* out = scores.row(j);
+            for (int i = 0; i < n_class; ++i) {
+                const double* hv = classes.hvs.row(i);
+                double dot_product = 0.0;
                 for (int d = 0; d < n_dim; ++d) {
-                    norm += class_hvs[j][d] * class_hvs[j][d];
+                    dot_product += enc[d] * hv[d];
                 }
-                norm = std::sqrt(norm);
-                dist[i][j] = dot_product / norm;
-            } else {
-                dist[i][j] = dot_product;
+                out[i] = dot_product / classes.norms[i];
             }
+            pred[j] = std::max_element(out, out + n_class) - out;
         }
-    }
+    });
+    return pred;
+}
 
-    int correct = 0;
-    for (size_t i = 0; i < dist.size(); ++i) {
-        int predicted = std::distance(dist[i].begin(), std::max_element(dist[i].begin(), dist[i].end()));
-        if (predicted == target[i]) {
-            correct++;
+std::vector<int> HDC::predict(const BitHVs& inp_enc, HVMatrix<double>& scores) const {
+    std::vector<int> pred(inp_enc.size());
+    scores = HVMatrix<double>(inp_enc.size(), n_class);
+
+    ThreadPool::global().parallel_for(0, inp_enc.size(), 0, [&](size_t begin, size_t end, int) {
+        for (size_t j = begin; j < end; ++j) {
+            double* out = scores.row(j);
+            for (int i = 0; i < n_class; ++i) {
+                out[i] = bit_dot(inp_enc.row(j), bin_class_hvs.row(i), bin_class_hvs.words(), n_dim);
+            }
+            pred[j] = std::max_element(out, out + n_class) - out;
         }
-    }
-    return static_cast<double>(correct) / target.size();
+    });
+    return pred;
 }
 
+double HDC::test(HVView<const int> inp_enc, const std::vector<int>& target) {
+    assert(inp_enc.size() == target.size());
 
+    std::vector<int> pred(inp_enc.size());
+    argmax_classes(inp_enc, prepare_class_matrix(), pred.data());
+    return accuracy(pred, target);
+}
+
+double HDC::test(const BitHVs& inp_enc, const std::vector<int>& target) {
+    assert(inp_enc.size() == target.size());
+
+    std::vector<int> pred(inp_enc.size());
+    argmax_classes(inp_enc, bin_class_hvs, pred.data());
+    return accuracy(pred, target);
+}
 
-void HDC::train(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target) {
+
+
+void HDC::train(HVView<const int> inp_enc, const std::vector<int>& target) {
     assert(inp_enc.size() == target.size());
 
     size_t n_samples = inp_enc.size();
 
+    // Class norms only change on a misprediction, so they are kept across samples
+    std::vector<double> norms(n_class);
+    for (int i = 0; i < n_class; ++i) {
+        norms[i] = std::sqrt(static_cast<double>(class_norms2[i]));
+    }
+    BitHVs sample(1, n_dim);
+    int n_words = sample.words();
+
     for (size_t j = 0; j < n_samples; ++j) {
+        const int* enc = inp_enc.row(j);
         int pred = 0;
         if (binary) {
-            std::vector<int> bin_class_hvs_flat;
-            for (const auto& hv : class_hvs) {
-                std::vector<int> bin_hv = binarize(hv);
-                bin_class_hvs_flat.insert(bin_class_hvs_flat.end(), bin_hv.begin(), bin_hv.end());
-            }
-            std::vector<int> inp_enc_binarized = binarize(inp_enc[j]);
-            std::vector<int> dist(n_class, 0);
-            for (int i = 0; i < n_class; ++i) {
-                int dot_product = 0;
-                for (int d = 0; d < n_dim; ++d) {
-                    dot_product += inp_enc_binarized[d] * bin_class_hvs_flat[i * n_dim + d];
+            sample.pack(0, enc);
+            int best = bit_dot(sample.row(0), bin_class_hvs.row(0), n_words, n_dim);
+            for (int i = 1; i < n_class; ++i) {
+                int dot_product = bit_dot(sample.row(0), bin_class_hvs.row(i), n_words, n_dim);
+                if (dot_product > best) {
+                    best = dot_product;
+                    pred = i;
                 }
-                dist[i] = dot_product;
             }
-            pred = std::distance(dist.begin(), std::max_element(dist.begin(), dist.end()));
         } else {
-            std::vector<double> dist(n_class, 0.0);
+            double best = 0.0;
             for (int i = 0; i < n_class; ++i) {
-                double dot_product = 0.0;
+                const int* hv = class_hvs.row(i);
+                int64_t dot_product = 0;
                 for (int d = 0; d < n_dim; ++d) {
-                    dot_product += inp_enc[j][d] * class_hvs[i][d];
+                    dot_product += static_cast<int64_t>(enc[d]) * hv[d];
                 }
-                double norm = 0.0;
-                for (int d = 0; d < n_dim; ++d) {
-                    norm += class_hvs[i][d] * class_hvs[i][d];
+                double dist = dot_product / norms[i];
+                if (i == 0 || best < dist) {
+                    best = dist;
+                    pred = i;
                 }
-                norm = std::sqrt(norm);
-                dist[i] = dot_product / norm;
             }
-            pred = std::distance(dist.begin(), std::max_element(dist.begin(), dist.end()));
         }
 
         if (pred != target[j]) {
             for (int d = 0; d < n_dim; ++d) {
-                class_hvs[target[j]][d] += inp_enc[j][d];
-                class_hvs[pred][d] -= inp_enc[j][d];
+                class_hvs[target[j]][d] += enc[d];
+                class_hvs[pred][d] -= enc[d];
+            }
+            refresh_class_row(target[j]);
+            refresh_class_row(pred);
+            norms[target[j]] = std::sqrt(static_cast<double>(class_norms2[target[j]]));
+            norms[pred] = std::sqrt(static_cast<double>(class_norms2[pred]));
+        }
+    }
+}
+
+void HDC::train(const BitHVs& inp_enc, const std::vector<int>& target) {
+    assert(inp_enc.size() == target.size());
+
+    int n_words = inp_enc.words();
+
+    for (size_t j = 0; j < inp_enc.size(); ++j) {
+        int pred = 0;
+        int best = bit_dot(inp_enc.row(j), bin_class_hvs.row(0), n_words, n_dim);
+        for (int i = 1; i < n_class; ++i) {
+            int dot_product = bit_dot(inp_enc.row(j), bin_class_hvs.row(i), n_words, n_dim);
+            if (dot_product > best) {
+                best = dot_product;
+                pred = i;
+            }
+        }
+
+        if (pred != target[j]) {
+            inp_enc.accumulate(j, class_hvs.row(target[j]), 1);
+            inp_enc.accumulate(j, class_hvs.row(pred), -1);
+            refresh_class_row(target[j]);
+            refresh_class_row(pred);
+        }
+    }
+}
+
+double HDC::train_batched(HVView<const int> inp_enc, const std::vector<int>& target, int batch_size) {
+    assert(inp_enc.size() == target.size());
+
+    size_t n_samples = inp_enc.size();
+    size_t batch = std::max(1, batch_size);
+    std::vector<int> pred(std::min(batch, n_samples));
+    std::vector<HVMatrix<int>> partial;
+    int correct = 0;
+
+    for (size_t begin = 0; begin < n_samples; begin += batch) {
+        size_t n = std::min(batch, n_samples - begin);
+        argmax_classes(inp_enc.slice(begin, n), prepare_class_matrix(), pred.data());
+        accumulate_corrections(begin, n, pred.data(), target, n_class, n_dim, partial, [&](size_t j, int* acc, int sign) {
+            const int* enc = inp_enc.row(j);
+            for (int d = 0; d < n_dim; ++d) {
+                acc[d] += sign * enc[d];
+            }
+        });
+        correct += apply_corrections(begin, n, pred.data(), target, partial);
+    }
+    return static_cast<double>(correct) / n_samples;
+}
+
+double HDC::train_batched(const BitHVs& inp_enc, const std::vector<int>& target, int batch_size) {
+    assert(inp_enc.size() == target.size());
+
+    size_t n_samples = inp_enc.size();
+    size_t batch = std::max(1, batch_size);
+    std::vector<int> pred(std::min(batch, n_samples));
+    std::vector<HVMatrix<int>> partial;
+    int correct = 0;
+
+    for (size_t begin = 0; begin < n_samples; begin += batch) {
+        size_t n = std::min(batch, n_samples - begin);
+        argmax_classes(inp_enc.view().slice(begin, n), bin_class_hvs, pred.data());
+        accumulate_corrections(begin, n, pred.data(), target, n_class, n_dim, partial, [&](size_t j, int* acc, int sign) {
+            inp_enc.accumulate(j, acc, sign);
+        });
+        correct += apply_corrections(begin, n, pred.data(), target, partial);
+    }
+    return static_cast<double>(correct) / n_samples;
+}
+
+double HDC::train_hogwild(HVView<const int> inp_enc, const std::vector<int>& target) {
+    assert(inp_enc.size() == target.size());
+
+    ThreadPool& pool = ThreadPool::global();
+    size_t n_samples = inp_enc.size();
+    size_t shard = (n_samples + pool.size() - 1) / pool.size();
+    std::vector<std::atomic<unsigned>> versions(n_class);
+    std::atomic<int> correct(0);
+
+    // Taken before any shard updates class_hvs; the shards copy it, never the shared rows
+    const HogwildCache snapshot(class_hvs, class_norms2, bin_class_hvs, binary);
+    pool.parallel_for(0, n_samples, shard, [&](size_t begin, size_t end, int) {
+        HogwildCache cache = snapshot;
+        BitHVs sample(1, n_dim);
+        int n_words = sample.words();
+        int shard_correct = 0;
+
+        for (size_t j = begin; j < end; ++j) {
+            cache.refresh(versions, class_hvs);
+            const int* enc = inp_enc.row(j);
+            int pred = 0;
+            if (binary) {
+                sample.pack(0, enc);
+                int best = bit_dot(sample.row(0), cache.bits.row(0), n_words, n_dim);
+                for (int i = 1; i < n_class; ++i) {
+                    int dot_product = bit_dot(sample.row(0), cache.bits.row(i), n_words, n_dim);
+                    if (dot_product > best) {
+                        best = dot_product;
+                        pred = i;
+                    }
+                }
+            } else {
+                double best = 0.0;
+                for (int i = 0; i < n_class; ++i) {
+                    const int* hv = cache.hvs.row(i);
+                    int64_t dot_product = 0;
+                    for (int d = 0; d < n_dim; ++d) {
+                        dot_product += static_cast<int64_t>(enc[d]) * hv[d];
+                    }
+                    double dist = dot_product / cache.norms[i];
+                    if (i == 0 || best < dist) {
+                        best = dist;
+                        pred = i;
+                    }
+                }
+            }
+
+            if (pred != target[j]) {
+                relaxed_add(class_hvs.row(target[j]), enc, 1, n_dim);
+                relaxed_add(class_hvs.row(pred), enc, -1, n_dim);
+                versions[target[j]].fetch_add(1, std::memory_order_relaxed);
+                versions[pred].fetch_add(1, std::memory_order_relaxed);
+            } else {
+                shard_correct++;
+            }
+        }
+        correct += shard_correct;
+    });
+
+    for (int i = 0; i < n_class; ++i) {
+        refresh_class_row(i);
+    }
+    return static_cast<double>(correct.load()) / n_samples;
+}
+
+double HDC::train_hogwild(const BitHVs& inp_enc, const std::vector<int>& target) {
+    assert(inp_enc.size() == target.size());
+
+    ThreadPool& pool = ThreadPool::global();
+    size_t n_samples = inp_enc.size();
+    size_t shard = (n_samples + pool.size() - 1) / pool.size();
+    int n_words = inp_enc.words();
+    std::vector<std::atomic<unsigned>> versions(n_class);
+    std::atomic<int> correct(0);
+
+    const HogwildCache snapshot(class_hvs, class_norms2, bin_class_hvs, true);
+    pool.parallel_for(0, n_samples, shard, [&](size_t begin, size_t end, int) {
+        HogwildCache cache = snapshot;
+        std::vector<int> enc(n_dim);
+        int shard_correct = 0;
+
+        for (size_t j = begin; j < end; ++j) {
+            cache.refresh(versions, class_hvs);
+            int pred = 0;
+            int best = bit_dot(inp_enc.row(j), cache.bits.row(0), n_words, n_dim);
+            for (int i = 1; i < n_class; ++i) {
+                int dot_product = bit_dot(inp_enc.row(j), cache.bits.row(i), n_words, n_dim);
+                if (dot_product > best) {
+                    best = dot_product;
+                    pred = i;
+                }
+            }
+
+            if (pred != target[j]) {
+                std::fill(enc.begin(), enc.end(), 0);
+                inp_enc.accumulate(j, enc.data(), 1);
+                relaxed_add(class_hvs.row(target[j]), enc.data(), 1, n_dim);
+                relaxed_add(class_hvs.row(pred), enc.data(), -1, n_dim);
+                versions[target[j]].fetch_add(1, std::memory_order_relaxed);
+                versions[pred].fetch_add(1, std::memory_order_relaxed);
+            } else {
+                shard_correct++;
+            }
+        }
+        correct += shard_correct;
+    });
+
+    for (int i = 0; i < n_class; ++i) {
+        refresh_class_row(i);
+    }
+    return static_cast<double>(correct.load()) / n_samples;
+}
+
+int HDC::apply_corrections(size_t begin, size_t n, const int* pred, const std::vector<int>& target,
+                           std::vector<HVMatrix<int>>& partial) {
+    int correct = 0;
+    std::vector<char> touched(n_class, 0);
+    for (size_t k = 0; k < n; ++k) {
+        if (pred[k] == target[begin + k]) {
+            correct++;
+        } else {
+            touched[target[begin + k]] = 1;
+            touched[pred[k]] = 1;
+        }
+    }
+
+    for (int i = 0; i < n_class; ++i) {
+        if (!touched[i]) {
+            continue;
+        }
+        int* hv = class_hvs.row(i);
+        for (HVMatrix<int>& delta : partial) {
+            if (delta.empty()) {
+                continue;
+            }
+            int* row = delta.row(i);
+            for (int d = 0; d < n_dim; ++d) {
+                hv[d] += row[d];
             }
+            std::fill(row, row + n_dim, 0);
         }
+        refresh_class_row(i);
     }
+    return correct;
 }
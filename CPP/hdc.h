@@ -1,8 +1,92 @@
 #ifndef HDC_H
 #define HDC_H
 
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "bithv.h"
+#include "csr.h"
+#include "hv_matrix.h"
+#include "mapped_file.h"
+#include "similarity.h"
+
+/**
+ * @brief Header of a saved model file.
+ *
+ * The header is followed by the identifier and level item memories (int8 rows of
+ * item_stride elements) and the class hypervectors at the given byte offsets, each
+ * aligned to HV_ROW_ALIGN so the item memories can be used in place from a mapping.
+ * Class rows are class_stride int32 values, or class_stride packed uint64 words (see
+ * BitHVs) for binary models.
+ */
+struct ModelFileHeader {
+    char magic[8]; ///< MODEL_FILE_MAGIC.
+    uint32_t version; ///< MODEL_FILE_VERSION.
+    uint32_t binary; ///< 1 for binary models, 0 otherwise.
+    uint32_t n_class; ///< Number of classes.
+    uint32_t n_lv; ///< Number of level hypervectors.
+    uint32_t n_id; ///< Number of identifier hypervectors.
+    uint32_t n_dim; ///< Dimension of hypervectors.
+    uint64_t item_stride; ///< Elements between consecutive item memory rows.
+    uint64_t class_stride; ///< Words between consecutive class rows.
+    uint64_t id_offset; ///< Byte offset of the identifier hypervectors.
+    uint64_t lv_offset; ///< Byte offset of the level hypervectors.
+    uint64_t class_offset; ///< Byte offset of the class hypervectors.
+    uint64_t file_size; ///< Total size of the file in bytes.
+};
+
+static const char MODEL_FILE_MAGIC[8] = {'H', 'D', 'C', 'M', 'O', 'D', 'E', 'L'};
+static const uint32_t MODEL_FILE_VERSION = 1;
+
+/**
+ * @brief Structure of the item memories, as method_id_lv in Python/model.py::generate_lv_id_hvs.
+ */
+enum class ItemMethod {
+    RANDOM, ///< Independent random identifier and level hypervectors.
+    CYCLIC, ///< Correlated levels of one base and flip thresholds, identifiers rotated from one base.
+};
+
+/**
+ * @brief Parses "random" or "cyclic".
+ *
+ * @return false if the name is not recognized.
+ */
+bool parse_item_method(const std::string& name, ItemMethod& method);
+
+/**
+ * @brief Read the HDC parameters of ./dataset/<dataset_name>/hdc_parameters.
+ *
+ * The file holds n_dim, binary, train_epochs, n_lv and n_class, one per line. An optional
+ * sixth line names the item memory method (see parse_item_method()); files without it use
+ * random item memories.
+ *
+ * @return false if the parameters were read successfully, true otherwise.
+ */
+bool open_hdc_parameters(const std::string& dataset_name, int& n_dim, bool& binary, int& train_epochs, int& n_lv,
+                         int& n_class, ItemMethod& method);
+
+/**
+ * @brief How the encoders bind and bundle the features of a sample; all paths give identical encodings.
+ */
+enum class EncodePath {
+    FEATURE, ///< Binds every feature with bind_bundle_kernel(); works with any item memories.
+    GROUPED, ///< Binds each level group once with bind_group_kernel(); needs stored or cyclic +1/-1 identifiers.
+    XOR, ///< Binds sign bits with bind_xor_kernel(); also needs +1/-1 levels.
+};
+
+/**
+ * @brief How the item memories of a new model are generated.
+ *
+ * Item hypervectors are +1/-1 and come from the counter-based item_hv_word(), so a seed
+ * reproduces them exactly on any machine and thread count.
+ */
+struct ItemMemoryOptions {
+    uint64_t seed = 0; ///< Seed of the identifier and level hypervectors.
+    bool procedural_ids = false; ///< Generate random identifier hypervectors while encoding instead of storing them.
+    ItemMethod method = ItemMethod::RANDOM; ///< Structure of the item memories; CYCLIC ignores procedural_ids.
+};
 
 /**
  * @class HDC
@@ -18,43 +102,234 @@ public:
      * @param n_id Number of identifier hypervectors.
      * @param n_dim Dimension of hypervectors.
      * @param binary Whether to use binary hypervectors.
+     * @param items Seed and storage of the item memories.
+     */
+    HDC(int n_class, int n_lv, int n_id, int n_dim, bool binary, const ItemMemoryOptions& items = ItemMemoryOptions());
+
+    /**
+     * @brief Saves the parameters, item memories and class hypervectors to a model file.
+     *
+     * Binary models store their class hypervectors bit-packed, and procedural identifier
+     * hypervectors are written out like stored ones. The file is written under a temporary
+     * name and renamed, so processes mapping the previous file are unaffected.
+     *
+     * @param filename The name of the file to write.
+     * @return True if the file was written successfully, false otherwise.
+     */
+    bool save(const std::string& filename) const;
+
+    /**
+     * @brief Loads a model saved by save().
+     *
+     * The file is mapped read-only and the item memories are used in place, so loading
+     * costs O(n_class * n_dim) regardless of their size and processes loading the same
+     * file share its pages. Only the class hypervectors are copied, since training
+     * updates them.
+     *
+     * @param filename The name of the file to load.
+     * @return The model, or nullptr if the file could not be mapped or is invalid.
+     */
+    static std::unique_ptr<HDC> load(const std::string& filename);
+
+    int get_n_class() const { return n_class; } ///< Number of classes.
+    int get_n_lv() const { return n_lv; } ///< Number of level hypervectors.
+    int get_n_id() const { return n_id; } ///< Number of identifier hypervectors.
+    int get_n_dim() const { return n_dim; } ///< Dimension of hypervectors.
+    bool is_binary() const { return binary; } ///< Whether the model uses binary hypervectors.
+    bool has_procedural_ids() const { return procedural_ids; } ///< Whether identifier hypervectors are generated.
+
+    /**
+     * @brief Selects how the encoders bind and bundle features (XOR by default).
+     *
+     * FEATURE multiplies and adds every feature in int16 lanes. GROUPED groups the features
+     * of a sample by level, counts the -1 dimensions of each group's identifiers with
+     * bit-sliced counters and binds every group sum with its level hypervector once, so a
+     * sample costs n_id word-wide additions per 64 dimensions plus at most n_lv multiplies
+     * per dimension. XOR keeps +1/-1 identifiers and levels as sign bits, binds them with XOR
+     * and counts the bound bits with carry-save adders, and the binary encoders threshold
+     * those counts straight into packed bits.
+     *
+     * A path the item memories do not support falls back to the next simpler one:
+     * procedural identifiers, whose bits the per-feature kernels generate as they bind them,
+     * and loaded identifiers with other values always bind feature by feature, and levels
+     * with other values never use XOR. Samples whose level groups are too small to pay off,
+     * or with more than MAX_XOR_FEATURES features, fall back one sample at a time.
      */
-    HDC(int n_class, int n_lv, int n_id, int n_dim, bool binary);
+    void set_encode_path(EncodePath path) { requested_path = path; }
+
+    /**
+     * @brief Returns the path the encoders take after fallbacks (see set_encode_path()).
+     *
+     * Checks the item memories on first use, which reads a loaded model's whole identifier
+     * memory once.
+     */
+    EncodePath encode_path();
 
     /**
      * @brief Encodes the input data into hyperdimensional vectors.
      * 
+     * @param inp Input data to be encoded, one row of level indices per sample.
+     * @return Encoded hyperdimensional vectors, one row per sample.
+     */
+    HVMatrix<int> encode(HVView<const int> inp);
+
+    /**
+     * @brief Encodes samples whose level indices are stored as uint16, e.g. in a mapped dataset file.
+     */
+    HVMatrix<int> encode(HVView<const uint16_t> inp);
+
+    /**
+     * @brief Encodes samples whose level indices are stored as uint8, e.g. in a mapped dataset file.
+     */
+    HVMatrix<int> encode(HVView<const uint8_t> inp);
+
+    /**
+     * @brief Encodes the input data into bit-packed binary hypervectors.
+     *
+     * Equivalent to binarize(encode(inp)) but stores one bit per dimension, which is the
+     * representation used by the binary train_init/test/train overloads.
+     *
      * @param inp Input data to be encoded.
-     * @return Encoded hyperdimensional vectors.
+     * @return Bit-packed encoded hypervectors.
+     */
+    BitHVs encode_binary(HVView<const int> inp);
+
+    /**
+     * @brief Bit-packed encoding of samples with uint16 level indices.
+     */
+    BitHVs encode_binary(HVView<const uint16_t> inp);
+
+    /**
+     * @brief Bit-packed encoding of samples with uint8 level indices.
+     */
+    BitHVs encode_binary(HVView<const uint8_t> inp);
+
+    /**
+     * @brief Encodes sparse samples, binding only the features that are present.
+     *
+     * Every entry (feature index, level) of a sample contributes hv_id[index] * hv_lv[level],
+     * so the cost is proportional to the number of entries rather than to n_id. Samples
+     * are encoded in parallel.
+     *
+     * @param inp Sparse samples with feature indices below n_id and levels below n_lv.
+     * @return Encoded hyperdimensional vectors, one row per sample.
+     */
+    HVMatrix<int> encode_sparse(const CSRView& inp);
+
+    /**
+     * @brief Encodes sparse samples into bit-packed binary hypervectors.
+     *
+     * Equivalent to binarize(encode_sparse(inp)) with one bit per dimension.
+     *
+     * @param inp Sparse samples.
+     * @return Bit-packed encoded hypervectors.
      */
-    std::vector<std::vector<int>> encode(const std::vector<std::vector<int>>& inp);
+    BitHVs encode_sparse_binary(const CSRView& inp);
     
     /**
     * @brief Initializes the class hypervectors based on encoded inputs and target labels.
     * @param inp_enc Encoded input data.
     * @param target Target labels.
     */
-    void train_init(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target);
+    void train_init(HVView<const int> inp_enc, const std::vector<int>& target);
+
+    /**
+    * @brief Initializes the class hypervectors from bit-packed encodings.
+    * @param inp_enc Bit-packed encoded input data.
+    * @param target Target labels.
+    */
+    void train_init(const BitHVs& inp_enc, const std::vector<int>& target);
+
+    /**
+    * @brief Adds encoded inputs to running per-class sums, for train_init over chunks.
+    *
+    * Calling this once per chunk and then set_class_hvs(sums) is equivalent to
+    * train_init on the whole data set.
+    *
+    * @param inp_enc Encoded input data.
+    * @param target Target labels.
+    * @param sums n_class x n_dim running sums.
+    */
+    void accumulate_class_sums(HVView<const int> inp_enc, const std::vector<int>& target, HVMatrix<int>& sums) const;
+
+    /**
+    * @brief Adds bit-packed encodings to running per-class sums.
+    * @param inp_enc Bit-packed encoded input data.
+    * @param target Target labels.
+    * @param sums n_class x n_dim running sums.
+    */
+    void accumulate_class_sums(const BitHVs& inp_enc, const std::vector<int>& target, HVMatrix<int>& sums) const;
+
+    /**
+    * @brief Sets the class hypervectors from bundled sums, binarizing them for binary models.
+    * @param sums n_class x n_dim sums, e.g. from accumulate_class_sums().
+    */
+    void set_class_hvs(HVView<const int> sums);
+
+    /**
+     * @brief Computes a 64-bit hash of the ID and level item memories.
+     *
+     * Two models with the same hash and parameters produce identical encodings, so the
+     * hash identifies the generation seed and method when keying cached encodings.
+     * Procedural identifier hypervectors are hashed by their seed rather than their values.
+     *
+     * @return The item memory hash.
+     */
+    uint64_t item_memory_hash() const;
 
     /**
      * @brief Getter for the class hypervectors.
      * @return Class hypervectors.
      */
-    const std::vector<std::vector<int>>& get_class_hvs() const;
+    const HVMatrix<int>& get_class_hvs() const;
+
 
+    /**
+    * @brief Predicts the class of every encoded sample and reports every class score.
+    *
+    * Scores are the ones test() ranks classes by: dot products divided by the class
+    * norms, or dot products with the binarized class hypervectors for binary models.
+    *
+    * @param inp_enc Encoded samples.
+    * @param scores Output inp_enc.rows() x n_class matrix of scores.
+    * @return The predicted class of every sample; ties go to the lowest class index.
+    */
+    std::vector<int> predict(HVView<const int> inp_enc, HVMatrix<double>& scores) const;
+
+    /**
+    * @brief Predicts the class of every bit-packed sample and reports every bipolar dot product.
+    *
+    * @param inp_enc Bit-packed encoded samples.
+    * @param scores Output inp_enc.size() x n_class matrix of scores.
+    * @return The predicted class of every sample; ties go to the lowest class index.
+    */
+    std::vector<int> predict(const BitHVs& inp_enc, HVMatrix<double>& scores) const;
 
     /**
     * @brief Computes the accuracy of the model on the test data.
     *
-    * This function calculates the dot product between the input encodings and the class hypervectors.
-    * If the model is not binary, it normalizes the distances. Finally, it computes the accuracy by
-    * comparing the predicted labels to the target labels.
+    * The class hypervectors are binarized or normalized once, then every sample is scored
+    * against all classes with the blocked argmax_classes() kernel. If the model is not
+    * binary the dot products are divided by the class norms. Finally, it computes the
+    * accuracy by comparing the predicted labels to the target labels.
     *
     * @param inp_enc The encoded input data to be tested.
     * @param target The target labels for the input data.
     * @return The accuracy of the model on the test data.
     */
-    double test(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target);
+    double test(HVView<const int> inp_enc, const std::vector<int>& target);
+
+    /**
+    * @brief Computes the accuracy of a binary model on bit-packed test data.
+    *
+    * The class hypervectors are binarized and packed once, and every similarity is a
+    * XOR/popcount over the packed words.
+    *
+    * @param inp_enc The bit-packed encoded input data to be tested.
+    * @param target The target labels for the input data.
+    * @return The accuracy of the model on the test data.
+    */
+    double test(const BitHVs& inp_enc, const std::vector<int>& target);
 
 
     /**
@@ -62,12 +337,76 @@ public:
     *
     * This function updates the class hypervectors based on the input encodings and
     * target labels. If the predicted label does not match the target label, the
-    * function updates the class hypervectors accordingly.
+    * function updates the class hypervectors accordingly. Class norms and packed
+    * binarized class hypervectors are cached and only the two modified classes are
+    * refreshed, so a correctly predicted sample costs only its distance computation.
+    *
+    * @param inp_enc The encoded input data.
+    * @param target The target labels for the input data.
+    */
+    void train(HVView<const int> inp_enc, const std::vector<int>& target);
+
+    /**
+    * @brief Trains a binary HDC model using bit-packed input encodings.
+    *
+    * Predictions use popcount similarity against packed binarized class hypervectors.
+    * On a misprediction the +1/-1 encoding is added to the target class and subtracted
+    * from the predicted class, and the packed rows of those two classes are refreshed.
+    *
+    * @param inp_enc The bit-packed encoded input data.
+    * @param target The target labels for the input data.
+    */
+    void train(const BitHVs& inp_enc, const std::vector<int>& target);
+
+    /**
+    * @brief Runs one retraining epoch in synchronous mini-batches.
+    *
+    * The samples of a batch are scored in parallel against the class hypervectors as
+    * they were at the start of the batch. Corrections for mispredictions go into
+    * per-thread delta buffers that are summed and applied once per batch, so the result
+    * does not depend on the number of threads. A batch size of 1 is equivalent to train().
+    *
+    * @param inp_enc The encoded input data.
+    * @param target The target labels for the input data.
+    * @param batch_size Number of samples scored against the same class snapshot.
+    * @return Fraction of samples predicted correctly during the epoch.
+    */
+    double train_batched(HVView<const int> inp_enc, const std::vector<int>& target, int batch_size);
+
+    /**
+    * @brief Runs one mini-batch retraining epoch of a binary model on bit-packed encodings.
+    *
+    * @param inp_enc The bit-packed encoded input data.
+    * @param target The target labels for the input data.
+    * @param batch_size Number of samples scored against the same class snapshot.
+    * @return Fraction of samples predicted correctly during the epoch.
+    */
+    double train_batched(const BitHVs& inp_enc, const std::vector<int>& target, int batch_size);
+
+    /**
+    * @brief Runs one lock-free, Hogwild-style asynchronous retraining epoch.
+    *
+    * Every pool thread walks its own contiguous shard of the training set and applies
+    * its corrections straight to the shared class hypervectors with relaxed atomic adds.
+    * Threads score against private snapshots of the class hypervectors, norms and packed
+    * copies, which are only re-read for classes updated since their last look.
+    * Predictions may therefore see slightly stale classes, so results depend on thread
+    * scheduling; with a single thread this is equivalent to train().
     *
     * @param inp_enc The encoded input data.
     * @param target The target labels for the input data.
+    * @return Fraction of samples predicted correctly during the epoch.
+    */
+    double train_hogwild(HVView<const int> inp_enc, const std::vector<int>& target);
+
+    /**
+    * @brief Runs one Hogwild-style retraining epoch of a binary model on bit-packed encodings.
+    *
+    * @param inp_enc The bit-packed encoded input data.
+    * @param target The target labels for the input data.
+    * @return Fraction of samples predicted correctly during the epoch.
     */
-    void train(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target);
+    double train_hogwild(const BitHVs& inp_enc, const std::vector<int>& target);
 
 private:
     int n_class; ///< Number of classes.
@@ -76,18 +415,203 @@ private:
     int n_dim; ///< Dimension of hypervectors.
     bool binary; ///< Whether to use binary hypervectors.
 
-    std::vector<std::vector<int>> hv_lv; ///< Level hypervectors.
-    std::vector<std::vector<int>> hv_id; ///< Identifier hypervectors.
-    std::vector<std::vector<int>> class_hvs; ///< Class hypervectors.
+    HVMatrix<int8_t> hv_lv; ///< Level hypervectors, unless loaded from a model file.
+    HVMatrix<int8_t> hv_id; ///< Identifier hypervectors, unless loaded from a model file, procedural or cyclic.
+    HVMatrix<int8_t> id_bases; ///< Cyclic identifier bases, each stored twice in a row (see generate_cyclic_ids()).
+    std::vector<int> id_offsets; ///< Offset of every cyclic identifier hypervector in id_bases.
+    bool cyclic_ids = false; ///< Whether identifier hypervectors are rotations in id_bases.
+    bool procedural_ids = false; ///< Whether identifier hypervectors are generated from id_seed while encoding.
+    uint64_t id_seed = 0; ///< Seed of the identifier hypervectors.
+    std::shared_ptr<const MappedFile> model_file; ///< Mapping of the model file the model was loaded from.
+    HVView<const int8_t> mapped_lv; ///< Level hypervectors inside model_file.
+    HVView<const int8_t> mapped_id; ///< Identifier hypervectors inside model_file.
+    int flush_every; ///< ID-LV products the encoding kernel may sum in int16 (see bind_flush_interval()).
+    EncodePath requested_path = EncodePath::XOR; ///< Path selected with set_encode_path().
+    EncodePath active_path = EncodePath::FEATURE; ///< Path the encoders take, resolved by encode_path().
+    bool signs_packed = false; ///< Whether pack_signs() has run.
+    bool bipolar_ids = false; ///< Whether id_signs holds the identifiers (not for procedural identifiers).
+    bool bipolar_lvs = false; ///< Whether lv_signs holds the levels.
+    HVMatrix<uint64_t> id_signs; ///< Bits set at -1 of the stored identifiers, or of all shifts of the cyclic bases.
+    HVMatrix<uint64_t> lv_signs; ///< Bits set at -1 of the level hypervectors.
+    HVMatrix<int> class_hvs; ///< Class hypervectors.
+    std::vector<int64_t> class_norms2; ///< Squared L2 norm of every class hypervector.
+    BitHVs bin_class_hvs; ///< Packed binarized class hypervectors.
+
+    HVView<const int8_t> lv_hvs() const { return model_file ? mapped_lv : hv_lv.view(); } ///< Level hypervectors.
+    HVView<const int8_t> id_hvs() const { return model_file ? mapped_id : hv_id.view(); } ///< Identifier hypervectors.
+
+    static constexpr int MIN_GROUP_SIZE = 12; ///< Mean features per level group below which grouping does not pay off.
+    static constexpr int MAX_XOR_FEATURES = 65535; ///< Most features bind_xor_kernel() counts in one call.
 
     /**
-     * @brief Generates a set of random hyperdimensional vectors.
-     * 
+     * @brief Per-thread buffers of the encoders, reused across samples.
+     */
+    struct EncodeScratch {
+        std::vector<int> levels; ///< Widened level indices of a sample.
+        std::vector<int> offsets; ///< Offsets of the cyclic identifiers of a sparse sample.
+        std::vector<int> starts; ///< Start of every level in members, then the end.
+        std::vector<const uint64_t*> members; ///< Sign bits of the identifiers of a sample, sorted by level if grouped.
+        std::vector<const uint64_t*> level_signs; ///< Sign bits of the level of every member, for XOR binding.
+    };
+
+    /**
+     * @brief Sets the parameters and zeroed class state; item memories are left to the caller.
+     */
+    HDC(int n_class, int n_lv, int n_id, int n_dim, bool binary, std::shared_ptr<const MappedFile> file);
+
+    /**
+     * @brief Generates a set of random +1/-1 hyperdimensional vectors.
+     *
+     * Rows are filled in parallel on the global thread pool from item_hv_word(), so the
+     * result only depends on the seed.
+     *
      * @param n Number of hypervectors to generate.
      * @param dim Dimension of each hypervector.
+     * @param seed Seed of the hypervectors.
      * @return Generated hyperdimensional vectors.
      */
-    std::vector<std::vector<int>> generate_hvs(int n, int dim);
+    static HVMatrix<int8_t> generate_hvs(int n, int dim, uint64_t seed);
+
+    /**
+     * @brief Generates correlated level hypervectors like gen_cyclic_lv_hvs() in Python/model.py.
+     *
+     * A base with n_dim / 2 dimensions of -1 is shuffled, and level i negates its first
+     * (i / (n - 1) * dim) / 2 dimensions, so neighbouring levels are similar and the first
+     * and last share half of their dimensions.
+     */
+    static HVMatrix<int8_t> generate_cyclic_levels(int n, int dim, uint64_t seed);
+
+    /**
+     * @brief Generates the cyclic identifier hypervectors into id_bases and id_offsets.
+     *
+     * Identifier j is the base j / n_dim rotated by j % n_dim, like np.roll(). Every base is
+     * stored twice in a row, so a rotation is the n_dim elements starting n_dim - j % n_dim
+     * into it and the encoding kernels read it in place at id_offsets[j]. Only
+     * ceil(n_id / n_dim) bases are stored instead of n_id rows.
+     */
+    void generate_cyclic_ids(uint64_t seed);
+
+    /**
+     * @brief Writes the n_dim values of identifier hypervector i, however it is stored.
+     */
+    void copy_id_row(int i, int8_t* out) const;
+
+    /**
+     * @brief Shared implementation of the encode overloads.
+     *
+     * Narrow level indices are widened one sample at a time, so the input is never copied.
+     */
+    template <typename Level>
+    HVMatrix<int> encode_levels(HVView<const Level> inp);
+
+    /**
+     * @brief Shared implementation of the encode_binary overloads.
+     */
+    template <typename Level>
+    BitHVs encode_levels_binary(HVView<const Level> inp);
+
+    /**
+     * @brief Computes the unbinarized encoding of a single sample.
+     *
+     * Runs encode_xor() or encode_grouped() as encode_path() selects, and otherwise the
+     * SIMD bind-and-bundle kernel selected by bind_bundle_kernel(), or by
+     * bind_bundle_procedural_kernel() with procedural identifier hypervectors.
+     *
+     * @param sample Level indices of the sample, one per identifier hypervector.
+     * @param out n_dim output values.
+     * @param scratch Buffers of the calling thread.
+     */
+    void encode_sample(const int* sample, int* out, EncodeScratch& scratch) const;
+
+    /**
+     * @brief Computes the unbinarized encoding of sparse sample i.
+     *
+     * @param inp Sparse samples.
+     * @param i Sample to encode.
+     * @param out n_dim output values.
+     * @param scratch Buffers of the calling thread.
+     */
+    void encode_sparse_sample(const CSRView& inp, size_t i, int* out, EncodeScratch& scratch) const;
+
+    /**
+     * @brief Level-grouped encoding of one sample, bit-exact with the bind-and-bundle kernels.
+     *
+     * Features are counting-sorted by level, and the sign bits of each group's identifiers
+     * are bound with the level hypervector by bind_group_kernel(), 255 members at a time.
+     * Every group costs a pass over the dimensions, so samples whose groups average fewer
+     * than MIN_GROUP_SIZE features are left to the per-feature kernels.
+     *
+     * @param ids Identifier index of each feature, or nullptr when feature j uses identifier j.
+     * @param levels Level index of each feature.
+     * @param n Number of features.
+     * @param out n_dim output values.
+     * @param scratch Buffers of the calling thread.
+     * @return false if the sample was not encoded because its groups are too small.
+     */
+    bool encode_grouped(const int* ids, const int* levels, int n, int* out, EncodeScratch& scratch) const;
+
+    /**
+     * @brief XOR-bound encoding of one sample, bit-exact with the bind-and-bundle kernels.
+     *
+     * Gathers the sign bits of every feature's identifier and level and bundles them with
+     * bind_xor_kernel(), into out or, for binary encodings, directly into packed bits.
+     *
+     * @param ids Identifier index of each feature, or nullptr when feature j uses identifier j.
+     * @param levels Level index of each feature.
+     * @param n Number of features.
+     * @param out n_dim output values, or nullptr to write bits.
+     * @param bits Packed binarized encoding (see BitHVs), written when out is nullptr.
+     * @param scratch Buffers of the calling thread.
+     * @return false if the sample was not encoded because it has more than MAX_XOR_FEATURES features.
+     */
+    bool encode_xor(const int* ids, const int* levels, int n, int* out, uint64_t* bits,
+                    EncodeScratch& scratch) const;
+
+    /**
+     * @brief Packs the sign bits of +1/-1 item memories into id_signs and lv_signs.
+     *
+     * Cyclic identifiers are packed as all shifts of their bases, stored identifiers in
+     * parallel, and procedural identifiers not at all. A memory with other values is left
+     * unpacked, and its bipolar_ids or bipolar_lvs flag false.
+     */
+    void pack_signs();
+
+    /**
+     * @brief Returns the sign bits of identifier hypervector j in id_signs, a set bit for -1.
+     *
+     * The words are readable in whole blocks of 8; bits past n_dim are unspecified.
+     */
+    const uint64_t* id_sign_words(int j) const;
+
+    /**
+     * @brief Recomputes the squared norm and packed binarized copy of class i.
+     *
+     * Must be called whenever class_hvs[i] changes, which keeps both caches in sync at
+     * O(n_dim) cost per modified class instead of O(n_class * n_dim) per sample.
+     */
+    void refresh_class_row(int i);
+
+    /**
+     * @brief Binarizes (binary models) or copies the class hypervectors and computes their norms.
+     * @return Class matrix ready for argmax_classes().
+     */
+    ClassMatrix prepare_class_matrix() const;
+
+    /**
+     * @brief Adds the per-thread deltas of a mini-batch onto the class hypervectors.
+     *
+     * Only classes that were a target or a prediction of a mispredicted sample are
+     * touched; their delta rows are cleared for the next batch.
+     *
+     * @param begin First sample of the batch.
+     * @param n Number of samples in the batch.
+     * @param pred Predicted class of each sample of the batch.
+     * @param target Class label of every sample.
+     * @param partial Per-thread delta buffers.
+     * @return Number of correctly predicted samples in the batch.
+     */
+    int apply_corrections(size_t begin, size_t n, const int* pred, const std::vector<int>& target,
+                          std::vector<HVMatrix<int>>& partial);
 
 
     
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+#include "lsh_index.h"
+#include "similarity.h"
+#include "thread_pool.h"
+
+uint32_t LshIndex::key(const Table& table, const uint64_t* hv) {
+    uint32_t k = 0;
+    for (size_t b = 0; b < table.dims.size(); ++b) {
+        int d = table.dims[b];
+        k |= static_cast<uint32_t>((hv[d / BitHVs::BITS_PER_WORD] >> (d % BitHVs::BITS_PER_WORD)) & 1) << b;
+    }
+    return k;
+}
+
+bool LshIndex::build(const BitHVs& refs, const LshParams& params) {
+    if (params.n_tables < 1 || params.bits_per_key < 1 || params.bits_per_key > MAX_BITS_PER_KEY ||
+        params.bits_per_key > refs.dim() || params.probes < 0 || params.probes > params.bits_per_key) {
+        std::cerr << "Invalid LSH parameters: tables = " << params.n_tables << ", bits = " << params.bits_per_key
+                  << ", probes = " << params.probes << std::endl;
+        return false;
+    }
+    this->refs = BitHVs(refs.view(), refs.dim());
+    config = params;
+    tables.assign(params.n_tables, Table());
+
+    // Dimensions are drawn up front from one generator, so the index only depends on the seed
+    std::mt19937_64 rng(params.seed);
+    std::vector<int> all_dims(refs.dim());
+    std::iota(all_dims.begin(), all_dims.end(), 0);
+    for (Table& table : tables) {
+        for (int b = 0; b < params.bits_per_key; ++b) {
+            std::uniform_int_distribution<int> pick(b, refs.dim() - 1);
+            std::swap(all_dims[b], all_dims[pick(rng)]);
+        }
+        table.dims.assign(all_dims.begin(), all_dims.begin() + params.bits_per_key);
+    }
+
+    size_t n_buckets = size_t(1) << params.bits_per_key;
+    ThreadPool::global().parallel_for(0, tables.size(), 1, [&](size_t begin, size_t end, int) {
+        std::vector<uint32_t> keys(refs.size());
+        for (size_t t = begin; t < end; ++t) {
+            Table& table = tables[t];
+            table.offsets.assign(n_buckets + 1, 0);
+            for (size_t i = 0; i < refs.size(); ++i) {
+                keys[i] = key(table, refs.row(i));
+                ++table.offsets[keys[i] + 1];
+            }
+            std::partial_sum(table.offsets.begin(), table.offsets.end(), table.offsets.begin());
+            table.ids.resize(refs.size());
+            std::vector<uint32_t> fill(table.offsets.begin(), table.offsets.end() - 1);
+            for (size_t i = 0; i < refs.size(); ++i) {
+                table.ids[fill[keys[i]]++] = i;
+            }
+        }
+    });
+    return true;
+}
+
+size_t LshIndex::query(const BitHVs& queries, int k, HVMatrix<int>& ids, HVMatrix<int>& dots) const {
+    ids = HVMatrix<int>(queries.size(), k);
+    dots = HVMatrix<int>(queries.size(), k);
+    int n_words = refs.words();
+    int n_dim = refs.dim();
+
+    std::vector<size_t> candidates(ThreadPool::global().size(), 0);
+    ThreadPool::global().parallel_for(0, queries.size(), 0, [&](size_t begin, size_t end, int tid) {
+        // A reference is re-ranked once per query: seen[r] == stamp marks it as already visited
+        std::vector<uint32_t> seen(refs.size(), 0);
+        uint32_t stamp = 0;
+        TopK best(k);
+        for (size_t q = begin; q < end; ++q) {
+            const uint64_t* x = queries.row(q);
+            ++stamp;
+            best.clear();
+            for (const Table& table : tables) {
+                uint32_t base = key(table, x);
+                for (int p = 0; p <= config.probes; ++p) {
+                    uint32_t bucket = p == 0 ? base : base ^ (uint32_t(1) << (p - 1));
+                    for (uint32_t j = table.offsets[bucket]; j < table.offsets[bucket + 1]; ++j) {
+                        uint32_t r = table.ids[j];
+                        if (seen[r] != stamp) {
+                            seen[r] = stamp;
+                            best.push(bit_dot(x, refs.row(r), n_words, n_dim), r);
+                            ++candidates[tid];
+                        }
+                    }
+                }
+            }
+            best.write(ids.row(q), dots.row(q));
+        }
+    });
+    return std::accumulate(candidates.begin(), candidates.end(), size_t(0));
+}
@@ -0,0 +1,92 @@
+#ifndef LSH_INDEX_H
+#define LSH_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bithv.h"
+
+/**
+ * @brief Recall/speed knobs of LshIndex.
+ *
+ * More tables and probes raise recall and the number of candidates re-ranked; more bits
+ * per key make buckets smaller, which lowers both.
+ */
+struct LshParams {
+    int n_tables = 32; ///< Independent hash tables.
+    int bits_per_key = 16; ///< Sampled dimensions per key, at most MAX_BITS_PER_KEY.
+    int probes = 0; ///< Extra buckets visited per table, each with one key bit flipped.
+    uint64_t seed = 1; ///< Seed of the sampled dimensions.
+};
+
+/**
+ * @class LshIndex
+ * @brief Bit-sampling locality-sensitive hash index over bit-packed reference hypervectors.
+ *
+ * Every table keys a hypervector by bits_per_key of its dimensions sampled without
+ * replacement, so two hypervectors at Hamming distance h share a key with probability
+ * (1 - h / n_dim)^bits_per_key. The candidates found in any table are re-ranked with the
+ * exact bit_dot(), so results only differ from topk_classes() by missed neighbours, never
+ * by wrong scores.
+ *
+ * Tables are direct-addressed CSR arrays of 2^bits_per_key buckets. The index borrows the
+ * references, which must outlive it and stay unchanged.
+ */
+class LshIndex {
+public:
+    static constexpr int MAX_BITS_PER_KEY = 24; ///< Keeps one table below 64 MiB of offsets.
+
+    LshIndex() = default;
+
+    /**
+     * @brief Hashes every reference into the tables, one table per pool task.
+     *
+     * @param refs Bit-packed references.
+     * @param params Index configuration.
+     * @return True if the index was built, false if the parameters are invalid.
+     */
+    bool build(const BitHVs& refs, const LshParams& params);
+
+    /**
+     * @brief Finds the approximate k nearest references of every query.
+     *
+     * Queries are split across the global thread pool.
+     *
+     * @param queries Bit-packed queries of the reference dimension.
+     * @param k Number of neighbours per query.
+     * @param ids Output queries.size() x k reference indices, best first (see TopK);
+     *            -1 where fewer than k candidates were found.
+     * @param dots Output queries.size() x k bipolar dot products matching ids.
+     * @return Total number of distinct candidates re-ranked over all queries.
+     */
+    size_t query(const BitHVs& queries, int k, HVMatrix<int>& ids, HVMatrix<int>& dots) const;
+
+    /**
+     * @brief Number of indexed references.
+     */
+    size_t size() const { return refs.size(); }
+
+    /**
+     * @brief Configuration the index was built with.
+     */
+    const LshParams& params() const { return config; }
+
+private:
+    /**
+     * @brief One hash table: the sampled dimensions and the references of every bucket.
+     */
+    struct Table {
+        std::vector<int> dims; ///< Sampled dimensions, least significant key bit first.
+        std::vector<uint32_t> offsets; ///< 2^bits_per_key + 1 bucket starts into ids.
+        std::vector<uint32_t> ids; ///< Reference indices grouped by bucket.
+    };
+
+    BitHVs refs; ///< Borrowed view of the references.
+    LshParams config; ///< Configuration of the tables.
+    std::vector<Table> tables; ///< The hash tables.
+
+    static uint32_t key(const Table& table, const uint64_t* hv);
+};
+
+#endif // LSH_INDEX_H
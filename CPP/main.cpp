@@ -1,11 +1,21 @@
+#include <chrono>
+#include <cmath>
 #include <iostream> 
+#include <memory>
 #include <fstream>
 #include <string>
 #include <sstream>
 #include <vector>
 #include "dataset.h"
 #include "utils.h"
+#include "encode_kernels.h"
+#include "encoded_cache.h"
+#include "genome.h"
 #include "hdc.h"
+#include "oms.h"
+#include "server.h"
+#include "stream.h"
+#include "thread_pool.h"
 
 
 /**
@@ -37,7 +47,7 @@ bool test_dataset() {
     for (int i = 0; i < std::min(5, dataset.train.size); ++i) {
         std::cout << "Sample " << i << ": ";
         for (int j = 0; j < std::min(5, dataset.train.sample_size); ++j) {
-            std::cout << dataset.train.values[i][j] << " ";
+            std::cout << dataset.train.view(i, j) << " ";
         }
         std::cout << std::endl;
     }
@@ -54,7 +64,7 @@ bool test_dataset() {
     for (int i = 0; i < std::min(5, dataset.test.size); ++i) {
         std::cout << "Sample " << i << ": ";
         for (int j = 0; j < std::min(5, dataset.test.sample_size); ++j) {
-            std::cout << dataset.test.values[i][j] << " ";
+            std::cout << dataset.test.view(i, j) << " ";
         }
         std::cout << std::endl;
     }
@@ -74,50 +84,251 @@ bool test_dataset() {
 }
 
 /**
- * @brief Read the HDC parameters from the file.
+ * @brief Converts a text dataset into the binary dataset.bin format read by Dataset.
+ *
+ * The text files are always parsed, so an existing dataset.bin is refreshed.
+ *
+ * @return false if the dataset was converted successfully, true otherwise.
  */
-bool open_hdc_parameters(std::string dataset_name, int& n_dim, bool& binary, int& train_epochs, int& n_lv, int& n_class) {
-    std::string filename = "./dataset/" + dataset_name + "/hdc_parameters";
-    std::ifstream file(filename);
-    
-    if (!file.is_open()) {
-        std::cerr << "Error opening file " << filename << std::endl;
+bool convert_dataset(std::string& dataset_name) {
+    Dataset dataset;
+    if (dataset.load_text(dataset_name) != 0) {
+        std::cerr << "Failed to load the dataset" << std::endl;
         return true;
     }
 
-    std::string line;
-    
-    std::getline(file, line);
-    n_dim = std::stoi(line);
+    std::string filename = "./dataset/" + dataset_name + "/dataset.bin";
+    if (!dataset.write_binary(filename)) {
+        return true;
+    }
+    std::cout << "INFO: wrote " << filename << std::endl;
+    return false;
+}
 
-    
-    std::getline(file, line);
-    binary = std::stoi(line);
+/**
+ * @brief Selects how run_training performs the re-training epochs.
+ */
+struct RetrainOptions {
+    int batch_size = 0; ///< Mini-batch size for HDC::train_batched, or 0 for the serial HDC::train.
+    bool hogwild = false; ///< Use the asynchronous HDC::train_hogwild instead.
 
+    bool reports_train_acc() const { return hogwild || batch_size > 0; } ///< Whether epochs return a training accuracy.
+};
 
+/**
+ * @brief Runs initial training, re-training and periodic testing on encoded data.
+ *
+ * @tparam Encoded Encoding container, either integer or bit-packed hypervectors.
+ */
+template <typename Encoded>
+void run_training(HDC& hdc_model, const Encoded& train_enc, const std::vector<int>& train_labels,
+                  const Encoded& test_enc, const std::vector<int>& test_labels, int train_epochs,
+                  const RetrainOptions& retrain) {
+    // Init. Training
+    hdc_model.train_init(train_enc, train_labels);
 
-    std::getline(file, line);
-    train_epochs = std::stoi(line);
+    // Initial test accuracy
+    double test_acc = hdc_model.test(test_enc, test_labels);
+    std::cout << "Init. test acc. is " << test_acc << std::endl;
 
-    
+    // Re-training
+    int val_epochs = 5;
+    for (int i = 0; i < train_epochs; ++i) {
+        double train_acc = 0.0;
+        if (retrain.hogwild) {
+            train_acc = hdc_model.train_hogwild(train_enc, train_labels);
+        } else if (retrain.batch_size > 0) {
+            train_acc = hdc_model.train_batched(train_enc, train_labels, retrain.batch_size);
+        } else {
+            hdc_model.train(train_enc, train_labels);
+        }
 
-    std::getline(file, line);
-    n_lv = std::stoi(line);
+        if ((i + 1) % val_epochs == 0) {
+            if (retrain.reports_train_acc()) {
+                std::cout << "Train acc. @ epoch " << (i + 1) << "/" << train_epochs << " is " << train_acc << std::endl;
+            }
+            test_acc = hdc_model.test(test_enc, test_labels);
+            std::cout << "Test acc. @ epoch " << (i + 1) << "/" << train_epochs << " is " << test_acc << std::endl;
+        }
+    }
 
-    
+    test_acc = hdc_model.test(test_enc, test_labels);
+    std::cout << "Final test acc. is " << test_acc << std::endl;
+}
+
+/**
+ * @brief Selects the out-of-core streaming mode of train_test.
+ */
+struct StreamOptions {
+    bool enabled = false; ///< Stream chunks of samples instead of loading and encoding whole subsets.
+    size_t memory_budget = 256; ///< Megabytes available for in-flight raw and encoded chunks.
+    std::string spill_path; ///< Prefix of the scratch files caching encodings, or empty to re-encode every pass.
+    size_t ring_slots = 2; ///< Chunks queued between two pipeline stages.
+};
 
-    std::getline(file, line);
-    n_class = std::stoi(line);
+/**
+ * @brief Selects where train_test caches encoded hypervectors between runs.
+ */
+struct CacheOptions {
+    bool enabled = true; ///< Reuse and write the on-disk encoding cache.
+    std::string dir; ///< Directory of the cache files, or empty for the dataset directory.
+};
 
-    
+/**
+ * @brief Runs one streaming pass of a subset through HDC::test.
+ *
+ * @return The accuracy over the whole subset, or a negative value if the pass failed.
+ */
+template <typename Encoded, typename EncodeFn>
+double stream_test(HDC& hdc_model, SampleReader& reader, SpillFile& spill, size_t chunk_rows,
+                   const StreamOptions& stream, EncodeFn& encode) {
+    size_t correct = 0;
+    size_t total = 0;
+    bool ok = stream_pass<Encoded>(reader, spill, chunk_rows, stream.ring_slots, encode,
+                                   [&](const Encoded& hvs, const std::vector<int>& labels) {
+        correct += std::lround(hdc_model.test(hvs, labels) * labels.size());
+        total += labels.size();
+    });
+    if (!ok) {
+        return -1.0;
+    }
+    return total ? static_cast<double>(correct) / total : 0.0;
+}
+
+/**
+ * @brief Streaming counterpart of run_training, holding only a few chunks in memory.
+ *
+ * Initial training bundles per-class sums chunk by chunk, and re-training and testing
+ * call the HDC methods once per chunk, which gives the same model as run_training for
+ * serial and mini-batch re-training. Chunks hold whole mini-batches, at least one even
+ * when the memory budget allows fewer rows.
+ *
+ * @tparam Encoded Encoding container, either integer or bit-packed hypervectors.
+ * @return false if every pass succeeded, true otherwise.
+ */
+template <typename Encoded, typename EncodeFn>
+bool run_streaming(HDC& hdc_model, SampleReader& train_reader, SampleReader& test_reader, EncodeFn encode,
+                   int n_class, int n_dim, size_t encoded_bytes, int train_epochs, const RetrainOptions& retrain,
+                   const StreamOptions& stream) {
+    size_t raw_bytes = HVMatrix<int>::padded_stride(train_reader.sample_size()) * sizeof(int);
+    size_t chunk_rows = stream_chunk_rows(stream.memory_budget << 20, raw_bytes, encoded_bytes, stream.ring_slots);
+    if (retrain.batch_size > 0) {
+        // Whole mini-batches per chunk keep the batch boundaries of the in-memory run
+        size_t batch_size = retrain.batch_size;
+        chunk_rows = chunk_rows < batch_size ? batch_size : chunk_rows - chunk_rows % batch_size;
+    }
+    std::cout << "INFO: stream chunk = " << chunk_rows << " samples" << std::endl;
+
+    SpillFile train_spill;
+    SpillFile test_spill;
+    if (!stream.spill_path.empty()) {
+        if (!train_spill.create(stream.spill_path + ".train", n_dim) ||
+            !test_spill.create(stream.spill_path + ".test", n_dim)) {
+            return true;
+        }
+    }
+
+    // Init. Training
+    HVMatrix<int> sums(n_class, n_dim, 0);
+    if (!stream_pass<Encoded>(train_reader, train_spill, chunk_rows, stream.ring_slots, encode,
+                              [&](const Encoded& hvs, const std::vector<int>& labels) {
+        hdc_model.accumulate_class_sums(hvs, labels, sums);
+    })) {
+        return true;
+    }
+    hdc_model.set_class_hvs(sums);
+
+    // Initial test accuracy
+    double test_acc = stream_test<Encoded>(hdc_model, test_reader, test_spill, chunk_rows, stream, encode);
+    if (test_acc < 0) {
+        return true;
+    }
+    std::cout << "Init. test acc. is " << test_acc << std::endl;
+
+    // Re-training
+    int val_epochs = 5;
+    for (int i = 0; i < train_epochs; ++i) {
+        double train_correct = 0.0;
+        if (!stream_pass<Encoded>(train_reader, train_spill, chunk_rows, stream.ring_slots, encode,
+                                  [&](const Encoded& hvs, const std::vector<int>& labels) {
+            if (retrain.hogwild) {
+                train_correct += hdc_model.train_hogwild(hvs, labels) * labels.size();
+            } else if (retrain.batch_size > 0) {
+                train_correct += hdc_model.train_batched(hvs, labels, retrain.batch_size) * labels.size();
+            } else {
+                hdc_model.train(hvs, labels);
+            }
+        })) {
+            return true;
+        }
+
+        if ((i + 1) % val_epochs == 0) {
+            if (retrain.reports_train_acc()) {
+                double train_acc = std::lround(train_correct) / static_cast<double>(train_reader.size());
+                std::cout << "Train acc. @ epoch " << (i + 1) << "/" << train_epochs << " is " << train_acc << std::endl;
+            }
+            test_acc = stream_test<Encoded>(hdc_model, test_reader, test_spill, chunk_rows, stream, encode);
+            if (test_acc < 0) {
+                return true;
+            }
+            std::cout << "Test acc. @ epoch " << (i + 1) << "/" << train_epochs << " is " << test_acc << std::endl;
+        }
+    }
+
+    test_acc = stream_test<Encoded>(hdc_model, test_reader, test_spill, chunk_rows, stream, encode);
+    if (test_acc < 0) {
+        return true;
+    }
+    std::cout << "Final test acc. is " << test_acc << std::endl;
+    return false;
+}
+
+/**
+ * @brief Bytes of one encoded sample, integer or bit-packed, as held in a chunk.
+ */
+size_t encoded_row_bytes(int n_dim, bool binary) {
+    if (binary) {
+        return HVMatrix<uint64_t>::padded_stride(BitHVs(0, n_dim).words()) * sizeof(uint64_t);
+    }
+    return HVMatrix<int>::padded_stride(n_dim) * sizeof(int);
+}
+
+/**
+ * @brief Trains and tests on a dataset streamed in chunks within a memory budget.
+ */
+bool stream_train_test(HDC& hdc_model, SampleReader& train_reader, SampleReader& test_reader, int n_class,
+                       int n_dim, bool binary, int train_epochs, const RetrainOptions& retrain,
+                       const StreamOptions& stream) {
+    if (binary) {
+        auto encode = [&](HVView<const int> values) { return hdc_model.encode_binary(values); };
+        return run_streaming<BitHVs>(hdc_model, train_reader, test_reader, encode, n_class, n_dim,
+                                     encoded_row_bytes(n_dim, binary),
+                                     train_epochs, retrain, stream);
+    }
+    auto encode = [&](HVView<const int> values) { return hdc_model.encode(values); };
+    return run_streaming<HVMatrix<int>>(hdc_model, train_reader, test_reader, encode, n_class, n_dim,
+                                        encoded_row_bytes(n_dim, binary),
+                                        train_epochs, retrain, stream);
+}
+
+/**
+ * @brief Saves a trained model for later --infer runs.
+ *
+ * @return false if the model was saved successfully, true otherwise.
+ */
+bool save_model(const HDC& hdc_model, const std::string& model_path) {
+    if (!hdc_model.save(model_path)) {
+        return true;
+    }
+    std::cout << "INFO: saved model " << model_path << std::endl;
     return false;
-    
 }
 
 /**
  * @brief Test function for the HDC class.
  */
-bool train_test(std::string& dataset_name) {
+bool train_test(std::string& dataset_name, const RetrainOptions& retrain, const StreamOptions& stream,
+                const CacheOptions& cache, const std::string& model_path, const ItemMemoryOptions& items) {
 
     // TODO: avoid hardcoding 
     int n_dim = 2048;
@@ -131,7 +342,8 @@ bool train_test(std::string& dataset_name) {
     // Create a Dataset object
     Dataset dataset;
 
-    if (open_hdc_parameters(dataset_name, n_dim, binary, train_epochs, n_lv, n_class)) {
+    ItemMemoryOptions model_items = items;
+    if (open_hdc_parameters(dataset_name, n_dim, binary, train_epochs, n_lv, n_class, model_items.method)) {
         return true;
     }
 
@@ -140,11 +352,37 @@ bool train_test(std::string& dataset_name) {
     std::cout << "INFO: n_class = " << n_class << std::endl;
     std::cout << "INFO: n_lv = " << n_lv << std::endl; 
     std::cout << "INFO: train_epochs = " << train_epochs << std::endl;
+    std::cout << "INFO: item method = " << (model_items.method == ItemMethod::CYCLIC ? "cyclic" : "random") << std::endl;
+    std::cout << "INFO: batch_size = " << retrain.batch_size << std::endl;
+    std::cout << "INFO: hogwild = " << retrain.hogwild << std::endl;
+
+    if (stream.enabled) {
+        std::cout << "INFO: memory budget = " << stream.memory_budget << " MB" << std::endl;
+        SampleReader train_reader;
+        SampleReader test_reader;
+        if (!train_reader.open(dataset_name, true) || !test_reader.open(dataset_name, false)) {
+            std::cerr << "Failed to open the dataset" << std::endl;
+            return true;
+        }
+        std::cout << "INFO: Test Size: " << test_reader.size() << std::endl;
+        std::cout << "INFO: Train Size: " << train_reader.size() << std::endl;
+        std::cout << "INFO: Sample Size: " << train_reader.sample_size() << std::endl;
+
+        HDC hdc_model(n_class, n_lv, train_reader.sample_size(), n_dim, binary, model_items);
+        if (stream_train_test(hdc_model, train_reader, test_reader, n_class, n_dim, binary, train_epochs, retrain,
+                              stream)) {
+            return true;
+        }
+        return !model_path.empty() && save_model(hdc_model, model_path);
+    }
 
+    auto load_start = std::chrono::steady_clock::now();
     if (dataset.load_dataset(dataset_name) != 0) {
         std::cerr << "Failed to load the dataset" << std::endl;
         return true;
     }
+    std::chrono::duration<double> load_time = std::chrono::steady_clock::now() - load_start;
+    std::cout << "INFO: load time = " << load_time.count() << " s" << std::endl;
 
     int n_id = dataset.sample_size;
     
@@ -159,42 +397,131 @@ bool train_test(std::string& dataset_name) {
 
     
     // HDC Model
-    HDC hdc_model(n_class, n_lv, n_id, n_dim, binary);
-
-    // HDC Encoding Step
-    std::vector<std::vector<int>> train_enc = hdc_model.encode(ds_train.first);
-
-    std::vector<std::vector<int>> test_enc = hdc_model.encode(ds_test.first);
-
-    // Init. Training
-    hdc_model.train_init(train_enc, ds_train.second);
-
-    // Initial test accuracy
-    double test_acc = hdc_model.test(test_enc, ds_test.second);
-    std::cout << "Init. test acc. is " << test_acc << std::endl;
-
-
-    
-    // Re-training
-    int val_epochs = 5;
-    for (int i = 0; i < train_epochs; ++i) {
-        hdc_model.train(train_enc, ds_train.second);
+    HDC hdc_model(n_class, n_lv, n_id, n_dim, binary, model_items);
+
+    // Encodings only depend on the data, the HDC parameters and the item memories
+    EncodedCacheKey key;
+    key.dataset_hash = dataset.get_content_hash();
+    key.item_memory_hash = hdc_model.item_memory_hash();
+    key.n_dim = n_dim;
+    key.n_lv = n_lv;
+    key.n_id = n_id;
+    key.binary = binary;
+    std::string cache_file = EncodedCache::path(cache.dir.empty() ? "./dataset/" + dataset_name : cache.dir, key);
+    EncodedCache encoded;
+    bool hit = cache.enabled && encoded.open(cache_file, key);
+    if (hit) {
+        std::cout << "INFO: encoding cache hit " << cache_file << std::endl;
+    }
 
-        if ((i + 1) % val_epochs == 0) {
-            test_acc = hdc_model.test(test_enc, ds_test.second);
-            std::cout << "Test acc. @ epoch " << (i + 1) << "/" << train_epochs << " is " << test_acc << std::endl;
+    auto encode_start = std::chrono::steady_clock::now();
+    auto report_encode = [&] {
+        std::chrono::duration<double> encode_time = std::chrono::steady_clock::now() - encode_start;
+        std::cout << "INFO: encode time = " << encode_time.count() << " s" << std::endl;
+    };
+
+    if (binary) {
+        // Binary models keep their encodings bit-packed end to end
+        if (hit) {
+            BitHVs train_enc = encoded.bits(true);
+            BitHVs test_enc = encoded.bits(false);
+            report_encode();
+            run_training(hdc_model, train_enc, ds_train.second, test_enc, ds_test.second, train_epochs, retrain);
+        } else {
+            auto encode = [&](auto values) { return hdc_model.encode_binary(values); };
+            BitHVs train_enc = ds_train.first.visit(encode);
+            BitHVs test_enc = ds_test.first.visit(encode);
+            report_encode();
+            if (cache.enabled && EncodedCache::write(cache_file, key, train_enc, test_enc)) {
+                std::cout << "INFO: wrote encoding cache " << cache_file << std::endl;
+            }
+            run_training(hdc_model, train_enc, ds_train.second, test_enc, ds_test.second, train_epochs, retrain);
+        }
+    } else if (hit) {
+        // Mapped encodings are used in place
+        HVView<const int> train_enc = encoded.values(true);
+        HVView<const int> test_enc = encoded.values(false);
+        report_encode();
+        run_training(hdc_model, train_enc, ds_train.second, test_enc, ds_test.second, train_epochs, retrain);
+    } else {
+        // HDC Encoding Step
+        auto encode = [&](auto values) { return hdc_model.encode(values); };
+        HVMatrix<int> train_enc = ds_train.first.visit(encode);
+        HVMatrix<int> test_enc = ds_test.first.visit(encode);
+        report_encode();
+        if (cache.enabled && EncodedCache::write(cache_file, key, train_enc, test_enc)) {
+            std::cout << "INFO: wrote encoding cache " << cache_file << std::endl;
         }
+        run_training(hdc_model, train_enc, ds_train.second, test_enc, ds_test.second, train_epochs, retrain);
     }
 
-    test_acc = hdc_model.test(test_enc, ds_test.second);
-    std::cout << "Final test acc. is " << test_acc << std::endl;
-
     // if (BINARY) {
     //     for (auto& hv : hdc_model.get_class_hvs()) {
     //         hv = binarize(hv);
     //     }
     // }
 
+    return !model_path.empty() && save_model(hdc_model, model_path);
+}
+
+/**
+ * @brief Scores the test set of a dataset with a model saved by --save-model, without training.
+ *
+ * The model file is mapped, so start-up does not depend on the size of the item
+ * memories, and the test set is streamed in chunks within the memory budget.
+ *
+ * @return false if the test set was scored successfully, true otherwise.
+ */
+bool infer(std::string& dataset_name, const std::string& model_path, const StreamOptions& stream) {
+    auto load_start = std::chrono::steady_clock::now();
+    std::unique_ptr<HDC> hdc_model = HDC::load(model_path);
+    if (!hdc_model) {
+        std::cerr << "Failed to load the model" << std::endl;
+        return true;
+    }
+    std::chrono::duration<double, std::milli> load_time = std::chrono::steady_clock::now() - load_start;
+    std::cout << "INFO: model load time = " << load_time.count() << " ms" << std::endl;
+
+    int n_dim = hdc_model->get_n_dim();
+    bool binary = hdc_model->is_binary();
+    std::cout << "INFO: n_dim = " << n_dim << std::endl;
+    std::cout << "INFO: binary = " << binary << std::endl;
+    std::cout << "INFO: n_class = " << hdc_model->get_n_class() << std::endl;
+    std::cout << "INFO: n_lv = " << hdc_model->get_n_lv() << std::endl;
+
+    SampleReader test_reader;
+    if (!test_reader.open(dataset_name, false)) {
+        std::cerr << "Failed to open the dataset" << std::endl;
+        return true;
+    }
+    std::cout << "INFO: Test Size: " << test_reader.size() << std::endl;
+    if (test_reader.sample_size() != hdc_model->get_n_id()) {
+        std::cerr << "Samples have " << test_reader.sample_size() << " points but the model expects "
+                  << hdc_model->get_n_id() << std::endl;
+        return true;
+    }
+
+    size_t raw_bytes = HVMatrix<int>::padded_stride(test_reader.sample_size()) * sizeof(int);
+    size_t chunk_rows = stream_chunk_rows(stream.memory_budget << 20, raw_bytes, encoded_row_bytes(n_dim, binary),
+                                          stream.ring_slots);
+    SpillFile no_spill;
+
+    auto score_start = std::chrono::steady_clock::now();
+    double test_acc;
+    if (binary) {
+        auto encode = [&](HVView<const int> values) { return hdc_model->encode_binary(values); };
+        test_acc = stream_test<BitHVs>(*hdc_model, test_reader, no_spill, chunk_rows, stream, encode);
+    } else {
+        auto encode = [&](HVView<const int> values) { return hdc_model->encode(values); };
+        test_acc = stream_test<HVMatrix<int>>(*hdc_model, test_reader, no_spill, chunk_rows, stream, encode);
+    }
+    if (test_acc < 0) {
+        return true;
+    }
+    std::chrono::duration<double> score_time = std::chrono::steady_clock::now() - score_start;
+    std::cout << "INFO: score time = " << score_time.count() << " s ("
+              << test_reader.size() / std::max(score_time.count(), 1e-9) << " samples/s)" << std::endl;
+    std::cout << "Test acc. is " << test_acc << std::endl;
     return false;
 }
 
@@ -202,14 +529,383 @@ bool train_test(std::string& dataset_name) {
 
 
 
+/**
+ * @brief Configuration of the open modification search mode.
+ */
+struct OmsOptions {
+    bool enabled = false; ///< Whether to search ref.spectra with query.spectra instead of training.
+    MzTolerance tol; ///< Precursor window of every query.
+    int top_k = 1; ///< Matches reported per query.
+    std::string out_path; ///< File receiving the matches, or empty.
+};
+
+/**
+ * @brief Searches the query spectra of an OMS dataset against its reference library.
+ *
+ * Reads ref.spectra, query.spectra and oms_parameters written by utils.save_oms_dataset(),
+ * encodes both sides into binary hypervectors and scores every query only against the
+ * references within its precursor m/z window (see PrecursorIndex).
+ *
+ * @return false if the search completed successfully, true otherwise.
+ */
+bool oms_search(std::string& dataset_name, const OmsOptions& oms, const ItemMemoryOptions& items) {
+    int n_dim = 2048;
+    bool binary = true;
+    int train_epochs = 0;
+    int n_lv = 64;
+    int n_class = 0;
+    ItemMemoryOptions model_items = items;
+    if (open_hdc_parameters(dataset_name, n_dim, binary, train_epochs, n_lv, n_class, model_items.method)) {
+        return true;
+    }
+    if (!binary) {
+        std::cerr << "OMS search needs a binary model" << std::endl;
+        return true;
+    }
+
+    std::string base_path = "./dataset/" + dataset_name + "/";
+    std::ifstream params(base_path + "oms_parameters");
+    size_t n_ref = 0;
+    size_t n_query = 0;
+    int n_id = 0;
+    if (!(params >> n_ref >> n_query >> n_id)) {
+        std::cerr << "Error reading file " << base_path << "oms_parameters" << std::endl;
+        return true;
+    }
+
+    auto load_start = std::chrono::steady_clock::now();
+    Spectra refs;
+    Spectra queries;
+    if (!refs.load(base_path + "ref.spectra", n_id, n_lv) || !queries.load(base_path + "query.spectra", n_id, n_lv)) {
+        return true;
+    }
+    if (refs.size() != n_ref || queries.size() != n_query) {
+        std::cerr << "Expected " << n_ref << " references and " << n_query << " queries, got " << refs.size()
+                  << " and " << queries.size() << std::endl;
+        return true;
+    }
+    std::chrono::duration<double> load_time = std::chrono::steady_clock::now() - load_start;
+    std::cout << "INFO: load time = " << load_time.count() << " s" << std::endl;
+    std::cout << "INFO: n_dim = " << n_dim << std::endl;
+    std::cout << "INFO: n_lv = " << n_lv << std::endl;
+    std::cout << "INFO: n_id = " << n_id << std::endl;
+    std::cout << "INFO: references = " << n_ref << ", queries = " << n_query << std::endl;
+    std::cout << "INFO: item method = " << (model_items.method == ItemMethod::CYCLIC ? "cyclic" : "random") << std::endl;
+    std::cout << "INFO: tolerance = " << oms.tol.value << (oms.tol.ppm ? " ppm" : " Da") << std::endl;
+
+    // The library is scored directly, so the model needs no class hypervector per reference
+    HDC hdc_model(1, n_lv, n_id, n_dim, binary, model_items);
+    auto encode_start = std::chrono::steady_clock::now();
+    BitHVs ref_enc = hdc_model.encode_sparse_binary(refs.view());
+    BitHVs query_enc = hdc_model.encode_sparse_binary(queries.view());
+    PrecursorIndex index;
+    if (!index.build(ref_enc, refs.pr_mzs)) {
+        return true;
+    }
+    std::chrono::duration<double> encode_time = std::chrono::steady_clock::now() - encode_start;
+    std::cout << "INFO: encode time = " << encode_time.count() << " s" << std::endl;
+
+    auto search_start = std::chrono::steady_clock::now();
+    HVMatrix<int> ids, dots;
+    size_t scored = index.search(query_enc, queries.pr_mzs, oms.tol, oms.top_k, ids, dots);
+    std::chrono::duration<double> search_time = std::chrono::steady_clock::now() - search_start;
+    size_t matched = 0;
+    for (size_t q = 0; q < n_query; ++q) {
+        matched += ids(q, 0) >= 0;
+    }
+    std::cout << "INFO: search time = " << search_time.count() << " s" << std::endl;
+    std::cout << "INFO: candidates per query = " << static_cast<double>(scored) / std::max<size_t>(n_query, 1)
+              << " of " << n_ref << std::endl;
+    std::cout << "Matched " << matched << " of " << n_query << " queries" << std::endl;
+
+    if (!oms.out_path.empty()) {
+        std::ofstream out(oms.out_path);
+        for (size_t q = 0; q < n_query; ++q) {
+            for (int j = 0; j < oms.top_k; ++j) {
+                out << ids(q, j) << ' ' << dots(q, j) << (j + 1 < oms.top_k ? ' ' : '\n');
+            }
+        }
+        if (!out) {
+            std::cerr << "Error writing file " << oms.out_path << std::endl;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Configuration of the genome mode.
+ */
+struct GenomeOptions {
+    std::string fasta_path; ///< Reference genome, or empty to skip the genome mode.
+    int k = 200; ///< Length of a k-mer (read length).
+    int n_dim = 8196; ///< Dimension of hypervectors.
+    size_t shard_kmers = 0; ///< K-mers per reference shard; 0 picks n_dim / 64.
+    double threshold = 0.8; ///< Fraction of n_dim a match must exceed.
+    int branching = 0; ///< Children per node of the bundle tree; 0 skips locating a read.
+    int beam = 4; ///< Tree nodes kept per level, and candidate intervals reported.
+    size_t read_length = 1000; ///< Bases of the read located in the tree.
+};
+
+/**
+ * @brief Builds sharded reference hypervectors from a genome and queries them, like hd_genome.py.
+ *
+ * Queries the first k-mer of the reference, then the same k-mer with up to three bases set to C.
+ * With a branching factor, also builds a bundle tree over the shards and locates the first
+ * read_length bases of the reference in it.
+ *
+ * @return false if the reference was built and queried successfully, true otherwise.
+ */
+bool genome_search(const GenomeOptions& genome) {
+    size_t shard_kmers = genome.shard_kmers ? genome.shard_kmers : std::max(1, genome.n_dim / 64);
+    std::cout << "INFO: k = " << genome.k << std::endl;
+    std::cout << "INFO: n_dim = " << genome.n_dim << std::endl;
+    std::cout << "INFO: shard k-mers = " << shard_kmers << std::endl;
+
+    GenomeHDC hd_db(genome.k, genome.n_dim);
+    auto encode_start = std::chrono::steady_clock::now();
+    if (!hd_db.add_fasta(genome.fasta_path, shard_kmers)) {
+        return true;
+    }
+    std::chrono::duration<double> encode_time = std::chrono::steady_clock::now() - encode_start;
+    std::cout << "INFO: records = " << hd_db.get_record_names().size() << ", shards = " << hd_db.get_n_ref()
+              << std::endl;
+    std::cout << "INFO: encode time = " << encode_time.count() << " s" << std::endl;
+
+    FastaReader reader;
+    std::string query;
+    int record;
+    if (!reader.open(genome.fasta_path) || !reader.next(query, genome.k, record) ||
+        query.size() != static_cast<size_t>(genome.k)) {
+        std::cerr << "The first record is shorter than k" << std::endl;
+        return true;
+    }
+    auto query_start = std::chrono::steady_clock::now();
+    std::pair<bool, long long> result = hd_db.query(query, genome.threshold);
+    std::cout << "If exist=" << result.first << ", sim=" << result.second << std::endl;
+
+    // Bases 5-7, or the last ones of shorter k-mers; the length must stay k
+    size_t n_changed = std::min<size_t>(3, query.size());
+    query.replace(std::min<size_t>(5, query.size() - n_changed), n_changed, n_changed, 'C');
+    result = hd_db.query(query, genome.threshold);
+    std::cout << "If exist=" << result.first << ", sim=" << result.second << std::endl;
+    std::chrono::duration<double, std::milli> query_time = std::chrono::steady_clock::now() - query_start;
+    std::cout << "INFO: query time = " << query_time.count() / 2 << " ms" << std::endl;
+
+    if (genome.branching > 0) {
+        auto build_start = std::chrono::steady_clock::now();
+        if (!hd_db.build_tree(genome.branching)) {
+            return true;
+        }
+        std::chrono::duration<double> build_time = std::chrono::steady_clock::now() - build_start;
+        std::cout << "INFO: tree depth = " << hd_db.tree_depth() << ", branching = " << genome.branching
+                  << ", build time = " << build_time.count() << " s" << std::endl;
+
+        FastaReader read_reader;
+        std::string read;
+        if (!read_reader.open(genome.fasta_path) || !read_reader.next(read, genome.read_length, record)) {
+            return true;
+        }
+        size_t checks = 0;
+        auto locate_start = std::chrono::steady_clock::now();
+        std::vector<GenomeHit> hits = hd_db.locate(read, genome.beam, &checks);
+        std::chrono::duration<double, std::milli> locate_time = std::chrono::steady_clock::now() - locate_start;
+        const std::vector<std::string>& names = hd_db.get_record_names();
+        for (const GenomeHit& hit : hits) {
+            std::cout << "Candidate " << names[hit.interval.record] << ":" << hit.interval.begin << "-"
+                      << hit.interval.end << ", sim=" << hit.dot << std::endl;
+        }
+        std::cout << "INFO: locate time = " << locate_time.count() << " ms, node scores = " << checks
+                  << " (linear scan: " << hd_db.get_n_ref() << ")" << std::endl;
+    }
+    return false;
+}
+
+/**
+ * @brief Prints the command-line usage.
+ */
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options] <dataset_name>" << std::endl;
+    std::cerr << "       " << prog << " [options] --serve <model> [--socket PATH]" << std::endl;
+    std::cerr << "       " << prog << " [options] --genome <fasta> [--kmer K]" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --threads N    Number of worker threads (default: $HDC_THREADS or all cores)" << std::endl;
+    std::cerr << "  --batch N      Re-train in parallel mini-batches of N samples (default: 0, serial)" << std::endl;
+    std::cerr << "  --hogwild      Re-train asynchronously with lock-free shared class updates" << std::endl;
+    std::cerr << "  --convert      Write ./dataset/<dataset_name>/dataset.bin from the text files and exit" << std::endl;
+    std::cerr << "  --stream       Stream chunks through overlapped load/encode/train stages instead of loading everything" << std::endl;
+    std::cerr << "  --mem-budget MB  Memory for in-flight chunks in --stream mode (default: 256)" << std::endl;
+    std::cerr << "  --spill PATH   In --stream mode, cache encodings in PATH.train/PATH.test for later epochs" << std::endl;
+    std::cerr << "  --no-cache     Neither reuse nor write cached encodings" << std::endl;
+    std::cerr << "  --cache-dir DIR  Directory of the encoding cache (default: ./dataset/<dataset_name>)" << std::endl;
+    std::cerr << "  --save-model PATH  Save the trained model to PATH" << std::endl;
+    std::cerr << "  --infer PATH   Score the test set with the model saved at PATH instead of training" << std::endl;
+    std::cerr << "  --serve PATH   Classify requests with the model saved at PATH; no dataset_name needed" << std::endl;
+    std::cerr << "  --socket PATH  With --serve, listen on a Unix socket instead of stdin/stdout" << std::endl;
+    std::cerr << "  --max-batch N  With --serve, classify at most N requests together (default: 64)" << std::endl;
+    std::cerr << "  --max-delay-us N  With --serve, close a micro-batch after N us (default: 1000)" << std::endl;
+    std::cerr << "  --stats-interval S  With --serve, print latency stats every S seconds (default: 10, 0: off)" << std::endl;
+    std::cerr << "  --oms          Search query.spectra against ref.spectra instead of training" << std::endl;
+    std::cerr << "  --tol T        With --oms, precursor tolerance such as 20ppm, 500da or inf (default: 20ppm)" << std::endl;
+    std::cerr << "  --top-k N      With --oms, matches per query (default: 1)" << std::endl;
+    std::cerr << "  --oms-out PATH With --oms, write \"<ref> <dot> ...\" per query to PATH" << std::endl;
+    std::cerr << "  --genome FASTA Build a k-mer reference from FASTA and query it; no dataset_name needed" << std::endl;
+    std::cerr << "  --kmer K       With --genome, k-mer length (default: 200)" << std::endl;
+    std::cerr << "  --genome-dim N With --genome, hypervector dimension (default: 8196)" << std::endl;
+    std::cerr << "  --shard-kmers N  With --genome, k-mers bundled per reference shard (default: dim / 64)" << std::endl;
+    std::cerr << "  --threshold F  With --genome, fraction of dim a match must exceed (default: 0.8)" << std::endl;
+    std::cerr << "  --branching N  With --genome, locate the first read in a bundle tree of N children per node" << std::endl;
+    std::cerr << "  --beam N       With --branching, tree nodes kept per level and candidates reported (default: 4)"
+              << std::endl;
+    std::cerr << "  --read-length N  With --branching, bases of the located read (default: 1000)" << std::endl;
+    std::cerr << "  --seed N       Seed of the ID and level item memories of new models (default: 0)" << std::endl;
+    std::cerr << "  --procedural-ids  Generate ID hypervectors inside the encoding kernel instead of storing them"
+              << std::endl;
+    std::cerr << "  --isa NAME     Force the encoding kernel: scalar, sse4.2, avx2, avx512 (default: $HDC_ISA or CPUID)" << std::endl;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <dataset_name>" << std::endl;
+    std::string dataset_name;
+    int n_threads = 0;
+    RetrainOptions retrain;
+    bool convert = false;
+    StreamOptions stream;
+    CacheOptions cache;
+    std::string save_path;
+    std::string infer_path;
+    std::string serve_path;
+    ServerOptions server;
+    OmsOptions oms;
+    GenomeOptions genome;
+    ItemMemoryOptions items;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--threads" && i + 1 < argc) {
+            n_threads = std::stoi(argv[++i]);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            retrain.batch_size = std::stoi(argv[++i]);
+        } else if (arg == "--convert") {
+            convert = true;
+        } else if (arg == "--hogwild") {
+            retrain.hogwild = true;
+        } else if (arg == "--stream") {
+            stream.enabled = true;
+        } else if (arg == "--mem-budget" && i + 1 < argc) {
+            stream.memory_budget = std::stoul(argv[++i]);
+        } else if (arg == "--spill" && i + 1 < argc) {
+            stream.spill_path = argv[++i];
+        } else if (arg == "--no-cache") {
+            cache.enabled = false;
+        } else if (arg == "--cache-dir" && i + 1 < argc) {
+            cache.dir = argv[++i];
+        } else if (arg == "--save-model" && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if (arg == "--infer" && i + 1 < argc) {
+            infer_path = argv[++i];
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serve_path = argv[++i];
+        } else if (arg == "--socket" && i + 1 < argc) {
+            server.socket_path = argv[++i];
+        } else if (arg == "--max-batch" && i + 1 < argc) {
+            server.max_batch = std::stoi(argv[++i]);
+        } else if (arg == "--max-delay-us" && i + 1 < argc) {
+            server.max_delay_us = std::stoi(argv[++i]);
+        } else if (arg == "--stats-interval" && i + 1 < argc) {
+            server.stats_interval = std::stod(argv[++i]);
+        } else if (arg == "--oms") {
+            oms.enabled = true;
+        } else if (arg == "--tol" && i + 1 < argc) {
+            std::string text(argv[++i]);
+            if (!MzTolerance::parse(text, oms.tol)) {
+                std::cerr << "Invalid tolerance " << text << std::endl;
+                return 1;
+            }
+        } else if (arg == "--top-k" && i + 1 < argc) {
+            oms.top_k = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--oms-out" && i + 1 < argc) {
+            oms.out_path = argv[++i];
+        } else if (arg == "--genome" && i + 1 < argc) {
+            genome.fasta_path = argv[++i];
+        } else if (arg == "--kmer" && i + 1 < argc) {
+            genome.k = std::stoi(argv[++i]);
+        } else if (arg == "--genome-dim" && i + 1 < argc) {
+            genome.n_dim = std::stoi(argv[++i]);
+        } else if (arg == "--shard-kmers" && i + 1 < argc) {
+            genome.shard_kmers = std::stoul(argv[++i]);
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            genome.threshold = std::stod(argv[++i]);
+        } else if (arg == "--branching" && i + 1 < argc) {
+            genome.branching = std::stoi(argv[++i]);
+        } else if (arg == "--beam" && i + 1 < argc) {
+            genome.beam = std::stoi(argv[++i]);
+        } else if (arg == "--read-length" && i + 1 < argc) {
+            genome.read_length = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            items.seed = std::stoull(argv[++i]);
+        } else if (arg == "--procedural-ids") {
+            items.procedural_ids = true;
+        } else if (arg == "--isa" && i + 1 < argc) {
+            SimdIsa isa;
+            std::string name(argv[++i]);
+            if (!parse_isa(name, isa)) {
+                std::cerr << "Unknown ISA " << name << std::endl;
+                return 1;
+            }
+            if (!set_isa(isa)) {
+                std::cerr << "ISA " << name << " is not supported by this CPU" << std::endl;
+                return 1;
+            }
+        } else if (!arg.empty() && arg[0] != '-' && dataset_name.empty()) {
+            dataset_name = arg;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!serve_path.empty()) {
+        // stdout may carry the answers, so progress goes to stderr
+        ThreadPool::set_global_threads(n_threads);
+        std::cerr << "INFO: threads = " << ThreadPool::global().size() << std::endl;
+        std::cerr << "INFO: encode ISA = " << isa_name(active_isa()) << std::endl;
+        std::unique_ptr<HDC> hdc_model = HDC::load(serve_path);
+        if (!hdc_model) {
+            std::cerr << "Failed to load the model" << std::endl;
+            return 1;
+        }
+        return serve(*hdc_model, server) ? 0 : 1;
+    }
+
+    if (!genome.fasta_path.empty()) {
+        ThreadPool::set_global_threads(n_threads);
+        std::cout << "INFO: threads = " << ThreadPool::global().size() << std::endl;
+        if (genome_search(genome)) {
+            std::cerr << "Test failed." << std::endl;
+            return 1;
+        }
+        std::cout << "Test passed." << std::endl;
+        return 0;
+    }
+
+    if (dataset_name.empty()) {
+        print_usage(argv[0]);
         return 1;
     }
 
-    std::string dataset_name(argv[1]);
-    bool result = train_test(dataset_name);
+    if (convert) {
+        return convert_dataset(dataset_name) ? 1 : 0;
+    }
+
+    ThreadPool::set_global_threads(n_threads);
+    std::cout << "INFO: threads = " << ThreadPool::global().size() << std::endl;
+    std::cout << "INFO: encode ISA = " << isa_name(active_isa()) << std::endl;
+
+    std::cout << "INFO: item seed = " << items.seed << (items.procedural_ids ? ", procedural IDs" : "") << std::endl;
+
+    bool result = oms.enabled           ? oms_search(dataset_name, oms, items)
+                  : infer_path.empty() ? train_test(dataset_name, retrain, stream, cache, save_path, items)
+                                       : infer(dataset_name, infer_path, stream);
 
     if (result) {
         std::cerr << "Test failed." << std::endl;
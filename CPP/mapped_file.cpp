@@ -0,0 +1,90 @@
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error opening file " << filename << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << "Error reading the size of " << filename << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        std::cerr << "Error mapping file " << filename << std::endl;
+        return false;
+    }
+
+    ptr = static_cast<const char*>(mem);
+    bytes = st.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (ptr != nullptr) {
+        munmap(const_cast<char*>(ptr), bytes);
+        ptr = nullptr;
+        bytes = 0;
+    }
+}
+
+AlignedFileWriter::~AlignedFileWriter() {
+    if (!tmp_filename.empty()) {
+        out.close();
+        std::remove(tmp_filename.c_str());
+    }
+}
+
+bool AlignedFileWriter::open(const std::string& filename) {
+    this->filename = filename;
+    tmp_filename = filename + ".tmp";
+    out.open(tmp_filename, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error opening file " << tmp_filename << std::endl;
+        tmp_filename.clear();
+        return false;
+    }
+    return true;
+}
+
+void AlignedFileWriter::write(const void* data, size_t bytes) {
+    out.write(static_cast<const char*>(data), bytes);
+}
+
+void AlignedFileWriter::pad_to(uint64_t offset) {
+    std::vector<char> zeros(offset - static_cast<uint64_t>(out.tellp()), 0);
+    out.write(zeros.data(), zeros.size());
+}
+
+bool AlignedFileWriter::commit() {
+    out.close();
+    if (!out || std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Error writing file " << filename << std::endl;
+        std::remove(tmp_filename.c_str());
+        tmp_filename.clear();
+        return false;
+    }
+    tmp_filename.clear();
+    return true;
+}
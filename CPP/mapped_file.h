@@ -0,0 +1,94 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/**
+ * @class MappedFile
+ * @brief A read-only memory mapping of a whole file.
+ *
+ * The mapping is private and read-only, so views into it stay valid for as long as the
+ * MappedFile is alive and pages are only loaded on first touch.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Maps a file, replacing any previous mapping.
+     *
+     * @param filename The name of the file to map.
+     * @return True if the file was mapped successfully, false otherwise.
+     */
+    bool open(const std::string& filename);
+
+    /**
+     * @brief Unmaps the file.
+     */
+    void close();
+
+    const char* data() const { return ptr; } ///< First byte of the file.
+    size_t size() const { return bytes; } ///< Size of the file in bytes.
+    bool is_open() const { return ptr != nullptr; } ///< Whether a file is mapped.
+
+private:
+    const char* ptr = nullptr; ///< Start of the mapping.
+    size_t bytes = 0; ///< Length of the mapping.
+};
+
+/**
+ * @class AlignedFileWriter
+ * @brief Writes a header and sections of rows at aligned offsets, replacing the file atomically.
+ *
+ * This is the writing side of the files MappedFile reads in place. The file is written
+ * under filename + ".tmp" and renamed over filename by commit(), so readers never map a
+ * partial file and a mapping of the previous file stays valid. A writer destroyed
+ * without commit() removes its temporary file.
+ */
+class AlignedFileWriter {
+public:
+    AlignedFileWriter() = default;
+    ~AlignedFileWriter();
+
+    AlignedFileWriter(const AlignedFileWriter&) = delete;
+    AlignedFileWriter& operator=(const AlignedFileWriter&) = delete;
+
+    /**
+     * @brief Starts writing filename.
+     *
+     * @param filename The name of the file to replace.
+     * @return True if the temporary file was created, false otherwise.
+     */
+    bool open(const std::string& filename);
+
+    /**
+     * @brief Appends bytes at the current offset.
+     */
+    void write(const void* data, size_t bytes);
+
+    /**
+     * @brief Zero-fills up to offset, the start of the next section (see align_to_row()).
+     */
+    void pad_to(uint64_t offset);
+
+    /**
+     * @brief Finishes the temporary file and renames it over filename.
+     *
+     * @return True if every write succeeded and the file was replaced, false otherwise.
+     */
+    bool commit();
+
+private:
+    std::string filename; ///< File to replace.
+    std::string tmp_filename; ///< File being written, empty once committed or removed.
+    std::ofstream out; ///< Stream of tmp_filename.
+};
+
+#endif // MAPPED_FILE_H
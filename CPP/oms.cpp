@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+#include "oms.h"
+#include "similarity.h"
+#include "thread_pool.h"
+
+namespace {
+
+const int QUERY_BLOCK = 64; ///< Queries whose windows are merged into one scan.
+const int REF_BLOCK = 64; ///< References scored per pass, so the block stays in L1/L2.
+
+} // namespace
+
+bool Spectra::load(const std::string& filename, int n_id, int n_lv) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file " << filename << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for (size_t line_no = 1; std::getline(file, line); ++line_no) {
+        const char* p = line.c_str();
+        char* end;
+        double mz = std::strtod(p, &end);
+        if (end == p) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            std::cerr << "Missing precursor m/z in " << filename << " line " << line_no << std::endl;
+            return false;
+        }
+        for (p = end; *p;) {
+            long id = std::strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            long level = *end == ':' ? std::strtol(end + 1, &end, 10) : -1;
+            if (id < 0 || id >= n_id || level < 0 || level >= n_lv) {
+                std::cerr << "Invalid peak in " << filename << " line " << line_no << std::endl;
+                return false;
+            }
+            ids.push_back(id);
+            levels.push_back(level);
+            p = end;
+        }
+        if (line.find_first_not_of(" \t\r", p - line.c_str()) != std::string::npos) {
+            std::cerr << "Malformed peak in " << filename << " line " << line_no << std::endl;
+            return false;
+        }
+        pr_mzs.push_back(mz);
+        offsets.push_back(ids.size());
+    }
+    return true;
+}
+
+bool MzTolerance::parse(const std::string& text, MzTolerance& tol) {
+    if (text == "inf") {
+        tol.value = std::numeric_limits<double>::infinity();
+        tol.ppm = false;
+        return true;
+    }
+    const char* begin = text.c_str();
+    char* end;
+    double value = std::strtod(begin, &end);
+    std::string unit(end);
+    if (end == begin || !(value >= 0) || (unit != "ppm" && unit != "da")) {
+        return false;
+    }
+    tol.value = value;
+    tol.ppm = unit == "ppm";
+    return true;
+}
+
+bool PrecursorIndex::build(const BitHVs& refs, const std::vector<double>& pr_mzs) {
+    if (refs.size() != pr_mzs.size()) {
+        std::cerr << "Got " << pr_mzs.size() << " precursor m/z for " << refs.size() << " references" << std::endl;
+        return false;
+    }
+    order.resize(refs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return pr_mzs[a] < pr_mzs[b]; });
+
+    mzs.resize(refs.size());
+    sorted = BitHVs(refs.size(), refs.dim());
+    ThreadPool::global().parallel_for(0, refs.size(), 0, [&](size_t begin, size_t end, int) {
+        for (size_t i = begin; i < end; ++i) {
+            mzs[i] = pr_mzs[order[i]];
+            std::copy(refs.row(order[i]), refs.row(order[i]) + refs.words(), sorted.row(i));
+        }
+    });
+    return true;
+}
+
+std::pair<size_t, size_t> PrecursorIndex::window(double mz, const MzTolerance& tol) const {
+    if (std::isinf(tol.value)) {
+        return {0, mzs.size()};
+    }
+    double width = tol.width(mz);
+    size_t first = std::lower_bound(mzs.begin(), mzs.end(), mz - width) - mzs.begin();
+    size_t last = std::upper_bound(mzs.begin(), mzs.end(), mz + width) - mzs.begin();
+    return {first, last};
+}
+
+size_t PrecursorIndex::search(const BitHVs& queries, const std::vector<double>& query_mzs, const MzTolerance& tol,
+                              int k, HVMatrix<int>& ids, HVMatrix<int>& dots) const {
+    ids = HVMatrix<int>(queries.size(), k);
+    dots = HVMatrix<int>(queries.size(), k);
+    if (query_mzs.size() != queries.size()) {
+        std::cerr << "Got " << query_mzs.size() << " precursor m/z for " << queries.size() << " queries" << std::endl;
+        return 0;
+    }
+    int n_words = sorted.words();
+    int n_dim = sorted.dim();
+
+    // Sorting the queries too makes the windows of a block overlap, so their union stays small
+    std::vector<int> query_order(queries.size());
+    std::iota(query_order.begin(), query_order.end(), 0);
+    std::stable_sort(query_order.begin(), query_order.end(),
+                     [&](int a, int b) { return query_mzs[a] < query_mzs[b]; });
+
+    size_t n_blocks = (queries.size() + QUERY_BLOCK - 1) / QUERY_BLOCK;
+    std::vector<size_t> scored(n_blocks, 0);
+    ThreadPool::global().parallel_for(0, n_blocks, 0, [&](size_t begin, size_t end, int) {
+        std::vector<TopK> best(QUERY_BLOCK, TopK(k));
+        std::pair<size_t, size_t> windows[QUERY_BLOCK];
+        for (size_t block = begin; block < end; ++block) {
+            size_t q0 = block * QUERY_BLOCK;
+            int mb = std::min<size_t>(QUERY_BLOCK, queries.size() - q0);
+            size_t lo = sorted.size();
+            size_t hi = 0;
+            for (int r = 0; r < mb; ++r) {
+                windows[r] = window(query_mzs[query_order[q0 + r]], tol);
+                best[r].clear();
+                if (windows[r].first < windows[r].second) {
+                    lo = std::min(lo, windows[r].first);
+                    hi = std::max(hi, windows[r].second);
+                }
+            }
+
+            for (size_t c0 = lo; c0 < hi; c0 += REF_BLOCK) {
+                size_t c1 = std::min<size_t>(c0 + REF_BLOCK, hi);
+                for (int r = 0; r < mb; ++r) {
+                    size_t first = std::max(c0, windows[r].first);
+                    size_t last = std::min(c1, windows[r].second);
+                    const uint64_t* x = queries.row(query_order[q0 + r]);
+                    for (size_t c = first; c < last; ++c) {
+                        best[r].push(bit_dot(x, sorted.row(c), n_words, n_dim), order[c]);
+                    }
+                }
+            }
+
+            for (int r = 0; r < mb; ++r) {
+                int q = query_order[q0 + r];
+                best[r].write(ids.row(q), dots.row(q));
+                scored[block] += windows[r].second - windows[r].first;
+            }
+        }
+    });
+    return std::accumulate(scored.begin(), scored.end(), size_t(0));
+}
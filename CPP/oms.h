@@ -0,0 +1,122 @@
+#ifndef OMS_H
+#define OMS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bithv.h"
+#include "csr.h"
+#include "hv_matrix.h"
+
+/**
+ * @brief Mass spectra with their precursor m/z, stored in CSR form.
+ */
+struct Spectra {
+    std::vector<double> pr_mzs; ///< Precursor m/z of every spectrum.
+    std::vector<int64_t> offsets{0}; ///< Peak offsets of every spectrum, plus the end.
+    std::vector<int> ids; ///< Feature (m/z bin) index of every peak.
+    std::vector<int> levels; ///< Quantized intensity of every peak.
+
+    size_t size() const { return pr_mzs.size(); } ///< Number of spectra.
+
+    /**
+     * @brief Returns a CSR view of the peaks for HDC::encode_sparse_binary().
+     */
+    CSRView view() const { return CSRView(offsets.data(), ids.data(), levels.data(), size()); }
+
+    /**
+     * @brief Reads a spectra file written by utils.save_oms_dataset().
+     *
+     * Every line is "<pr_mz> <idx>:<level> ...". Peaks are checked against n_id and n_lv so
+     * they can be encoded without further bounds checks.
+     *
+     * @param filename The name of the spectra file.
+     * @param n_id Number of feature indices.
+     * @param n_lv Number of levels.
+     * @return True if the file was read successfully, false otherwise.
+     */
+    bool load(const std::string& filename, int n_id, int n_lv);
+};
+
+/**
+ * @brief Precursor m/z tolerance of a search.
+ *
+ * A reference is a candidate for a query when |ref_mz - query_mz| <= value, with value in
+ * Dalton, or in parts per million of the query m/z when ppm is set. A narrow window (e.g.
+ * 20 ppm) restricts the search to unmodified peptides, an open window (e.g. 500 Da)
+ * admits modifications; an infinite value searches the whole library.
+ */
+struct MzTolerance {
+    double value = 20.0; ///< Half-width of the window.
+    bool ppm = true; ///< Whether value is in ppm of the query m/z rather than in Dalton.
+
+    /**
+     * @brief Returns the half-width of the window around mz in Dalton.
+     */
+    double width(double mz) const { return ppm ? mz * value * 1e-6 : value; }
+
+    /**
+     * @brief Parses "20ppm", "500da" or "inf".
+     *
+     * @return True if text is a valid tolerance, false otherwise.
+     */
+    static bool parse(const std::string& text, MzTolerance& tol);
+};
+
+/**
+ * @class PrecursorIndex
+ * @brief Reference hypervectors sorted by precursor m/z for windowed library search.
+ *
+ * The references are copied in m/z order, so the candidates of any query are one
+ * contiguous block of rows found by binary search, and neighbouring queries share most
+ * of their block.
+ */
+class PrecursorIndex {
+public:
+    /**
+     * @brief Sorts the references by precursor m/z.
+     *
+     * @param refs Bit-packed reference encodings.
+     * @param pr_mzs Precursor m/z of every reference.
+     * @return True if the index was built, false if the sizes differ.
+     */
+    bool build(const BitHVs& refs, const std::vector<double>& pr_mzs);
+
+    /**
+     * @brief Returns the sorted rows [first, second) whose m/z is within tol of mz.
+     */
+    std::pair<size_t, size_t> window(double mz, const MzTolerance& tol) const;
+
+    /**
+     * @brief Finds the k most similar references within the precursor window of every query.
+     *
+     * Queries are processed in m/z order in blocks whose windows are merged into one
+     * contiguous range of references; the range is scanned in cache-sized reference blocks
+     * and every query of the block only scores the rows inside its own window. Blocks are
+     * split across the global thread pool. Within a window the results equal those of
+     * topk_classes(), including the tie-breaking by reference index.
+     *
+     * @param queries Bit-packed query encodings of the reference dimension.
+     * @param query_mzs Precursor m/z of every query.
+     * @param tol Precursor tolerance.
+     * @param k Number of matches per query.
+     * @param ids Output queries.size() x k original reference indices, best first; -1 where
+     *            the window holds fewer than k references.
+     * @param dots Output queries.size() x k bipolar dot products matching ids.
+     * @return Total number of query-reference pairs scored.
+     */
+    size_t search(const BitHVs& queries, const std::vector<double>& query_mzs, const MzTolerance& tol, int k,
+                  HVMatrix<int>& ids, HVMatrix<int>& dots) const;
+
+    size_t size() const { return mzs.size(); } ///< Number of indexed references.
+
+private:
+    std::vector<double> mzs; ///< Precursor m/z in ascending order.
+    std::vector<int> order; ///< Original index of every sorted row.
+    BitHVs sorted; ///< Reference encodings in m/z order.
+};
+
+#endif // OMS_H
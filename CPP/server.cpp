@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "dataset.h"
+#include "server.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<bool> stop_requested(false);
+
+void request_stop(int) {
+    stop_requested = true;
+}
+
+double seconds_now() {
+    return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief One client. Answers are written to out_fd in the order its requests arrived.
+ *
+ * Only the thread that processes micro-batches touches the outbox, so a client that
+ * stops reading fills its own outbox instead of blocking that thread and every other client.
+ */
+struct Connection {
+    static constexpr size_t MAX_OUTBOX = 1 << 20; ///< Bytes of unread answers after which a client is dropped.
+
+    int in_fd; ///< Descriptor requests are read from.
+    int out_fd; ///< Descriptor answers are written to.
+    bool owns_fd; ///< Whether in_fd is a socket to close with the connection.
+    std::string outbox; ///< Answers the client has not accepted yet.
+    bool dropped = false; ///< Set once the client went away or was disconnected.
+
+    Connection(int in_fd, int out_fd, bool owns_fd) : in_fd(in_fd), out_fd(out_fd), owns_fd(owns_fd) {}
+
+    ~Connection() {
+        if (owns_fd) {
+            ::close(in_fd);
+        }
+    }
+
+    /**
+     * @brief Queues text and writes as much of the outbox as the client accepts.
+     *
+     * @return Whether answers are left in the outbox for flush().
+     */
+    bool send(const std::string& text) {
+        if (dropped) {
+            return false;
+        }
+        outbox += text;
+        return flush();
+    }
+
+    /**
+     * @brief Writes the outbox until the client stops accepting it.
+     *
+     * Sockets are written with MSG_DONTWAIT, so this never blocks on them. A client whose
+     * outbox grows past MAX_OUTBOX is disconnected, which also ends its reader. stdout, the
+     * only client of its server, is written blocking.
+     *
+     * @return Whether answers are left in the outbox.
+     */
+    bool flush() {
+        size_t written = 0;
+        while (written < outbox.size()) {
+            const char* p = outbox.data() + written;
+            size_t left = outbox.size() - written;
+            ssize_t n = owns_fd ? ::send(out_fd, p, left, MSG_DONTWAIT | MSG_NOSIGNAL) : ::write(out_fd, p, left);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (n <= 0) {
+                // The client has gone away
+                drop();
+                return false;
+            }
+            written += n;
+        }
+        outbox.erase(0, written);
+        if (outbox.size() > MAX_OUTBOX) {
+            std::cerr << "WARNING: disconnecting a client with " << outbox.size() << " bytes of unread answers"
+                      << std::endl;
+            drop();
+            return false;
+        }
+        return !outbox.empty();
+    }
+
+    /**
+     * @brief Discards the outbox and disconnects the client; its pending requests are still processed.
+     */
+    void drop() {
+        dropped = true;
+        outbox.clear();
+        if (owns_fd) {
+            ::shutdown(in_fd, SHUT_RDWR);
+        }
+    }
+};
+
+enum class RequestKind { Classify, Stats, Error };
+
+struct Request {
+    std::shared_ptr<Connection> conn; ///< Client to answer.
+    RequestKind kind; ///< What to answer.
+    std::vector<int> levels; ///< Level indices of the sample, for Classify.
+    std::string error; ///< Reason, for Error.
+    Clock::time_point arrival; ///< When the request was read.
+};
+
+/**
+ * @brief Requests of all clients in arrival order, handed out as micro-batches.
+ *
+ * push() blocks while capacity requests are pending, which pushes back on clients
+ * through their socket buffers instead of queueing without bound.
+ */
+class RequestQueue {
+public:
+    explicit RequestQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(Request request) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed) {
+            return;
+        }
+        items.push_back(std::move(request));
+        ready.notify_one();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        ready.notify_all();
+        not_full.notify_all();
+    }
+
+    /**
+     * @brief Takes the next micro-batch.
+     *
+     * Waits up to poll for a first request, then until max_batch requests are pending or
+     * the first one has waited max_delay.
+     *
+     * @param batch Output requests; empty if poll expired first.
+     * @return False once the queue is closed and drained.
+     */
+    bool pop_batch(size_t max_batch, Clock::duration max_delay, Clock::duration poll, std::vector<Request>& batch) {
+        batch.clear();
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!ready.wait_for(lock, poll, [&] { return closed || !items.empty(); })) {
+            return true;
+        }
+        if (items.empty()) {
+            return false;
+        }
+        ready.wait_until(lock, items.front().arrival + max_delay,
+                         [&] { return closed || items.size() >= max_batch; });
+
+        size_t n = std::min(max_batch, items.size());
+        for (size_t i = 0; i < n; ++i) {
+            batch.push_back(std::move(items.front()));
+            items.pop_front();
+        }
+        not_full.notify_all();
+        return true;
+    }
+
+private:
+    size_t capacity; ///< Most pending requests.
+    std::deque<Request> items; ///< Pending requests, oldest first.
+    bool closed = false; ///< Set by close().
+    std::mutex mutex; ///< Guards items and closed.
+    std::condition_variable ready; ///< Signals pop_batch() that requests or close() arrived.
+    std::condition_variable not_full; ///< Signals push() that a batch was taken or close() arrived.
+};
+
+/**
+ * @brief Turns one request line into a Request.
+ */
+Request parse_request(const std::shared_ptr<Connection>& conn, const char* begin, const char* end, int n_id,
+                      int n_lv) {
+    Request request;
+    request.conn = conn;
+    request.arrival = Clock::now();
+    request.kind = RequestKind::Classify;
+
+    while (begin != end && is_blank(*begin)) {
+        ++begin;
+    }
+    while (end != begin && is_blank(end[-1])) {
+        --end;
+    }
+    if (std::string(begin, end) == "stats") {
+        request.kind = RequestKind::Stats;
+        return request;
+    }
+
+    request.levels.resize(n_id);
+    int count = parse_int_line(begin, end, request.levels.data(), n_id);
+    if (count != n_id) {
+        request.kind = RequestKind::Error;
+        request.error = "expected " + std::to_string(n_id) + " integer levels";
+    } else if (std::any_of(request.levels.begin(), request.levels.end(),
+                           [&](int v) { return v < 0 || v >= n_lv; })) {
+        request.kind = RequestKind::Error;
+        request.error = "levels must be in [0, " + std::to_string(n_lv) + ")";
+    }
+    return request;
+}
+
+/**
+ * @brief Reads request lines from a connection until end of input.
+ */
+void read_requests(const std::shared_ptr<Connection>& conn, int n_id, int n_lv, RequestQueue& queue) {
+    std::string pending;
+    std::vector<char> buffer(1 << 16);
+    while (true) {
+        ssize_t got = ::read(conn->in_fd, buffer.data(), buffer.size());
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        pending.append(buffer.data(), got);
+
+        size_t start = 0;
+        size_t newline;
+        while ((newline = pending.find('\n', start)) != std::string::npos) {
+            const char* line = pending.data() + start;
+            if (!is_blank_line(line, pending.data() + newline)) {
+                queue.push(parse_request(conn, line, pending.data() + newline, n_id, n_lv));
+            }
+            start = newline + 1;
+        }
+        pending.erase(0, start);
+    }
+    if (!is_blank_line(pending.data(), pending.data() + pending.size())) {
+        queue.push(parse_request(conn, pending.data(), pending.data() + pending.size(), n_id, n_lv));
+    }
+}
+
+/**
+ * @brief Classifies one micro-batch and answers every request of it.
+ *
+ * Latencies run from arrival until the answers are formatted, and are recorded before
+ * "stats" requests are answered, so their reports include the batch they arrived in.
+ *
+ * @param backlog Connections with answers left in their outbox; ones this batch leaves
+ *                unsent are added.
+ */
+void process_batch(HDC& model, std::vector<Request>& batch, LatencyStats& stats,
+                   std::vector<std::shared_ptr<Connection>>& backlog) {
+    size_t n = std::count_if(batch.begin(), batch.end(),
+                             [](const Request& r) { return r.kind == RequestKind::Classify; });
+    HVMatrix<int> levels(n, model.get_n_id());
+    size_t row = 0;
+    for (const Request& request : batch) {
+        if (request.kind == RequestKind::Classify) {
+            std::copy(request.levels.begin(), request.levels.end(), levels.row(row++));
+        }
+    }
+
+    HVMatrix<double> scores;
+    std::vector<int> pred;
+    if (n > 0) {
+        if (model.is_binary()) {
+            pred = model.predict(model.encode_binary(levels.view()), scores);
+        } else {
+            pred = model.predict(model.encode(levels.view()), scores);
+        }
+        stats.record_batch();
+    }
+
+    std::vector<std::string> answers(batch.size());
+    row = 0;
+    char number[32];
+    for (size_t k = 0; k < batch.size(); ++k) {
+        if (batch[k].kind == RequestKind::Classify) {
+            answers[k] = std::to_string(pred[row]);
+            for (int c = 0; c < model.get_n_class(); ++c) {
+                std::snprintf(number, sizeof(number), " %.6g", scores(row, c));
+                answers[k] += number;
+            }
+            ++row;
+        } else if (batch[k].kind == RequestKind::Error) {
+            answers[k] = "error " + batch[k].error;
+        }
+    }
+
+    Clock::time_point done = Clock::now();
+    for (const Request& request : batch) {
+        if (request.kind == RequestKind::Classify) {
+            stats.record(std::chrono::duration<double, std::micro>(done - request.arrival).count());
+        }
+    }
+
+    // Answers are gathered per client so each gets one write per batch, in request order
+    std::vector<std::pair<std::shared_ptr<Connection>, std::string>> replies;
+    for (size_t k = 0; k < batch.size(); ++k) {
+        const Request& request = batch[k];
+        auto reply = std::find_if(replies.begin(), replies.end(),
+                                  [&](const auto& r) { return r.first == request.conn; });
+        if (reply == replies.end()) {
+            replies.emplace_back(request.conn, std::string());
+            reply = replies.end() - 1;
+        }
+        reply->second += request.kind == RequestKind::Stats ? stats.report() : answers[k];
+        reply->second += '\n';
+    }
+    for (const auto& reply : replies) {
+        if (reply.first->send(reply.second) &&
+            std::find(backlog.begin(), backlog.end(), reply.first) == backlog.end()) {
+            backlog.push_back(reply.first);
+        }
+    }
+}
+
+/**
+ * @brief Creates a listening Unix-domain socket, replacing a stale socket file.
+ *
+ * @return The socket, or -1 on error.
+ */
+int listen_unix(const std::string& path) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path " << path << " is too long" << std::endl;
+        return -1;
+    }
+    std::strcpy(addr.sun_path, path.c_str());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "Error creating socket: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+        std::cerr << "Error listening on " << path << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Accepts clients until a stop is requested, then disconnects them.
+ */
+void accept_clients(int listen_fd, int n_id, int n_lv, RequestQueue& queue) {
+    struct Client {
+        std::thread reader; ///< Runs read_requests().
+        std::shared_ptr<Connection> conn; ///< The client's connection.
+        std::shared_ptr<std::atomic<bool>> done; ///< Set when the client disconnected.
+    };
+    std::vector<Client> clients;
+
+    while (!stop_requested) {
+        pollfd pfd = {listen_fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        // Reap clients that already disconnected
+        for (auto it = clients.begin(); it != clients.end();) {
+            if (*it->done) {
+                it->reader.join();
+                it = clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        Client client;
+        client.conn = std::make_shared<Connection>(fd, fd, true);
+        client.done = std::make_shared<std::atomic<bool>>(false);
+        client.reader = std::thread([conn = client.conn, done = client.done, n_id, n_lv, &queue] {
+            read_requests(conn, n_id, n_lv, queue);
+            *done = true;
+        });
+        clients.push_back(std::move(client));
+    }
+
+    for (Client& client : clients) {
+        ::shutdown(client.conn->in_fd, SHUT_RD);
+        client.reader.join();
+    }
+}
+
+} // namespace
+
+LatencyStats::LatencyStats() : start_s(seconds_now()) {
+    window.reserve(WINDOW);
+}
+
+void LatencyStats::record(double latency_us) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (window.size() < WINDOW) {
+        window.push_back(latency_us);
+    } else {
+        window[n_requests % WINDOW] = latency_us;
+    }
+    ++n_requests;
+}
+
+void LatencyStats::record_batch() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++n_batches;
+}
+
+double LatencyStats::percentile(double p) const {
+    std::vector<double> sorted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sorted = window;
+    }
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t k = std::min(sorted.size() - 1, static_cast<size_t>(p / 100.0 * sorted.size()));
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+std::string LatencyStats::report() const {
+    size_t requests;
+    size_t batches;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests = n_requests;
+        batches = n_batches;
+    }
+    double elapsed = seconds_now() - start_s;
+    std::ostringstream out;
+    out << "requests=" << requests << " batches=" << batches
+        << " avg_batch=" << (batches ? static_cast<double>(requests) / batches : 0.0)
+        << " p50_us=" << percentile(50) << " p99_us=" << percentile(99)
+        << " throughput=" << requests / std::max(elapsed, 1e-9) << "/s";
+    return out.str();
+}
+
+bool serve(HDC& model, const ServerOptions& options) {
+    std::signal(SIGPIPE, SIG_IGN);
+
+    RequestQueue queue(64 * static_cast<size_t>(std::max(1, options.max_batch)));
+    LatencyStats stats;
+    std::thread frontend;
+    int listen_fd = -1;
+
+    if (options.socket_path.empty()) {
+        auto conn = std::make_shared<Connection>(STDIN_FILENO, STDOUT_FILENO, false);
+        frontend = std::thread([&, conn] {
+            read_requests(conn, model.get_n_id(), model.get_n_lv(), queue);
+            queue.close();
+        });
+    } else {
+        listen_fd = listen_unix(options.socket_path);
+        if (listen_fd < 0) {
+            return false;
+        }
+        stop_requested = false;
+        std::signal(SIGINT, request_stop);
+        std::signal(SIGTERM, request_stop);
+        frontend = std::thread([&] {
+            accept_clients(listen_fd, model.get_n_id(), model.get_n_lv(), queue);
+            queue.close();
+        });
+        std::cerr << "INFO: listening on " << options.socket_path << std::endl;
+    }
+
+    // Micro-batches are formed and classified on this thread; encode and predict fan out to the pool
+    std::vector<Request> batch;
+    std::vector<std::shared_ptr<Connection>> backlog;
+    auto max_delay = std::chrono::microseconds(std::max(0, options.max_delay_us));
+    auto last_report = Clock::now();
+    while (queue.pop_batch(std::max(1, options.max_batch), max_delay,
+                           std::chrono::milliseconds(backlog.empty() ? 100 : 1), batch)) {
+        if (!batch.empty()) {
+            process_batch(model, batch, stats, backlog);
+        }
+        // Outboxes that clients could not take yet are retried between batches, polling every millisecond
+        backlog.erase(std::remove_if(backlog.begin(), backlog.end(),
+                                     [](const std::shared_ptr<Connection>& conn) { return !conn->flush(); }),
+                      backlog.end());
+        if (options.stats_interval > 0 &&
+            std::chrono::duration<double>(Clock::now() - last_report).count() >= options.stats_interval) {
+            std::cerr << "STATS: " << stats.report() << std::endl;
+            last_report = Clock::now();
+        }
+    }
+
+    frontend.join();
+    if (listen_fd >= 0) {
+        ::close(listen_fd);
+        ::unlink(options.socket_path.c_str());
+    }
+    std::cerr << "STATS: " << stats.report() << std::endl;
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "hdc.h"
+
+/**
+ * @brief Configuration of serve().
+ */
+struct ServerOptions {
+    std::string socket_path; ///< Unix-domain socket to listen on, or empty to serve stdin/stdout.
+    int max_batch = 64; ///< Most requests classified together.
+    int max_delay_us = 1000; ///< Longest a request waits for its micro-batch to fill.
+    double stats_interval = 10.0; ///< Seconds between STATS lines on stderr; 0 disables them.
+};
+
+/**
+ * @class LatencyStats
+ * @brief Thread-safe request latency and throughput counters.
+ *
+ * Percentiles are computed over the most recent WINDOW latencies, so they follow the
+ * current load; the request count and throughput cover the whole run.
+ */
+class LatencyStats {
+public:
+    static constexpr size_t WINDOW = 1 << 16; ///< Latencies kept for the percentiles.
+
+    LatencyStats();
+
+    /**
+     * @brief Records one completed request.
+     *
+     * @param latency_us Time from arrival to response, in microseconds.
+     */
+    void record(double latency_us);
+
+    /**
+     * @brief Records one processed micro-batch.
+     */
+    void record_batch();
+
+    /**
+     * @brief Returns the p-th percentile (0..100) of the recent latencies, in microseconds.
+     */
+    double percentile(double p) const;
+
+    /**
+     * @brief Formats requests, batches, mean batch size, p50/p99 latency and throughput.
+     */
+    std::string report() const;
+
+private:
+    mutable std::mutex mutex; ///< Guards every member below.
+    std::vector<double> window; ///< Ring of recent latencies.
+    size_t n_requests = 0; ///< Requests recorded so far.
+    size_t n_batches = 0; ///< Micro-batches recorded so far.
+    double start_s; ///< Time of construction, in seconds of steady_clock.
+};
+
+/**
+ * @brief Serves classification requests with a trained model until shutdown.
+ *
+ * Every request is one line of n_id whitespace-separated level indices, as in test.val,
+ * and is answered in order with a line "<label> <score_0> ... <score_{n_class-1}>" (see
+ * HDC::predict()). The line "stats" is answered with LatencyStats::report(), and malformed
+ * lines with "error <reason>".
+ *
+ * Requests from all clients are coalesced into micro-batches of at most max_batch
+ * requests, closed once the oldest request has waited max_delay_us, and each batch is
+ * encoded and scored on the global thread pool. With an empty socket_path the server
+ * reads stdin and answers on stdout until end of input; otherwise it accepts any number of
+ * clients on the socket until SIGINT or SIGTERM. Answers to a socket are never written
+ * blocking: a client that stops reading has them buffered, and is disconnected once more
+ * than a megabyte is waiting, so it cannot stall the others.
+ *
+ * @param model Trained model.
+ * @param options Server configuration.
+ * @return True if the server shut down cleanly, false if it could not start.
+ */
+bool serve(HDC& model, const ServerOptions& options);
+
+#endif // SERVER_H
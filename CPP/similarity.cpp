@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "encode_kernels.h"
+#include "similarity.h"
+#include "thread_pool.h"
+
+namespace {
+
+const int TILE = 4; ///< Samples and classes per register tile.
+const int SAMPLE_BLOCK = 64; ///< Samples whose running argmax is kept per pass.
+const int CLASS_BLOCK = 64; ///< Classes scored per pass.
+const int DIM_BLOCK = 512; ///< Dimensions per pass, so a class tile stays in L1.
+
+/**
+ * @brief Accumulates a TILE x TILE block of dot products over k dimensions.
+ *
+ * out[r * out_stride + c] += sum_d x[r * x_stride + d] * w[c * w_stride + d].
+ */
+using DotTileFn = void (*)(const int* x, size_t x_stride, const double* w, size_t w_stride, int k, double* out,
+                           size_t out_stride);
+
+/**
+ * @brief Portable mr x nr block, also used for the partial tiles at the block edges.
+ */
+void dot_block(const int* x, size_t x_stride, int mr, const double* w, size_t w_stride, int nr, int k, double* out,
+               size_t out_stride) {
+    for (int r = 0; r < mr; ++r) {
+        const int* xr = x + r * x_stride;
+        for (int c = 0; c < nr; ++c) {
+            const double* wc = w + c * w_stride;
+            double acc = 0.0;
+            for (int d = 0; d < k; ++d) {
+                acc += xr[d] * wc[d];
+            }
+            out[r * out_stride + c] += acc;
+        }
+    }
+}
+
+void dot_tile_scalar(const int* x, size_t x_stride, const double* w, size_t w_stride, int k, double* out,
+                     size_t out_stride) {
+    dot_block(x, x_stride, TILE, w, w_stride, TILE, k, out, out_stride);
+}
+
+/**
+ * @brief AVX2 tile: two passes of 2 samples x 4 classes, four dimensions per vector.
+ */
+__attribute__((target("avx2")))
+void dot_tile_avx2(const int* x, size_t x_stride, const double* w, size_t w_stride, int k, double* out,
+                   size_t out_stride) {
+    int k4 = k / 4 * 4;
+    for (int r0 = 0; r0 < TILE; r0 += 2) {
+        __m256d acc[2][TILE];
+        for (int r = 0; r < 2; ++r) {
+            for (int c = 0; c < TILE; ++c) {
+                acc[r][c] = _mm256_setzero_pd();
+            }
+        }
+        for (int d = 0; d < k4; d += 4) {
+            __m256d xv[2];
+            for (int r = 0; r < 2; ++r) {
+                xv[r] = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + (r0 + r) * x_stride + d)));
+            }
+            for (int c = 0; c < TILE; ++c) {
+                __m256d wv = _mm256_loadu_pd(w + c * w_stride + d);
+                acc[0][c] = _mm256_add_pd(acc[0][c], _mm256_mul_pd(xv[0], wv));
+                acc[1][c] = _mm256_add_pd(acc[1][c], _mm256_mul_pd(xv[1], wv));
+            }
+        }
+        for (int r = 0; r < 2; ++r) {
+            for (int c = 0; c < TILE; ++c) {
+                alignas(32) double lanes[4];
+                _mm256_store_pd(lanes, acc[r][c]);
+                out[(r0 + r) * out_stride + c] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+            }
+        }
+    }
+    if (k4 < k) {
+        dot_block(x + k4, x_stride, TILE, w + k4, w_stride, TILE, k - k4, out, out_stride);
+    }
+}
+
+// GCC 12 flags the _mm512_undefined_* placeholders inside its own AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+/**
+ * @brief AVX-512 tile: 4 samples x 4 classes in one pass, eight dimensions per vector.
+ */
+__attribute__((target("avx512f")))
+void dot_tile_avx512(const int* x, size_t x_stride, const double* w, size_t w_stride, int k, double* out,
+                     size_t out_stride) {
+    int k8 = k / 8 * 8;
+    __m512d acc[TILE][TILE];
+    for (int r = 0; r < TILE; ++r) {
+        for (int c = 0; c < TILE; ++c) {
+            acc[r][c] = _mm512_setzero_pd();
+        }
+    }
+    for (int d = 0; d < k8; d += 8) {
+        __m512d xv[TILE];
+        for (int r = 0; r < TILE; ++r) {
+            xv[r] = _mm512_cvtepi32_pd(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + r * x_stride + d)));
+        }
+        for (int c = 0; c < TILE; ++c) {
+            __m512d wv = _mm512_loadu_pd(w + c * w_stride + d);
+            for (int r = 0; r < TILE; ++r) {
+                acc[r][c] = _mm512_add_pd(acc[r][c], _mm512_mul_pd(xv[r], wv));
+            }
+        }
+    }
+    for (int r = 0; r < TILE; ++r) {
+        for (int c = 0; c < TILE; ++c) {
+            out[r * out_stride + c] += _mm512_reduce_add_pd(acc[r][c]);
+        }
+    }
+    if (k8 < k) {
+        dot_block(x + k8, x_stride, TILE, w + k8, w_stride, TILE, k - k8, out, out_stride);
+    }
+}
+
+#pragma GCC diagnostic pop
+
+DotTileFn dot_tile_for(SimdIsa isa) {
+    switch (isa) {
+    case SimdIsa::AVX512:
+        return dot_tile_avx512;
+    case SimdIsa::AVX2:
+        return dot_tile_avx2;
+    default:
+        return dot_tile_scalar;
+    }
+}
+
+/**
+ * @brief Tracks the running argmax of a block of samples across class blocks.
+ *
+ * Only strictly greater scores replace the current best, so ties keep the lowest class.
+ */
+template <typename Score>
+struct RunningArgmax {
+    Score best[SAMPLE_BLOCK];
+    int* pred;
+
+    void update(int r, int c, Score score) {
+        if (c == 0 || best[r] < score) {
+            best[r] = score;
+            pred[r] = c;
+        }
+    }
+};
+
+} // namespace
+
+void argmax_classes(HVView<const int> inp, const ClassMatrix& classes, int* pred) {
+    int n_class = classes.hvs.rows();
+    int n_dim = classes.hvs.cols();
+    DotTileFn dot_tile = dot_tile_for(active_isa());
+
+    ThreadPool::global().parallel_for(0, inp.rows(), 0, [&](size_t begin, size_t end, int) {
+        std::vector<double> dots(SAMPLE_BLOCK * CLASS_BLOCK);
+        for (size_t i0 = begin; i0 < end; i0 += SAMPLE_BLOCK) {
+            int mb = std::min<size_t>(SAMPLE_BLOCK, end - i0);
+            RunningArgmax<double> argmax;
+            argmax.pred = pred + i0;
+
+            for (int c0 = 0; c0 < n_class; c0 += CLASS_BLOCK) {
+                int nb = std::min(CLASS_BLOCK, n_class - c0);
+                std::fill(dots.begin(), dots.end(), 0.0);
+
+                for (int k0 = 0; k0 < n_dim; k0 += DIM_BLOCK) {
+                    int kc = std::min(DIM_BLOCK, n_dim - k0);
+                    for (int r = 0; r < mb; r += TILE) {
+                        const int* x = inp.row(i0 + r) + k0;
+                        int mr = std::min(TILE, mb - r);
+                        for (int c = 0; c < nb; c += TILE) {
+                            const double* w = classes.hvs.row(c0 + c) + k0;
+                            int nr = std::min(TILE, nb - c);
+                            double* out = &dots[r * CLASS_BLOCK + c];
+                            if (mr == TILE && nr == TILE) {
+                                dot_tile(x, inp.stride(), w, classes.hvs.stride(), kc, out, CLASS_BLOCK);
+                            } else {
+                                dot_block(x, inp.stride(), mr, w, classes.hvs.stride(), nr, kc, out, CLASS_BLOCK);
+                            }
+                        }
+                    }
+                }
+
+                for (int r = 0; r < mb; ++r) {
+                    for (int c = 0; c < nb; ++c) {
+                        argmax.update(r, c0 + c, dots[r * CLASS_BLOCK + c] / classes.norms[c0 + c]);
+                    }
+                }
+            }
+        }
+    });
+}
+
+void argmax_classes(const BitHVs& inp, const BitHVs& classes, int* pred) {
+    argmax_classes(inp.view(), classes, pred);
+}
+
+void argmax_classes(HVView<const uint64_t> inp, const BitHVs& classes, int* pred) {
+    int n_class = classes.size();
+    int n_words = classes.words();
+    int n_dim = classes.dim();
+
+    ThreadPool::global().parallel_for(0, inp.rows(), 0, [&](size_t begin, size_t end, int) {
+        for (size_t i0 = begin; i0 < end; i0 += SAMPLE_BLOCK) {
+            int mb = std::min<size_t>(SAMPLE_BLOCK, end - i0);
+            RunningArgmax<int> argmax;
+            argmax.pred = pred + i0;
+
+            // A block of packed classes is reused by every sample of the block while cached
+            for (int c0 = 0; c0 < n_class; c0 += CLASS_BLOCK) {
+                int nb = std::min(CLASS_BLOCK, n_class - c0);
+                for (int r = 0; r < mb; ++r) {
+                    const uint64_t* x = inp.row(i0 + r);
+                    for (int c = c0; c < c0 + nb; ++c) {
+                        argmax.update(r, c, bit_dot(x, classes.row(c), n_words, n_dim));
+                    }
+                }
+            }
+        }
+    });
+}
+
+void topk_classes(const BitHVs& queries, const BitHVs& refs, int k, HVMatrix<int>& ids, HVMatrix<int>& dots) {
+    int n_ref = refs.size();
+    int n_words = refs.words();
+    int n_dim = refs.dim();
+    ids = HVMatrix<int>(queries.size(), k);
+    dots = HVMatrix<int>(queries.size(), k);
+
+    ThreadPool::global().parallel_for(0, queries.size(), 0, [&](size_t begin, size_t end, int) {
+        std::vector<TopK> best(SAMPLE_BLOCK, TopK(k));
+        for (size_t i0 = begin; i0 < end; i0 += SAMPLE_BLOCK) {
+            int mb = std::min<size_t>(SAMPLE_BLOCK, end - i0);
+            for (int r = 0; r < mb; ++r) {
+                best[r].clear();
+            }
+            for (int c0 = 0; c0 < n_ref; c0 += CLASS_BLOCK) {
+                int nb = std::min(CLASS_BLOCK, n_ref - c0);
+                for (int r = 0; r < mb; ++r) {
+                    const uint64_t* x = queries.row(i0 + r);
+                    for (int c = c0; c < c0 + nb; ++c) {
+                        best[r].push(bit_dot(x, refs.row(c), n_words, n_dim), c);
+                    }
+                }
+            }
+            for (int r = 0; r < mb; ++r) {
+                best[r].write(ids.row(i0 + r), dots.row(i0 + r));
+            }
+        }
+    });
+}
@@ -0,0 +1,120 @@
+#ifndef SIMILARITY_H
+#define SIMILARITY_H
+
+#include <algorithm>
+#include <climits>
+#include <utility>
+#include <vector>
+
+#include "bithv.h"
+#include "hv_matrix.h"
+
+/**
+ * @brief Class hypervectors prepared once for batched scoring.
+ *
+ * The score of a sample x against class c is dot(x, hvs[c]) / norms[c]. Binary models
+ * store the binarized +1/-1 class hypervectors with unit norms, so the score is the
+ * plain dot product.
+ */
+struct ClassMatrix {
+    HVMatrix<double> hvs; ///< One row per class.
+    std::vector<double> norms; ///< Divisor of every class score.
+};
+
+/**
+ * @brief Predicts the best scoring class of every sample.
+ *
+ * Computes the sample x class dot products as a cache-blocked, register-tiled matrix
+ * product (class blocks x dimension blocks x 4x4 tiles) and keeps only the running
+ * argmax of every sample, so the full distance matrix is never stored. Tiles run on the
+ * instruction set selected by active_isa(), and samples are split across the global
+ * thread pool. Ties resolve to the lowest class index, like std::max_element.
+ *
+ * @param inp Encoded samples, one row per sample.
+ * @param classes Prepared class hypervectors with at least one class.
+ * @param pred Output array of inp.rows() predicted class indices.
+ */
+void argmax_classes(HVView<const int> inp, const ClassMatrix& classes, int* pred);
+
+/**
+ * @brief Predicts the best scoring class of every bit-packed sample.
+ *
+ * Same blocking as the integer overload, with popcount similarity (see bit_dot()).
+ *
+ * @param inp Bit-packed encoded samples.
+ * @param classes Bit-packed binarized class hypervectors with at least one class.
+ * @param pred Output array of inp.size() predicted class indices.
+ */
+void argmax_classes(const BitHVs& inp, const BitHVs& classes, int* pred);
+
+/**
+ * @brief Predicts the best scoring class of every row of packed words.
+ *
+ * Lets callers score a range of a BitHVs batch, e.g. BitHVs::view().slice(begin, n).
+ *
+ * @param inp Packed samples with classes.words() words per row.
+ * @param classes Bit-packed binarized class hypervectors with at least one class.
+ * @param pred Output array of inp.rows() predicted class indices.
+ */
+void argmax_classes(HVView<const uint64_t> inp, const BitHVs& classes, int* pred);
+
+/**
+ * @brief Keeps the k best (score, index) pairs pushed so far.
+ *
+ * A pair is better than another if its score is higher, or if the scores are equal and
+ * its index is lower, so results do not depend on the order indices are pushed in.
+ */
+class TopK {
+public:
+    explicit TopK(int k) : k(k) { heap.reserve(k); }
+
+    /**
+     * @brief Offers one candidate.
+     */
+    void push(int score, int index) {
+        std::pair<int, int> item(score, -index);
+        if (static_cast<int>(heap.size()) < k) {
+            heap.push_back(item);
+            std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<int, int>>());
+        } else if (k > 0 && heap.front() < item) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<int, int>>());
+            heap.back() = item;
+            std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<int, int>>());
+        }
+    }
+
+    /**
+     * @brief Writes the pairs best first; missing entries get index -1 and score INT_MIN.
+     */
+    void write(int* ids, int* scores) const {
+        std::vector<std::pair<int, int>> sorted(heap);
+        std::sort(sorted.begin(), sorted.end(), std::greater<std::pair<int, int>>());
+        for (int i = 0; i < k; ++i) {
+            bool valid = i < static_cast<int>(sorted.size());
+            ids[i] = valid ? -sorted[i].second : -1;
+            scores[i] = valid ? sorted[i].first : INT_MIN;
+        }
+    }
+
+    void clear() { heap.clear(); } ///< Forgets every candidate.
+
+private:
+    int k; ///< Number of pairs kept.
+    std::vector<std::pair<int, int>> heap; ///< Min-heap of (score, -index), worst on top.
+};
+
+/**
+ * @brief Finds the k most similar bit-packed references of every query by exhaustive scan.
+ *
+ * Uses the same query x reference blocking as argmax_classes() and splits queries across
+ * the global thread pool.
+ *
+ * @param queries Bit-packed queries.
+ * @param refs Bit-packed references of the same dimension.
+ * @param k Number of neighbours per query.
+ * @param ids Output queries.size() x k reference indices, best first (see TopK).
+ * @param dots Output queries.size() x k bipolar dot products matching ids.
+ */
+void topk_classes(const BitHVs& queries, const BitHVs& refs, int k, HVMatrix<int>& ids, HVMatrix<int>& dots);
+
+#endif // SIMILARITY_H
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "stream.h"
+
+bool SampleReader::open(const std::string& dataset_name, bool train) {
+    base_path = "./dataset/" + dataset_name + "/";
+    subset = train ? "train" : "test";
+    mapped_labels = nullptr;
+
+    if (Dataset::binary_is_current(base_path)) {
+        if (!dataset.map_binary(base_path + "dataset.bin")) {
+            return false;
+        }
+        const DataSubset& data = train ? dataset.train : dataset.test;
+        mapped_values = data.view;
+        mapped_labels = &data.labels;
+        n_samples = data.size;
+        n_points = data.sample_size;
+        return rewind();
+    }
+
+    if (!dataset.read_parameters(base_path + "dataset_parameters")) {
+        return false;
+    }
+    n_samples = train ? dataset.train_size : dataset.test_size;
+    n_points = dataset.sample_size;
+    return rewind();
+}
+
+bool SampleReader::rewind() {
+    position = 0;
+    if (mapped_labels) {
+        return true;
+    }
+
+    std::string values_name = base_path + subset + ".val";
+    std::string labels_name = base_path + subset + ".label";
+    values_file.close();
+    labels_file.close();
+    values_file.open(values_name);
+    if (!values_file.is_open()) {
+        std::cerr << "Error opening file " << values_name << std::endl;
+        return false;
+    }
+    labels_file.open(labels_name);
+    if (!labels_file.is_open()) {
+        std::cerr << "Error opening file " << labels_name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SampleReader::next(size_t max_rows, RawChunk& chunk) {
+    size_t n = std::min(max_rows, n_samples - position);
+    chunk.labels.clear();
+    if (n == 0) {
+        return true;
+    }
+    if (chunk.values.rows() != n || static_cast<int>(chunk.values.cols()) != n_points) {
+        chunk.values = HVMatrix<int>(n, n_points);
+    }
+    chunk.labels.resize(n);
+
+    if (mapped_labels) {
+        LevelView rows = mapped_values.slice(position, n);
+        rows.visit([&](auto v) {
+            for (size_t i = 0; i < n; ++i) {
+                std::copy(v.row(i), v.row(i) + n_points, chunk.values.row(i));
+            }
+        });
+        std::copy(mapped_labels->begin() + position, mapped_labels->begin() + position + n, chunk.labels.begin());
+        position += n;
+        return true;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t sample = position + i;
+        do {
+            if (!std::getline(values_file, line)) {
+                std::cerr << "Expected " << n_samples << " samples in " << base_path << subset << ".val but found "
+                          << sample << std::endl;
+                return false;
+            }
+        } while (is_blank_line(line.data(), line.data() + line.size()));
+        int count = parse_int_line(line.data(), line.data() + line.size(), chunk.values.row(i), n_points);
+        if (count != n_points) {
+            std::cerr << "Malformed sample " << sample << " in " << base_path << subset << ".val" << std::endl;
+            return false;
+        }
+        if (!(labels_file >> chunk.labels[i])) {
+            std::cerr << "Expected " << n_samples << " labels in " << base_path << subset << ".label but found "
+                      << sample << std::endl;
+            return false;
+        }
+    }
+    position += n;
+
+    // As read_values and read_labels do, reject anything but blank lines after the last sample
+    if (position == n_samples) {
+        if (!only_blank_lines(values_file)) {
+            std::cerr << "Expected " << n_samples << " samples in " << base_path << subset << ".val but found more"
+                      << std::endl;
+            return false;
+        }
+        if (!only_blank_lines(labels_file)) {
+            std::cerr << "Expected " << n_samples << " labels in " << base_path << subset << ".label but found more"
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SampleReader::only_blank_lines(std::ifstream& file) {
+    while (std::getline(file, line)) {
+        if (!is_blank_line(line.data(), line.data() + line.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SpillFile::~SpillFile() {
+    remove();
+}
+
+bool SpillFile::create(const std::string& filename, int n_dim) {
+    remove();
+    this->filename = filename;
+    this->n_dim = n_dim;
+    writer.open(filename, std::ios::binary | std::ios::trunc);
+    if (!writer.is_open()) {
+        std::cerr << "Error creating spill file " << filename << std::endl;
+        this->filename.clear();
+        return false;
+    }
+    return true;
+}
+
+bool SpillFile::write_record(const void* rows, size_t row_bytes, const std::vector<int>& labels) {
+    uint64_t n_rows = labels.size();
+    writer.write(reinterpret_cast<const char*>(&n_rows), sizeof(n_rows));
+    writer.write(reinterpret_cast<const char*>(labels.data()), labels.size() * sizeof(int));
+    writer.write(static_cast<const char*>(rows), n_rows * row_bytes);
+    return static_cast<bool>(writer);
+}
+
+bool SpillFile::write(const HVMatrix<int>& hvs, const std::vector<int>& labels) {
+    return write_record(hvs.data(), hvs.stride() * sizeof(int), labels);
+}
+
+bool SpillFile::write(const BitHVs& hvs, const std::vector<int>& labels) {
+    return write_record(hvs.view().data(), hvs.view().stride() * sizeof(uint64_t), labels);
+}
+
+bool SpillFile::finish() {
+    writer.close();
+    complete = !writer.fail();
+    return complete;
+}
+
+bool SpillFile::rewind() {
+    reader.close();
+    reader.open(filename, std::ios::binary);
+    if (!reader.is_open()) {
+        std::cerr << "Error opening spill file " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SpillFile::read_record(size_t& n_rows, std::vector<int>& labels) {
+    uint64_t rows = 0;
+    labels.clear();
+    if (!reader.read(reinterpret_cast<char*>(&rows), sizeof(rows))) {
+        n_rows = 0;
+        if (reader.eof() && reader.gcount() == 0) {
+            return true;
+        }
+        std::cerr << "Truncated spill file " << filename << std::endl;
+        return false;
+    }
+    labels.resize(rows);
+    if (!reader.read(reinterpret_cast<char*>(labels.data()), rows * sizeof(int))) {
+        std::cerr << "Truncated spill file " << filename << std::endl;
+        return false;
+    }
+    n_rows = rows;
+    return true;
+}
+
+bool SpillFile::read(Chunk<HVMatrix<int>>& chunk) {
+    size_t n_rows;
+    if (!read_record(n_rows, chunk.labels)) {
+        return false;
+    }
+    if (n_rows == 0) {
+        return true;
+    }
+    if (chunk.values.rows() != n_rows || static_cast<int>(chunk.values.cols()) != n_dim) {
+        chunk.values = HVMatrix<int>(n_rows, n_dim);
+    }
+    if (!reader.read(reinterpret_cast<char*>(chunk.values.data()), n_rows * chunk.values.stride() * sizeof(int))) {
+        std::cerr << "Truncated spill file " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SpillFile::read(Chunk<BitHVs>& chunk) {
+    size_t n_rows;
+    if (!read_record(n_rows, chunk.labels)) {
+        return false;
+    }
+    if (n_rows == 0) {
+        return true;
+    }
+    if (chunk.values.size() != n_rows || chunk.values.dim() != n_dim) {
+        chunk.values = BitHVs(n_rows, n_dim);
+    }
+    size_t bytes = n_rows * chunk.values.view().stride() * sizeof(uint64_t);
+    if (!reader.read(reinterpret_cast<char*>(chunk.values.row(0)), bytes)) {
+        std::cerr << "Truncated spill file " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void SpillFile::remove() {
+    writer.close();
+    reader.close();
+    complete = false;
+    if (!filename.empty()) {
+        std::remove(filename.c_str());
+        filename.clear();
+    }
+}
+
+size_t stream_chunk_rows(size_t budget_bytes, size_t raw_bytes, size_t encoded_bytes, size_t ring_slots) {
+    size_t per_chunk_row = (ring_slots + 2) * (raw_bytes + encoded_bytes);
+    return std::max<size_t>(1, budget_bytes / std::max<size_t>(1, per_chunk_row));
+}
@@ -0,0 +1,356 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bithv.h"
+#include "dataset.h"
+#include "hv_matrix.h"
+
+/**
+ * @brief A blocking FIFO of at most capacity items, used as the ring between pipeline stages.
+ *
+ * push() waits while the queue is full and pop() waits while it is empty, so a fast
+ * producer can never run more than capacity items ahead of its consumer.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+    /**
+     * @brief Appends an item, waiting for a free slot.
+     *
+     * @return False if the queue was closed and the item was dropped.
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest item, waiting until one is available.
+     *
+     * @return False once the queue is closed and drained.
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Wakes every waiter; queued items can still be popped, new ones are refused.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+    size_t capacity; ///< Maximum number of queued items.
+    std::deque<T> items; ///< Queued items, oldest first.
+    bool closed = false; ///< Set by close().
+    std::mutex mutex; ///< Guards items and closed.
+    std::condition_variable not_empty; ///< Signals pop() that an item or close() arrived.
+    std::condition_variable not_full; ///< Signals push() that a slot or close() arrived.
+};
+
+/**
+ * @brief A chunk of consecutive samples and their labels.
+ *
+ * @tparam Values Row-major sample storage: HVMatrix<int> for levels, or an encoding.
+ */
+template <typename Values>
+struct Chunk {
+    Values values; ///< One row per sample.
+    std::vector<int> labels; ///< Label of every row; empty marks the end of a pass.
+};
+
+using RawChunk = Chunk<HVMatrix<int>>;
+
+/**
+ * @class SampleReader
+ * @brief Reads one subset of a dataset in chunks of samples without loading all of it.
+ *
+ * A dataset.bin file is mapped and copied out chunk by chunk, so only the pages being
+ * read are touched. Otherwise <subset>.val and <subset>.label are read line by line, and
+ * only the current chunk is ever held in memory.
+ */
+class SampleReader {
+public:
+    /**
+     * @brief Opens the train or test subset of ./dataset/<dataset_name>/.
+     *
+     * @param dataset_name Name of the dataset directory.
+     * @param train Whether to read the train subset instead of the test subset.
+     * @return True if the subset was opened successfully, false otherwise.
+     */
+    bool open(const std::string& dataset_name, bool train);
+
+    /**
+     * @brief Restarts reading from the first sample.
+     *
+     * @return True if the subset was reopened successfully, false otherwise.
+     */
+    bool rewind();
+
+    /**
+     * @brief Reads up to max_rows samples into chunk.
+     *
+     * @param max_rows Maximum number of samples to read.
+     * @param chunk Output chunk; its labels are empty once every sample was read.
+     * @return False if the files are malformed or hold more samples than the dataset parameters say,
+     *         true otherwise.
+     */
+    bool next(size_t max_rows, RawChunk& chunk);
+
+    size_t size() const { return n_samples; } ///< Number of samples in the subset.
+    int sample_size() const { return n_points; } ///< Number of points per sample.
+
+private:
+    std::string base_path; ///< ./dataset/<dataset_name>/.
+    std::string subset; ///< "train" or "test".
+    Dataset dataset; ///< Sizes of the dataset, and the mapping of dataset.bin when it is current.
+    LevelView mapped_values; ///< Values of the subset inside the mapping.
+    const std::vector<int>* mapped_labels = nullptr; ///< Labels of the subset, when mapped.
+    std::ifstream values_file; ///< <subset>.val, when reading text.
+    std::ifstream labels_file; ///< <subset>.label, when reading text.
+    std::string line; ///< Reused line buffer.
+    size_t n_samples = 0; ///< Number of samples in the subset.
+    int n_points = 0; ///< Number of points per sample.
+    size_t position = 0; ///< Index of the next sample to read.
+
+    /**
+     * @brief Reads the rest of a text file and returns whether it holds only blank lines.
+     */
+    bool only_blank_lines(std::ifstream& file);
+};
+
+/**
+ * @class SpillFile
+ * @brief Scratch file holding the encoded chunks of one pass, so later passes skip encoding.
+ *
+ * Chunks are appended while the first pass encodes them and replayed in the same order by
+ * later passes. Each record is the row count, the labels and the raw rows of the encoding
+ * including their padding, so replayed chunks are bit-identical to freshly encoded ones.
+ * The file is deleted when the SpillFile is destroyed.
+ */
+class SpillFile {
+public:
+    SpillFile() = default;
+    ~SpillFile();
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    /**
+     * @brief Creates an empty spill file, replacing any existing file.
+     *
+     * @param filename The name of the scratch file.
+     * @param n_dim Dimension of the encoded hypervectors.
+     * @return True if the file was created successfully, false otherwise.
+     */
+    bool create(const std::string& filename, int n_dim);
+
+    /**
+     * @brief Appends an encoded chunk.
+     *
+     * @return True if the chunk was written successfully, false otherwise.
+     */
+    bool write(const HVMatrix<int>& hvs, const std::vector<int>& labels);
+
+    /**
+     * @brief Appends a bit-packed encoded chunk.
+     *
+     * @return True if the chunk was written successfully, false otherwise.
+     */
+    bool write(const BitHVs& hvs, const std::vector<int>& labels);
+
+    /**
+     * @brief Closes the writer; from then on ready() is true and passes replay the file.
+     *
+     * @return True if every chunk reached the file, false otherwise.
+     */
+    bool finish();
+
+    /**
+     * @brief Restarts reading from the first chunk.
+     *
+     * @return True if the file was reopened successfully, false otherwise.
+     */
+    bool rewind();
+
+    /**
+     * @brief Reads the next encoded chunk.
+     *
+     * @param chunk Output chunk; its labels are empty once every chunk was read.
+     * @return False if the file is truncated or corrupt, true otherwise.
+     */
+    bool read(Chunk<HVMatrix<int>>& chunk);
+
+    /**
+     * @brief Reads the next bit-packed encoded chunk.
+     *
+     * @param chunk Output chunk; its labels are empty once every chunk was read.
+     * @return False if the file is truncated or corrupt, true otherwise.
+     */
+    bool read(Chunk<BitHVs>& chunk);
+
+    /**
+     * @brief Closes and deletes the file.
+     */
+    void remove();
+
+    bool is_open() const { return writer.is_open(); } ///< Whether chunks are being written.
+    bool ready() const { return complete; } ///< Whether a full pass can be replayed.
+
+private:
+    std::string filename; ///< Path of the scratch file.
+    int n_dim = 0; ///< Dimension of the encoded hypervectors.
+    std::ofstream writer; ///< Open while the first pass writes.
+    std::ifstream reader; ///< Open while a later pass replays.
+    bool complete = false; ///< Set by finish().
+
+    bool write_record(const void* rows, size_t row_bytes, const std::vector<int>& labels);
+    bool read_record(size_t& n_rows, std::vector<int>& labels);
+};
+
+/**
+ * @brief Number of samples per chunk that keeps a streaming pass within a memory budget.
+ *
+ * Every stage of stream_pass() holds at most ring_slots + 2 raw and ring_slots + 2
+ * encoded chunks at a time (one being produced, ring_slots queued, one being consumed).
+ *
+ * @param budget_bytes Memory available for in-flight chunks.
+ * @param raw_bytes Bytes of one raw sample.
+ * @param encoded_bytes Bytes of one encoded sample.
+ * @param ring_slots Capacity of each queue between stages.
+ * @return At least one sample.
+ */
+size_t stream_chunk_rows(size_t budget_bytes, size_t raw_bytes, size_t encoded_bytes, size_t ring_slots);
+
+/**
+ * @brief Streams one pass over a subset through overlapped load, encode and consume stages.
+ *
+ * A loader thread reads raw chunks and an encoder thread encodes them, each handing
+ * chunks to the next stage through a BoundedQueue of ring_slots chunks, while the caller
+ * consumes the encoded chunks in order. When spill is open the encoded chunks are also
+ * appended to it, and once a pass completed, later passes replay the spill file instead
+ * of reading and encoding again. A spill file that fails to write is dropped and the pass
+ * continues without it.
+ *
+ * @tparam Encoded HVMatrix<int> or BitHVs.
+ * @param reader Subset to read when the spill file is not ready.
+ * @param spill Optional spill file; neither open nor ready disables spilling.
+ * @param chunk_rows Samples per chunk.
+ * @param ring_slots Capacity of each queue between stages.
+ * @param encode Callback mapping HVView<const int> levels to an Encoded.
+ * @param consume Callback run on the caller's thread with (const Encoded&, labels).
+ * @return True if every sample was read and consumed, false otherwise.
+ */
+template <typename Encoded, typename EncodeFn, typename ConsumeFn>
+bool stream_pass(SampleReader& reader, SpillFile& spill, size_t chunk_rows, size_t ring_slots, EncodeFn&& encode,
+                 ConsumeFn&& consume) {
+    BoundedQueue<Chunk<Encoded>> encoded(ring_slots);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> stages;
+
+    if (spill.ready()) {
+        if (!spill.rewind()) {
+            return false;
+        }
+        stages.emplace_back([&] {
+            Chunk<Encoded> chunk;
+            while (true) {
+                if (!spill.read(chunk)) {
+                    failed = true;
+                    break;
+                }
+                if (chunk.labels.empty() || !encoded.push(std::move(chunk))) {
+                    break;
+                }
+            }
+            encoded.close();
+        });
+    } else {
+        if (!reader.rewind()) {
+            return false;
+        }
+        auto raw = std::make_shared<BoundedQueue<RawChunk>>(ring_slots);
+        stages.emplace_back([&, raw] {
+            RawChunk chunk;
+            while (true) {
+                if (!reader.next(chunk_rows, chunk)) {
+                    failed = true;
+                    break;
+                }
+                if (chunk.labels.empty() || !raw->push(std::move(chunk))) {
+                    break;
+                }
+            }
+            raw->close();
+        });
+        stages.emplace_back([&, raw] {
+            RawChunk chunk;
+            while (raw->pop(chunk)) {
+                Chunk<Encoded> out;
+                out.values = encode(HVView<const int>(chunk.values.view()));
+                out.labels = std::move(chunk.labels);
+                if (spill.is_open() && !spill.write(out.values, out.labels)) {
+                    std::cerr << "WARNING: spilling encodings failed, later passes will re-encode" << std::endl;
+                    spill.remove();
+                }
+                if (!encoded.push(std::move(out))) {
+                    break;
+                }
+            }
+            raw->close();
+            encoded.close();
+        });
+    }
+
+    Chunk<Encoded> chunk;
+    while (encoded.pop(chunk)) {
+        consume(static_cast<const Encoded&>(chunk.values), static_cast<const std::vector<int>&>(chunk.labels));
+    }
+    for (auto& stage : stages) {
+        stage.join();
+    }
+
+    if (failed) {
+        return false;
+    }
+    if (spill.is_open() && !spill.finish()) {
+        std::cerr << "WARNING: spilling encodings failed, later passes will re-encode" << std::endl;
+        spill.remove();
+    }
+    return true;
+}
+
+#endif // STREAM_H
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "thread_pool.h"
+
+namespace {
+
+// Index of the pool thread running on this OS thread, or -1 outside of any loop
+thread_local int current_tid = -1;
+
+std::unique_ptr<ThreadPool> global_pool;
+std::mutex global_pool_mutex;
+
+} // namespace
+
+ThreadPool::ThreadPool(int n_threads) : n_threads(std::max(1, n_threads)) {
+    for (int t = 0; t < this->n_threads; ++t) {
+        queues.emplace_back(new Queue());
+    }
+    for (int t = 1; t < this->n_threads; ++t) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, t);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, const ChunkFn& fn) {
+    if (end <= begin) {
+        return;
+    }
+    size_t n = end - begin;
+    if (grain == 0) {
+        grain = std::max<size_t>(1, n / (static_cast<size_t>(n_threads) * 4));
+    }
+
+    // Serial fast paths: single thread, a single chunk, or a loop nested inside a chunk
+    if (current_tid >= 0) {
+        fn(begin, end, current_tid);
+        return;
+    }
+    if (n_threads == 1 || n <= grain) {
+        current_tid = 0;
+        fn(begin, end, 0);
+        current_tid = -1;
+        return;
+    }
+
+    std::lock_guard<std::mutex> caller_lock(caller_mutex);
+
+    size_t n_chunks = (n + grain - 1) / grain;
+    Job job;
+    job.fn = &fn;
+    job.remaining.store(n_chunks);
+
+    for (size_t c = 0; c < n_chunks; ++c) {
+        size_t chunk_begin = begin + c * grain;
+        size_t chunk_end = std::min(end, chunk_begin + grain);
+        Queue& queue = *queues[c % n_threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(Task{&job, chunk_begin, chunk_end});
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        pending += n_chunks;
+    }
+    wake.notify_all();
+
+    current_tid = 0;
+    while (job.remaining.load() > 0) {
+        if (!try_run_one(0)) {
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            done.wait(lock, [&] { return job.remaining.load() == 0; });
+        }
+    }
+    current_tid = -1;
+}
+
+void ThreadPool::worker_loop(int tid) {
+    current_tid = tid;
+    while (true) {
+        if (try_run_one(tid)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake.wait(lock, [&] { return stopping || pending > 0; });
+        if (stopping && pending == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::try_run_one(int tid) {
+    Task task;
+    if (!pop_task(tid, task)) {
+        return false;
+    }
+    (*task.job->fn)(task.begin, task.end, tid);
+    if (task.job->remaining.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        done.notify_all();
+    }
+    return true;
+}
+
+bool ThreadPool::pop_task(int tid, Task& task) {
+    bool found = false;
+    // Own deque first, newest chunk first
+    {
+        Queue& own = *queues[tid];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    // Then steal the oldest chunk of another thread
+    for (int k = 1; !found && k < n_threads; ++k) {
+        Queue& victim = *queues[(tid + k) % n_threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (found) {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        --pending;
+    }
+    return found;
+}
+
+ThreadPool& ThreadPool::global() {
+    std::lock_guard<std::mutex> lock(global_pool_mutex);
+    if (!global_pool) {
+        global_pool.reset(new ThreadPool(default_threads()));
+    }
+    return *global_pool;
+}
+
+void ThreadPool::set_global_threads(int n_threads) {
+    std::lock_guard<std::mutex> lock(global_pool_mutex);
+    global_pool.reset(new ThreadPool(n_threads >= 1 ? n_threads : default_threads()));
+}
+
+int ThreadPool::default_threads() {
+    const char* env = std::getenv("HDC_THREADS");
+    if (env != nullptr) {
+        int n = std::atoi(env);
+        if (n >= 1) {
+            return n;
+        }
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
@@ -0,0 +1,122 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief A fixed-size work-stealing thread pool for data-parallel loops.
+ *
+ * parallel_for() cuts an index range into chunks and deals them round-robin onto one
+ * deque per thread. Every thread pops chunks from the back of its own deque and, once it
+ * runs dry, steals from the front of the other deques, so uneven chunks balance out. The
+ * calling thread takes part as thread 0, which means a pool of size 1 runs everything
+ * inline with no synchronization at all.
+ *
+ * Each chunk is handed the index of the thread running it, so callers can keep
+ * per-thread scratch buffers or partial results and merge them after the loop.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Callback run for every chunk: (begin, end, thread index).
+     */
+    using ChunkFn = std::function<void(size_t, size_t, int)>;
+
+    /**
+     * @brief Starts a pool.
+     *
+     * @param n_threads Total number of threads including the caller; values < 1 mean 1.
+     */
+    explicit ThreadPool(int n_threads);
+
+    /**
+     * @brief Stops and joins all worker threads.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Number of threads that can run chunks, including the caller.
+     */
+    int size() const { return n_threads; }
+
+    /**
+     * @brief Runs fn over [begin, end) in chunks of at most grain indices.
+     *
+     * Blocks until every chunk has finished. Calls made from inside a chunk run serially
+     * on the calling thread, so nested loops are safe but not parallel.
+     *
+     * @param begin First index.
+     * @param end One past the last index.
+     * @param grain Maximum chunk size; 0 picks about four chunks per thread.
+     * @param fn Chunk callback.
+     */
+    void parallel_for(size_t begin, size_t end, size_t grain, const ChunkFn& fn);
+
+    /**
+     * @brief Returns the process-wide pool used by HDC, creating it on first use.
+     */
+    static ThreadPool& global();
+
+    /**
+     * @brief Replaces the process-wide pool with one of n_threads threads.
+     *
+     * Must not be called while the global pool is running a loop.
+     *
+     * @param n_threads Total number of threads; values < 1 select default_threads().
+     */
+    static void set_global_threads(int n_threads);
+
+    /**
+     * @brief Thread count from the HDC_THREADS environment variable, or the number of
+     *        hardware threads when it is unset.
+     */
+    static int default_threads();
+
+private:
+    struct Job;
+
+    struct Task {
+        Job* job; ///< Loop the chunk belongs to.
+        size_t begin; ///< First index of the chunk.
+        size_t end; ///< One past the last index of the chunk.
+    };
+
+    struct Job {
+        const ChunkFn* fn; ///< Chunk callback.
+        std::atomic<size_t> remaining; ///< Chunks not yet finished.
+    };
+
+    struct Queue {
+        std::mutex mutex; ///< Guards tasks.
+        std::deque<Task> tasks; ///< Pending chunks.
+    };
+
+    int n_threads; ///< Threads including the caller.
+    std::vector<std::unique_ptr<Queue>> queues; ///< One deque per thread.
+    std::vector<std::thread> workers; ///< Threads 1..n_threads-1.
+    std::mutex caller_mutex; ///< Serializes loops started by threads outside the pool.
+
+    std::mutex wake_mutex; ///< Guards pending and stopping for the condition variable.
+    std::condition_variable wake; ///< Signals workers that chunks were queued.
+    std::condition_variable done; ///< Signals the caller that a loop finished.
+    size_t pending = 0; ///< Queued chunks not yet picked up.
+    bool stopping = false; ///< Set when the pool is being destroyed.
+
+    void worker_loop(int tid);
+    bool try_run_one(int tid);
+    bool pop_task(int tid, Task& task);
+};
+
+#endif // THREAD_POOL_H
@@ -17,6 +17,19 @@ std::vector<int> binarize(const std::vector<int>& x) {
     return result;
 }
 
+/**
+ * @brief Binarizes n values without allocating.
+ *
+ * @param x Input values.
+ * @param out Output buffer of n values; may be the same buffer as x.
+ * @param n Number of values.
+ */
+void binarize(const int* x, int* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = x[i] > 0 ? 1 : -1;
+    }
+}
+
 
 /**
  * @brief Generates a random integer vector.
@@ -50,3 +63,17 @@ void print_2d_vector(const std::vector<std::vector<int>>& vec) {
         std::cout << std::endl;
     }
 }
+
+/**
+ * @brief Prints the valid elements of a hypervector matrix to the standard output.
+ *
+ * @param mat The matrix to print.
+ */
+void print_2d_vector(HVView<const int> mat) {
+    for (size_t i = 0; i < mat.rows(); ++i) {
+        for (size_t j = 0; j < mat.cols(); ++j) {
+            std::cout << mat(i, j) << " ";
+        }
+        std::cout << std::endl;
+    }
+}
@@ -1,15 +1,33 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
+#include "hv_matrix.h"
+
 // Binarize function
 std::vector<int> binarize(const std::vector<int>& x);
 
+// Binarize n values from x into out (x and out may alias)
+void binarize(const int* x, int* out, size_t n);
+
 // Generate random integer vector
 std::vector<int> generate_random_vector(int size, int min, int max);
 
 // Print 2D vector
 void print_2d_vector(const std::vector<std::vector<int>>& vec);
 
+// Print the valid elements of every row of a hypervector matrix
+void print_2d_vector(HVView<const int> mat);
+
+// Mix one 64-bit value into a running content hash (splitmix64 finalizer), for cache keys
+inline uint64_t hash_mix(uint64_t h, uint64_t v) {
+    uint64_t z = h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
 #endif // UTILS_H
@@ -8,6 +8,9 @@
 #include <vector>
 #include <memory>
 #include <utility>
+#include <initializer_list>
+
+#include "hv_matrix.h"
 
 #define DATASET "EMG_Hand"
 
@@ -18,7 +21,7 @@ class DataSubset {
 public:
     int size; /**< The number of samples in the subset. */
     int sample_size; /**< The number of points in each sample. */
-    std::vector<std::vector<int>> values; /**< The values of the samples. */
+    HVMatrix<int> values; /**< The values of the samples, one row per sample. */
     std::vector<int> labels; /**< The labels of the samples. */
 
     /**
@@ -46,9 +49,9 @@ bool DataSubset::read_values(const std::string &filename) {
     }
 
     std::string line;
-    values.resize(size, std::vector<int>(sample_size));
+    values = HVMatrix<int>(size, sample_size, 0, true);
     int sample_idx = 0;
-    while (std::getline(file, line)) {
+    while (sample_idx < size && std::getline(file, line)) {
         std::istringstream iss(line);
         for (int point_idx = 0; point_idx < sample_size; ++point_idx) {
             iss >> values[sample_idx][point_idx];
@@ -112,16 +115,16 @@ public:
     /**
      * @brief Returns the training set as a pair of values and labels.
      * 
-     * @return A pair of vectors, where the first vector contains the values and the second vector contains the labels.
+     * @return A pair where the first element is the value matrix and the second contains the labels.
      */
-    std::pair<std::vector<std::vector<int>>, std::vector<int>> get_trainset();
+    std::pair<HVMatrix<int>, std::vector<int>> get_trainset();
 
     /**
      * @brief Returns the test set as a pair of values and labels.
      * 
-     * @return A pair of vectors, where the first vector contains the values and the second vector contains the labels.
+     * @return A pair where the first element is the value matrix and the second contains the labels.
      */
-    std::pair<std::vector<std::vector<int>>, std::vector<int>> get_testset();
+    std::pair<HVMatrix<int>, std::vector<int>> get_testset();
 };
 
 bool Dataset::read_parameters(const std::string &filename) {
@@ -176,26 +179,22 @@ int Dataset::get_checksum() {
     int N = (1L << 20);
     int acc = 0;
 
-    for (const auto &sample : train.values) {
-        for (const auto &point : sample) {
-            acc = (point + acc) % N;
-        }
-    }
-
-    for (const auto &sample : test.values) {
-        for (const auto &point : sample) {
-            acc = (point + acc) % N;
+    for (const HVMatrix<int> *values : {&train.values, &test.values}) {
+        for (size_t i = 0; i < values->rows(); ++i) {
+            for (size_t j = 0; j < values->cols(); ++j) {
+                acc = ((*values)(i, j) + acc) % N;
+            }
         }
     }
 
     return acc;
 }
 
-std::pair<std::vector<std::vector<int>>, std::vector<int>> Dataset::get_trainset() {
+std::pair<HVMatrix<int>, std::vector<int>> Dataset::get_trainset() {
     return std::make_pair(train.values, train.labels);
 }
 
-std::pair<std::vector<std::vector<int>>, std::vector<int>> Dataset::get_testset() {
+std::pair<HVMatrix<int>, std::vector<int>> Dataset::get_testset() {
     return std::make_pair(test.values, test.labels);
 }
 
@@ -16,26 +16,24 @@ HDC::HDC(int n_class, int n_lv, int n_id, int n_dim, bool binary)
     // Initialize hv_lv and hv_id with random values
     hv_lv = generate_hvs(n_lv, n_dim);
     hv_id = generate_hvs(n_id, n_dim);
-    class_hvs = std::vector<std::vector<int>>(n_class, std::vector<int>(n_dim, 0));
+    class_hvs = HVMatrix<int>(n_class, n_dim, 0);
 }
 
-std::vector<std::vector<int>> HDC::encode(const std::vector<std::vector<int>>& inp) {
-    int n_batch = inp.size();
-    std::vector<std::vector<int>> inp_enc(n_batch, std::vector<int>(n_dim, 0));
+HVMatrix<int> HDC::encode(HVView<const int> inp) {
+    int n_batch = inp.rows();
+    HVMatrix<int> inp_enc(n_batch, n_dim, 0);
     
     for (int i = 0; i < n_batch; ++i) {
-        std::vector<int> tmp(n_dim, 0);
+        int* tmp = inp_enc.row(i);
         for (int j = 0; j < n_id; ++j) {
+            const int* id = hv_id.row(j);
+            const int* lv = hv_lv.row(inp[i][j]);
             for (int d = 0; d < n_dim; ++d) {
-                tmp[d] += hv_id[j][d] * hv_lv[inp[i][j]][d];
+                tmp[d] += id[d] * lv[d];
             }
         }
-        inp_enc[i] = tmp;
-    }
-
-    if (binary) {
-        for (auto& vec : inp_enc) {
-            vec = binarize(vec);
+        if (binary) {
+            binarize(tmp, tmp, n_dim);
         }
     }
 
@@ -50,15 +48,15 @@ std::vector<std::vector<int>> HDC::encode(const std::vector<std::vector<int>>& i
 //     return hvs;
 // }
 
-std::vector<std::vector<int>> HDC::generate_hvs(int n, int dim) {
+HVMatrix<int> HDC::generate_hvs(int n, int dim) {
     int fixed_value = 2;
-    std::vector<std::vector<int>> hvs(n, std::vector<int>(dim, fixed_value)); // Initialize with fixed value
+    HVMatrix<int> hvs(n, dim, fixed_value); // Initialize with fixed value
     return hvs;
 }
 
 
 
-void HDC::train_init(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target) {
+void HDC::train_init(HVView<const int> inp_enc, const std::vector<int>& target) {
     assert(inp_enc.size() == target.size());
 
     for (int i = 0; i < n_class; ++i) {
@@ -70,18 +68,22 @@ void HDC::train_init(const std::vector<std::vector<int>>& inp_enc, const std::ve
                 }
             }
         }
-        class_hvs[i] = binary ? binarize(sum) : sum;
+        if (binary) {
+            binarize(sum.data(), class_hvs.row(i), n_dim);
+        } else {
+            std::copy(sum.begin(), sum.end(), class_hvs.row(i));
+        }
     }
 }
 
 // Implementation of the getter function
-const std::vector<std::vector<int>>& HDC::get_class_hvs() const {
+const HVMatrix<int>& HDC::get_class_hvs() const {
     return class_hvs;
 }
 
 
 
-double HDC::test_CPU(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target) {
+double HDC::test_CPU(HVView<const int> inp_enc, const std::vector<int>& target) {
     assert(inp_enc.size() == target.size());
 
     std::vector<std::vector<double>> dist(inp_enc.size(), std::vector<double>(n_class, 0.0));
@@ -92,7 +94,7 @@ double HDC::test_CPU(const std::vector<std::vector<int>>& inp_enc, const std::ve
             double dot_product = 0.0;
             for (int d = 0; d < n_dim; ++d) {
                 if (binary) {
-                    dot_product += inp_enc[i][d] * binarize(class_hvs[j])[d];
+                    dot_product += inp_enc[i][d] * (class_hvs[j][d] > 0 ? 1 : -1);
                 } else {
                     dot_product += inp_enc[i][d] * class_hvs[j][d];
                 }
@@ -121,7 +123,7 @@ double HDC::test_CPU(const std::vector<std::vector<int>>& inp_enc, const std::ve
 }
 
 
-double HDC::test_PIM(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target) {
+double HDC::test_PIM(HVView<const int> inp_enc, const std::vector<int>& target) {
     assert(inp_enc.size() == target.size());
 
     std::vector<std::vector<int>> dist(inp_enc.size(), std::vector<int>(n_class, 0));
@@ -164,7 +166,7 @@ double HDC::test_PIM(const std::vector<std::vector<int>>& inp_enc, const std::ve
 
 
 
-void HDC::train(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target) {
+void HDC::train(HVView<const int> inp_enc, const std::vector<int>& target) {
     assert(inp_enc.size() == target.size());
 
     size_t n_samples = inp_enc.size();
@@ -172,12 +174,12 @@ void HDC::train(const std::vector<std::vector<int>>& inp_enc, const std::vector<
     for (size_t j = 0; j < n_samples; ++j) {
         int pred = 0;
         if (binary) {
-            std::vector<int> bin_class_hvs_flat;
-            for (const auto& hv : class_hvs) {
-                std::vector<int> bin_hv = binarize(hv);
-                bin_class_hvs_flat.insert(bin_class_hvs_flat.end(), bin_hv.begin(), bin_hv.end());
+            std::vector<int> bin_class_hvs_flat(n_class * n_dim);
+            for (int i = 0; i < n_class; ++i) {
+                binarize(class_hvs.row(i), &bin_class_hvs_flat[i * n_dim], n_dim);
             }
-            std::vector<int> inp_enc_binarized = binarize(inp_enc[j]);
+            std::vector<int> inp_enc_binarized(n_dim);
+            binarize(inp_enc.row(j), inp_enc_binarized.data(), n_dim);
             std::vector<int> dist(n_class, 0);
             for (int i = 0; i < n_class; ++i) {
                 int dot_product = 0;
@@ -3,6 +3,8 @@
 
 #include <vector>
 
+#include "hv_matrix.h"
+
 
 /**
  * @class HDC
@@ -27,20 +29,20 @@ public:
      * @param inp Input data to be encoded.
      * @return Encoded hyperdimensional vectors.
      */
-    std::vector<std::vector<int>> encode(const std::vector<std::vector<int>>& inp);
+    HVMatrix<int> encode(HVView<const int> inp);
     
     /**
     * @brief Initializes the class hypervectors based on encoded inputs and target labels.
     * @param inp_enc Encoded input data.
     * @param target Target labels.
     */
-    void train_init(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target);
+    void train_init(HVView<const int> inp_enc, const std::vector<int>& target);
 
     /**
      * @brief Getter for the class hypervectors.
      * @return Class hypervectors.
      */
-    const std::vector<std::vector<int>>& get_class_hvs() const;
+    const HVMatrix<int>& get_class_hvs() const;
 
 
     /**
@@ -54,7 +56,7 @@ public:
     * @param target The target labels for the input data.
     * @return The accuracy of the model on the test data.
     */
-    double test_CPU(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target);
+    double test_CPU(HVView<const int> inp_enc, const std::vector<int>& target);
 
     /**
     * @brief Computes the accuracy of the model on the test data.
@@ -67,7 +69,7 @@ public:
     * @param target The target labels for the input data.
     * @return The accuracy of the model on the test data.
     */
-    double test_PIM(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target);
+    double test_PIM(HVView<const int> inp_enc, const std::vector<int>& target);
 
     /**
     * @brief Trains the HDC model using the input encodings and target labels.
@@ -79,7 +81,7 @@ public:
     * @param inp_enc The encoded input data.
     * @param target The target labels for the input data.
     */
-    void train(const std::vector<std::vector<int>>& inp_enc, const std::vector<int>& target);
+    void train(HVView<const int> inp_enc, const std::vector<int>& target);
 
 private:
     int n_class; ///< Number of classes.
@@ -88,9 +90,9 @@ private:
     int n_dim; ///< Dimension of hypervectors.
     bool binary; ///< Whether to use binary hypervectors.
 
-    std::vector<std::vector<int>> hv_lv; ///< Level hypervectors.
-    std::vector<std::vector<int>> hv_id; ///< Identifier hypervectors.
-    std::vector<std::vector<int>> class_hvs; ///< Class hypervectors.
+    HVMatrix<int> hv_lv; ///< Level hypervectors.
+    HVMatrix<int> hv_id; ///< Identifier hypervectors.
+    HVMatrix<int> class_hvs; ///< Class hypervectors.
 
     /**
      * @brief Generates a set of random hyperdimensional vectors.
@@ -99,7 +101,7 @@ private:
      * @param dim Dimension of each hypervector.
      * @return Generated hyperdimensional vectors.
      */
-    std::vector<std::vector<int>> generate_hvs(int n, int dim);
+    HVMatrix<int> generate_hvs(int n, int dim);
 
 
     
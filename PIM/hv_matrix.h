@@ -0,0 +1,219 @@
+#ifndef HV_MATRIX_H
+#define HV_MATRIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <sys/mman.h>
+
+/**
+ * @brief Alignment of every hypervector row, in bytes (one cache line).
+ */
+constexpr size_t HV_ROW_ALIGN = 64;
+
+/**
+ * @brief Allocations at least this large are eligible for transparent huge pages.
+ */
+constexpr size_t HV_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * @class HVView
+ * @brief A non-owning, row-major view of a matrix of hypervectors.
+ *
+ * The view is a base pointer plus a row stride in elements, so it can describe a whole
+ * HVMatrix, a contiguous range of its rows, or any externally owned buffer (for example a
+ * memory-mapped file) without copying.
+ *
+ * @tparam T Element type, possibly const-qualified.
+ */
+template <typename T>
+class HVView {
+public:
+    HVView() = default;
+
+    /**
+     * @brief Creates a view over existing memory.
+     *
+     * @param data Pointer to the first element of row 0.
+     * @param n_rows Number of rows.
+     * @param n_cols Number of valid elements per row.
+     * @param stride Distance between consecutive rows, in elements.
+     */
+    HVView(T* data, size_t n_rows, size_t n_cols, size_t stride)
+        : ptr(data), n_rows(n_rows), n_cols(n_cols), row_stride(stride) {}
+
+    /**
+     * @brief Allows a mutable view to be passed where a read-only view is expected.
+     */
+    template <typename U, typename = std::enable_if_t<std::is_same<const U, T>::value>>
+    HVView(const HVView<U>& other)
+        : ptr(other.data()), n_rows(other.rows()), n_cols(other.cols()), row_stride(other.stride()) {}
+
+    size_t rows() const { return n_rows; } ///< Number of rows.
+    size_t cols() const { return n_cols; } ///< Number of valid elements per row.
+    size_t size() const { return n_rows; } ///< Number of rows, for container-style loops.
+    size_t stride() const { return row_stride; } ///< Row stride in elements.
+    bool empty() const { return n_rows == 0; } ///< Whether the view has no rows.
+    T* data() const { return ptr; } ///< Pointer to the first element of row 0.
+
+    T* row(size_t i) const { return ptr + i * row_stride; } ///< Pointer to row i.
+    T* operator[](size_t i) const { return row(i); } ///< Pointer to row i, so m[i][j] works.
+    T& operator()(size_t i, size_t j) const { return ptr[i * row_stride + j]; } ///< Element (i, j).
+
+    /**
+     * @brief Returns a view over rows [begin, begin + count).
+     */
+    HVView slice(size_t begin, size_t count) const {
+        return HVView(ptr + begin * row_stride, count, n_cols, row_stride);
+    }
+
+private:
+    T* ptr = nullptr; ///< First element of row 0.
+    size_t n_rows = 0; ///< Number of rows.
+    size_t n_cols = 0; ///< Number of valid elements per row.
+    size_t row_stride = 0; ///< Row stride in elements.
+};
+
+/**
+ * @class HVMatrix
+ * @brief An owning, contiguous, row-major matrix of hypervectors.
+ *
+ * All rows live in a single allocation aligned to HV_ROW_ALIGN, and the row stride is
+ * padded up to a whole number of cache lines so every row starts on a cache-line boundary.
+ * Padding elements are zero-initialized and stay zero unless written through data().
+ * Large matrices can optionally be backed by transparent huge pages.
+ *
+ * @tparam T Trivially copyable element type.
+ */
+template <typename T>
+class HVMatrix {
+    static_assert(std::is_trivially_copyable<T>::value, "HVMatrix requires a trivially copyable type");
+
+public:
+    HVMatrix() = default;
+
+    /**
+     * @brief Allocates an n_rows x n_cols matrix.
+     *
+     * @param n_rows Number of rows.
+     * @param n_cols Number of valid elements per row.
+     * @param value Initial value of every valid element.
+     * @param huge_pages Whether to request transparent huge pages for large allocations.
+     */
+    HVMatrix(size_t n_rows, size_t n_cols, T value = T(), bool huge_pages = false)
+        : n_rows(n_rows), n_cols(n_cols), row_stride(padded_stride(n_cols)), huge(huge_pages) {
+        allocate();
+        fill(value);
+    }
+
+    HVMatrix(const HVMatrix& other)
+        : n_rows(other.n_rows), n_cols(other.n_cols), row_stride(other.row_stride), huge(other.huge) {
+        allocate();
+        if (bytes) {
+            std::memcpy(ptr, other.ptr, n_rows * row_stride * sizeof(T));
+        }
+    }
+
+    HVMatrix(HVMatrix&& other) noexcept { swap(other); }
+
+    HVMatrix& operator=(HVMatrix other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~HVMatrix() { release(); }
+
+    void swap(HVMatrix& other) noexcept {
+        std::swap(ptr, other.ptr);
+        std::swap(n_rows, other.n_rows);
+        std::swap(n_cols, other.n_cols);
+        std::swap(row_stride, other.row_stride);
+        std::swap(bytes, other.bytes);
+        std::swap(huge, other.huge);
+    }
+
+    size_t rows() const { return n_rows; } ///< Number of rows.
+    size_t cols() const { return n_cols; } ///< Number of valid elements per row.
+    size_t size() const { return n_rows; } ///< Number of rows, for container-style loops.
+    size_t stride() const { return row_stride; } ///< Row stride in elements.
+    bool empty() const { return n_rows == 0; } ///< Whether the matrix has no rows.
+
+    T* data() { return ptr; } ///< Pointer to the first element of row 0.
+    const T* data() const { return ptr; } ///< Pointer to the first element of row 0.
+
+    T* row(size_t i) { return ptr + i * row_stride; } ///< Pointer to row i.
+    const T* row(size_t i) const { return ptr + i * row_stride; } ///< Pointer to row i.
+    T* operator[](size_t i) { return row(i); } ///< Pointer to row i, so m[i][j] works.
+    const T* operator[](size_t i) const { return row(i); } ///< Pointer to row i, so m[i][j] works.
+    T& operator()(size_t i, size_t j) { return ptr[i * row_stride + j]; } ///< Element (i, j).
+    const T& operator()(size_t i, size_t j) const { return ptr[i * row_stride + j]; } ///< Element (i, j).
+
+    HVView<T> view() { return HVView<T>(ptr, n_rows, n_cols, row_stride); } ///< Mutable view.
+    HVView<const T> view() const { return HVView<const T>(ptr, n_rows, n_cols, row_stride); } ///< Read-only view.
+    operator HVView<T>() { return view(); }
+    operator HVView<const T>() const { return view(); }
+
+    /**
+     * @brief Sets every valid element to value, leaving the row padding at zero.
+     */
+    void fill(T value) {
+        for (size_t i = 0; i < n_rows; ++i) {
+            std::fill(row(i), row(i) + n_cols, value);
+        }
+    }
+
+    /**
+     * @brief Returns the row stride, in elements, that HVMatrix uses for n_cols columns.
+     */
+    static size_t padded_stride(size_t n_cols) {
+        size_t per_line = HV_ROW_ALIGN / sizeof(T);
+        if (per_line == 0) {
+            return n_cols;
+        }
+        return (n_cols + per_line - 1) / per_line * per_line;
+    }
+
+private:
+    T* ptr = nullptr; ///< Aligned storage.
+    size_t n_rows = 0; ///< Number of rows.
+    size_t n_cols = 0; ///< Number of valid elements per row.
+    size_t row_stride = 0; ///< Row stride in elements.
+    size_t bytes = 0; ///< Size of the allocation in bytes.
+    bool huge = false; ///< Whether huge pages were requested.
+
+    void allocate() {
+        bytes = n_rows * row_stride * sizeof(T);
+        if (bytes == 0) {
+            return;
+        }
+        size_t align = HV_ROW_ALIGN;
+        if (huge && bytes >= HV_HUGE_PAGE_SIZE) {
+            align = HV_HUGE_PAGE_SIZE;
+            bytes = (bytes + HV_HUGE_PAGE_SIZE - 1) / HV_HUGE_PAGE_SIZE * HV_HUGE_PAGE_SIZE;
+        }
+        void* mem = nullptr;
+        if (posix_memalign(&mem, align, bytes) != 0) {
+            throw std::bad_alloc();
+        }
+#ifdef MADV_HUGEPAGE
+        if (align == HV_HUGE_PAGE_SIZE) {
+            madvise(mem, bytes, MADV_HUGEPAGE);
+        }
+#endif
+        std::memset(mem, 0, bytes);
+        ptr = static_cast<T*>(mem);
+    }
+
+    void release() {
+        std::free(ptr);
+        ptr = nullptr;
+        bytes = 0;
+    }
+};
+
+#endif // HV_MATRIX_H
@@ -132,16 +132,16 @@ bool test_encode() {
     int fixed_value = 0;
 
     // Define the shape
-    std::vector<std::vector<int>> fixed_value_tensor(n_data, std::vector<int>(n_id, fixed_value));
+    HVMatrix<int> fixed_value_tensor(n_data, n_id, fixed_value);
 
     // HDC Model
     HDC hdc_model(n_class, n_lv, n_id, N_DIM, BINARY);
 
     // HDC Encoding Step
-    std::vector<std::vector<int>> fixed_value_tensor_enc = hdc_model.encode(fixed_value_tensor);
+    HVMatrix<int> fixed_value_tensor_enc = hdc_model.encode(fixed_value_tensor);
 
     // Print encoded tensor shape
-    std::cout << "[DEBUG] fixed_value_tensor_enc.size() = " << fixed_value_tensor_enc.size() << " x " << fixed_value_tensor_enc[0].size() << std::endl;
+    std::cout << "[DEBUG] fixed_value_tensor_enc.size() = " << fixed_value_tensor_enc.rows() << " x " << fixed_value_tensor_enc.cols() << std::endl;
 
     // Print encoded tensor
     print_2d_vector(fixed_value_tensor_enc);
@@ -153,8 +153,8 @@ bool test_encode() {
         return true;
     }
 
-    for (const auto& vec : fixed_value_tensor_enc) {
-        outfile.write(reinterpret_cast<const char*>(vec.data()), vec.size() * sizeof(int));
+    for (size_t i = 0; i < fixed_value_tensor_enc.rows(); ++i) {
+        outfile.write(reinterpret_cast<const char*>(fixed_value_tensor_enc.row(i)), fixed_value_tensor_enc.cols() * sizeof(int));
     }
 
     outfile.close();
@@ -205,9 +205,9 @@ bool train_test() {
     HDC hdc_model(n_class, n_lv, n_id, N_DIM, BINARY);
 
     // HDC Encoding Step
-    std::vector<std::vector<int>> train_enc = hdc_model.encode(ds_train.first);
+    HVMatrix<int> train_enc = hdc_model.encode(ds_train.first);
 
-    std::vector<std::vector<int>> test_enc = hdc_model.encode(ds_test.first);
+    HVMatrix<int> test_enc = hdc_model.encode(ds_test.first);
 
     // Init. Training
     hdc_model.train_init(train_enc, ds_train.second);
@@ -21,6 +21,19 @@ std::vector<int> binarize(const std::vector<int>& x) {
     return result;
 }
 
+/**
+ * @brief Binarizes n values without allocating.
+ *
+ * @param x Input values.
+ * @param out Output buffer of n values; may be the same buffer as x.
+ * @param n Number of values.
+ */
+void binarize(const int* x, int* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = x[i] > 0 ? 1 : -1;
+    }
+}
+
 
 /**
  * @brief Generates a random integer vector.
@@ -55,9 +68,23 @@ void print_2d_vector(const std::vector<std::vector<int>>& vec) {
     }
 }
 
+/**
+ * @brief Prints the valid elements of a hypervector matrix to the standard output.
+ *
+ * @param mat The matrix to print.
+ */
+void print_2d_vector(HVView<const int> mat) {
+    for (size_t i = 0; i < mat.rows(); ++i) {
+        for (size_t j = 0; j < mat.cols(); ++j) {
+            std::cout << mat(i, j) << " ";
+        }
+        std::cout << std::endl;
+    }
+}
+
 
 
-void gemv(uint64_t row, uint64_t col, const std::vector<int> &srcVector, const std::vector<std::vector<int>> &srcMatrix, std::vector<int> &dst)
+void gemv(uint64_t row, uint64_t col, const int *srcVector, HVView<const int> srcMatrix, std::vector<int> &dst)
 {
   unsigned bitsPerElement = sizeof(int) * 8;
   PimObjId srcObj1 = pimAlloc(PIM_ALLOC_AUTO, row, bitsPerElement, PIM_INT32);
@@ -89,7 +116,8 @@ void gemv(uint64_t row, uint64_t col, const std::vector<int> &srcVector, const s
 
   for (int i = 0; i < col; ++i)
   {
-    status = pimCopyHostToDevice((void *)srcMatrix[i].data(), srcObj1);
+    // Rows are contiguous in the matrix, so each one is copied straight from its stride offset
+    status = pimCopyHostToDevice((void *)srcMatrix.row(i), srcObj1);
     if (status != PIM_OK)
     {
       std::cout << "Abort" << std::endl;
@@ -129,13 +157,13 @@ void gemv(uint64_t row, uint64_t col, const std::vector<int> &srcVector, const s
   pimFree(dstObj);
 }
 
-void gemm(uint64_t row, uint64_t colA, uint64_t colB, const std::vector<std::vector<int>> &srcMatrixA, const std::vector<std::vector<int>> &srcMatrixB, std::vector<std::vector<int>> &dstMatrix, bool shouldVerify)
+void gemm(uint64_t row, uint64_t colA, uint64_t colB, HVView<const int> srcMatrixA, HVView<const int> srcMatrixB, std::vector<std::vector<int>> &dstMatrix, bool shouldVerify)
 {
   //the result matrix is saved in transformed way
   dstMatrix.resize(colB, std::vector<int>(row, 0));
   for (int i = 0; i < colA; ++i)
   {
-    gemv(row, colA, srcMatrixB[i], srcMatrixA, dstMatrix[i]);
+    gemv(row, colA, srcMatrixB.row(i), srcMatrixA, dstMatrix[i]);
   }
 }
 
@@ -1,19 +1,28 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <cstddef>
 #include <vector>
 #include <stdint.h>
+
+#include "hv_matrix.h"
 // Binarize function
 std::vector<int> binarize(const std::vector<int>& x);
 
+// Binarize n values from x into out (x and out may alias)
+void binarize(const int* x, int* out, size_t n);
+
 // Generate random integer vector
 std::vector<int> generate_random_vector(int size, int min, int max);
 
 // Print 2D vector
 void print_2d_vector(const std::vector<std::vector<int>>& vec);
 
-void gemv(uint64_t row, uint64_t col, const std::vector<int> &srcVector, const std::vector<std::vector<int>> &srcMatrix, std::vector<int> &dst); 
+// Print the valid elements of every row of a hypervector matrix
+void print_2d_vector(HVView<const int> mat);
+
+void gemv(uint64_t row, uint64_t col, const int *srcVector, HVView<const int> srcMatrix, std::vector<int> &dst); 
 
-void gemm(uint64_t row, uint64_t colA, uint64_t colB, const std::vector<std::vector<int>> &srcMatrixA, const std::vector<std::vector<int>> &srcMatrixB, std::vector<std::vector<int>> &dstMatrix, bool shouldVerify);
+void gemm(uint64_t row, uint64_t colA, uint64_t colB, HVView<const int> srcMatrixA, HVView<const int> srcMatrixB, std::vector<std::vector<int>> &dstMatrix, bool shouldVerify);
 
 #endif // UTILS_H
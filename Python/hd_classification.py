@@ -8,7 +8,7 @@ import time
 import argparse
 import os
 
-def save_hdc_params(dataset_name, n_dim=2048, binary=False, train_epochs=20, n_lv=32, n_class=5):
+def save_hdc_params(dataset_name, n_dim=2048, binary=False, train_epochs=20, n_lv=32, n_class=5, method_id_lv="random"):
     directory = f'../CPP/dataset/{dataset_name}'
     filename = os.path.join(directory, 'hdc_parameters')
 
@@ -32,6 +32,8 @@ def save_hdc_params(dataset_name, n_dim=2048, binary=False, train_epochs=20, n_l
          line = str(int(n_class))
          file.write(line + "\n")
 
+         file.write(method_id_lv + "\n")
+
 
 def train_and_evaluate_hdc_model(dataset_name, only_parse_dataset, n_dim=2048, binary=False, train_epochs=20, val_epochs=5):
     # Load dataset
@@ -48,6 +48,20 @@ ds_query_levels_quantized = model.min_max_quantize(
 )
 ds_query_idxs = torch.tensor(ds_query["idxs"])
 
+# Precursor-windowed search over the full runs is done by the C++ workload (--oms)
+utils.save_oms_dataset(
+    ds_ref,
+    ds_query,
+    ds_ref_levels_quantized,
+    ds_query_levels_quantized,
+    name="OMS_iPRG_demo",
+    n_id=n_id,
+    n_dim=n_dim,
+    binary=binary,
+    n_lv=n_lv,
+    method_id_lv=hdc_model.method_id_lv,
+)
+
 
 # %% HDC Encoding Step for Database Pre-building
 n_test = 100
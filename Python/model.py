@@ -92,17 +92,11 @@ def generate_lv_id_hvs(n_lv, n_id, n_dim, method="random"):
         return levels
 
     def gen_cyclic_id_hvs(n_dim: int, n_id: int):
-        import copy
-
-        n_flip = int(n_dim // 2)
-        base = np.random.randint(0, 2, size=n_dim) * 2 - 1
-
-        ids = [copy.copy(base)]
-        for _ in range(n_id - 1):
-            idx_to_flip = np.random.randint(0, n_dim, size=n_flip)
-            base[idx_to_flip] *= -1
-            ids.append(copy.copy(base))
-        return np.vstack(ids)
+        # ID j is base j // n_dim rotated by j % n_dim, so the C++ engine stores one base
+        # per n_dim IDs and binds rotations in place
+        n_base = (n_id + n_dim - 1) // n_dim
+        bases = np.random.randint(0, 2, size=(n_base, n_dim)) * 2 - 1
+        return np.vstack([np.roll(bases[j // n_dim], j % n_dim) for j in range(n_id)])
 
     if method == "random":
         hv_lv = torch.randint(0, 2, size=(n_lv, n_dim), dtype=torch.int) * 2 - 1
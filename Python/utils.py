@@ -130,6 +130,34 @@ def save_dataset(data_train, data_test, name):
     with open(filename, 'w') as file:
         file.write(line + "\n")
 
+def save_oms_dataset(ds_ref, ds_query, ref_levels, query_levels, name, n_id, n_dim, binary, n_lv, method_id_lv="random"):
+    """
+    Export quantized reference and query spectra for the C++ --oms search
+
+    Every line of ref.spectra / query.spectra is "<pr_mz> <idx>:<level> ...", listing only
+    the peaks that are present.
+    """
+    directory = f'../CPP/dataset/{name}'
+
+    # Create the directory if it does not exist
+    if not os.path.exists(directory):
+        os.makedirs(directory)
+
+    for fname, ds, levels in [('ref.spectra', ds_ref, ref_levels), ('query.spectra', ds_query, query_levels)]:
+        with open(os.path.join(directory, fname), 'w') as file:
+            for pr_mz, idxs, lvs in zip(ds["pr_mzs"], ds["idxs"], levels):
+                peaks = [f"{i}:{int(lv)}" for i, lv in zip(idxs, lvs) if i >= 0]
+                file.write(" ".join([repr(float(pr_mz))] + peaks) + "\n")
+
+    line = str(len(ds_ref["pr_mzs"])) + "\n" + str(len(ds_query["pr_mzs"])) + "\n" + str(n_id)
+    with open(os.path.join(directory, 'oms_parameters'), 'w') as file:
+        file.write(line + "\n")
+
+    line = (str(n_dim) + "\n" + str(int(binary)) + "\n0\n" + str(n_lv) + "\n" + str(len(ds_ref["pr_mzs"])) + "\n"
+            + method_id_lv)
+    with open(os.path.join(directory, 'hdc_parameters'), 'w') as file:
+        file.write(line + "\n")
+
 def get_checksum(data_train, data_test):
     acc = 0
     N = (2 ** 20)